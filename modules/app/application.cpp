@@ -7,8 +7,12 @@
 #include "settings.h"
 #include "version.h"
 
+#include <indexing/workerpool.h>
+
 #include <program/libclang.h>
 
+#include <utils/executor.h>
+
 #include <iostream>
 
 Application::Application(int& argc, char** argv)
@@ -21,6 +25,28 @@ Application::Application(int& argc, char** argv)
   Settings& settings = init<Settings>();
 
   init<LibClang>(settings.value(Settings::libclangPathKey()).toString());
+
+  for (Executor::Kind k : { Executor::Parse, Executor::Index, Executor::Interactive })
+  {
+    Executor& executor = Executor::get(k);
+    int n = settings.readInt(Settings::executorThreadCountKey(executor.name()), 0);
+
+    if (n > 0)
+      executor.setMaxThreadCount(n);
+  }
+
+  int workers = settings.readInt(Settings::indexingWorkersKey(), 0);
+
+  if (workers > 0)
+  {
+    QString program = applicationDirPath() + "/clark-worker";
+    auto& pool = init<IndexingWorkerPool>(program, settings.value(Settings::libclangPathKey()).toString(), workers);
+
+    int timeout = settings.readInt(Settings::indexingJobTimeoutKey(), -1);
+
+    if (timeout >= 0)
+      pool.setJobTimeout(timeout * 1000);
+  }
 }
 
 Application& Application::instance()
@@ -0,0 +1,191 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "clangindexregistry.h"
+
+#include "application.h"
+#include "settings.h"
+
+#include <indexing/includegraphprefetchpolicy.h>
+#include <indexing/indexer.h>
+#include <indexing/indexingloader.h>
+#include <indexing/workerpool.h>
+
+#include <program/clangindex.h>
+#include <program/libclang.h>
+#include <program/translationunit.h>
+
+#include <QDir>
+
+ClangIndexRegistry::ClangIndexRegistry(QObject* parent) : QObject(parent)
+{
+
+}
+
+ClangIndexRegistry::~ClangIndexRegistry()
+{
+  // indexings reference their translation unit, they must go first
+  for (const auto& p : m_indexings)
+    delete p.second;
+
+  m_indexings.clear();
+
+  delete m_index;
+}
+
+/**
+ * \brief returns the index shared by all windows
+ * 
+ * The index is created on first use.
+ */
+ClangIndex& ClangIndexRegistry::index()
+{
+  if (!m_index)
+  {
+    Application& app = Application::instance();
+
+    m_index = new ClangIndex(app.get<LibClang>(), this);
+
+    if (app.settings().readBool(Settings::singlePassIndexingKey(), true))
+      m_index->setLoaderFactory(std::make_unique<IndexingLoaderFactory>());
+
+    // the worker processes index the translation units that are not opened, 
+    // clark only parses the ones it loads
+    if (app.find<IndexingWorkerPool>())
+      m_index->setBackgroundParsing(false);
+
+    m_index->setPrefetchPolicy(std::make_unique<IncludeGraphPrefetchPolicy>());
+  }
+
+  return *m_index;
+}
+
+/**
+ * \brief adds a translation unit to the shared index
+ * \param tu  the translation unit
+ * 
+ * If an equivalent translation unit (same file and compile options) is 
+ * already registered, \a tu is deleted and the existing translation unit 
+ * is returned instead.
+ */
+TranslationUnit* ClangIndexRegistry::addTranslationUnit(TranslationUnit* tu)
+{
+  std::vector<TranslationUnit*> result = addTranslationUnits({ tu });
+  return result.front();
+}
+
+/**
+ * \brief adds translation units to the shared index
+ * \param list  the translation units
+ * 
+ * Returns the registered translation units, in the same order as \a list.
+ * Translation units that duplicate a registered one are deleted and 
+ * replaced by the existing translation unit in the result.
+ */
+std::vector<TranslationUnit*> ClangIndexRegistry::addTranslationUnits(const std::vector<TranslationUnit*>& list)
+{
+  std::vector<TranslationUnit*> result;
+  std::vector<TranslationUnit*> added;
+  result.reserve(list.size());
+
+  for (TranslationUnit* tu : list)
+  {
+    auto key = std::make_pair(normalizedPath(tu->filePath()), tu->sharedCompileOptions().get());
+    auto it = m_translation_units.find(key);
+
+    if (it != m_translation_units.end())
+    {
+      if (it->second != tu)
+        delete tu;
+
+      result.push_back(it->second);
+      continue;
+    }
+
+    m_translation_units[key] = tu;
+
+    connect(tu, &TranslationUnit::aboutToBeDestroyed, this, [this, tu]() {
+      onTranslationUnitDestroyed(tu);
+      });
+
+    added.push_back(tu);
+    result.push_back(tu);
+  }
+
+  if (!added.empty())
+  {
+    index().addTranslationUnits(added);
+
+    if (!index().backgroundParsing())
+    {
+      for (TranslationUnit* tu : added)
+        indexing(*tu).start();
+    }
+  }
+
+  return result;
+}
+
+/**
+ * \brief finds a registered translation unit
+ * \param path  the path of the main file of the translation unit
+ * \param opts  the interned compile options of the translation unit
+ */
+TranslationUnit* ClangIndexRegistry::find(const QString& path, const program::CompileOptions* opts) const
+{
+  auto it = m_translation_units.find(std::make_pair(normalizedPath(path), opts));
+  return it != m_translation_units.end() ? it->second : nullptr;
+}
+
+/**
+ * \brief returns the indexing of a translation unit
+ * 
+ * The indexing is shared by all the windows that display the translation unit; 
+ * it is created but not started by this function.
+ * The includes of every indexing result are added to the prefetch policy.
+ */
+TranslationUnitIndexing& ClangIndexRegistry::indexing(TranslationUnit& tu)
+{
+  TranslationUnitIndexing*& indexing = m_indexings[&tu];
+
+  if (!indexing)
+  {
+    indexing = new TranslationUnitIndexing(tu, this);
+    indexing->setWorkerPool(Application::instance().find<IndexingWorkerPool>());
+
+    TranslationUnitIndexing* idx = indexing;
+
+    connect(idx, &TranslationUnitIndexing::ready, this, [this, idx]() {
+      if (auto* policy = dynamic_cast<IncludeGraphPrefetchPolicy*>(index().prefetchPolicy()))
+        policy->addIncludes(idx->translationUnit(), idx->indexingResult());
+      });
+  }
+
+  return *indexing;
+}
+
+QString ClangIndexRegistry::normalizedPath(const QString& path)
+{
+  return QDir::cleanPath(QDir::fromNativeSeparators(path));
+}
+
+void ClangIndexRegistry::onTranslationUnitDestroyed(TranslationUnit* tu)
+{
+  for (auto it = m_translation_units.begin(); it != m_translation_units.end(); ++it)
+  {
+    if (it->second == tu)
+    {
+      m_translation_units.erase(it);
+      break;
+    }
+  }
+
+  auto it = m_indexings.find(tu);
+
+  if (it != m_indexings.end())
+  {
+    delete it->second;
+    m_indexings.erase(it);
+  }
+}
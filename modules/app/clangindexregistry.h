@@ -0,0 +1,58 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_CLANGINDEXREGISTRY_H
+#define CLARK_CLANGINDEXREGISTRY_H
+
+#include <QObject>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+class ClangIndex;
+class TranslationUnit;
+class TranslationUnitIndexing;
+
+namespace program
+{
+struct CompileOptions;
+} // namespace program
+
+/**
+ * \brief application-wide registry of translation units
+ * 
+ * All windows share a single ClangIndex so that a translation unit opened 
+ * in several windows is only parsed and indexed once.
+ * Translation units are deduplicated by path and compile options.
+ * 
+ * Use Application::dependency<ClangIndexRegistry>() to access the registry.
+ */
+class ClangIndexRegistry : public QObject
+{
+  Q_OBJECT
+public:
+  explicit ClangIndexRegistry(QObject* parent = nullptr);
+  ~ClangIndexRegistry();
+
+  ClangIndex& index();
+
+  TranslationUnit* addTranslationUnit(TranslationUnit* tu);
+  std::vector<TranslationUnit*> addTranslationUnits(const std::vector<TranslationUnit*>& list);
+
+  TranslationUnit* find(const QString& path, const program::CompileOptions* opts) const;
+
+  TranslationUnitIndexing& indexing(TranslationUnit& tu);
+
+protected:
+  static QString normalizedPath(const QString& path);
+  void onTranslationUnitDestroyed(TranslationUnit* tu);
+
+private:
+  ClangIndex* m_index = nullptr;
+  std::map<std::pair<QString, const program::CompileOptions*>, TranslationUnit*> m_translation_units;
+  std::map<TranslationUnit*, TranslationUnitIndexing*> m_indexings;
+};
+
+#endif // CLARK_CLANGINDEXREGISTRY_H
@@ -6,6 +6,7 @@
 #include "openslndialog.widgets.h"
 
 #include "program/translationunit.h"
+#include "utils/solutionloader.h"
 #include "utils/tufromsln.h"
 
 #include <QLabel>
@@ -18,13 +19,10 @@
 
 /* Widgets */
 
-SlnProjectListWidget::SlnProjectListWidget(const vcxproj::Solution& s, QWidget* parent) : QListWidget(parent),
-  m_solution(s)
+SlnProjectListWidget::SlnProjectListWidget(QWidget* parent) : QListWidget(parent)
 {
   setSelectionMode(QAbstractItemView::SingleSelection);
 
-  buildItems(m_solution);
-
   connect(this, &QListWidget::itemSelectionChanged, this, &SlnProjectListWidget::selectionChanged);
 }
 
@@ -41,13 +39,10 @@ std::optional<std::string> SlnProjectListWidget::selection() const
   return item->text().toStdString();
 }
 
-void SlnProjectListWidget::buildItems(const vcxproj::Solution& solution)
+void SlnProjectListWidget::addProject(const vcxproj::Project& project)
 {
-  for (const vcxproj::Project& p : solution.projects)
-  {
-    auto* item = new QListWidgetItem(QString::fromStdString(p.name));
-    addItem(item);
-  }
+  auto* item = new QListWidgetItem(QString::fromStdString(project.name));
+  addItem(item);
 }
 
 SlnProjectConfigurationListWidget::SlnProjectConfigurationListWidget(QWidget* parent) : QListWidget(parent)
@@ -87,12 +82,10 @@ void SlnProjectConfigurationListWidget::buildItems(const vcxproj::Project& proje
   }
 }
 
-SlnCompileListWidget::SlnCompileListWidget(const vcxproj::Solution& s, QWidget* parent) : QListWidget(parent)
+SlnCompileListWidget::SlnCompileListWidget(QWidget* parent) : QListWidget(parent)
 {
   setSelectionMode(QAbstractItemView::SingleSelection);
 
-  buildItems(s);
-
   connect(this, &QListWidget::itemSelectionChanged, this, &SlnCompileListWidget::selectionChanged);
 }
 
@@ -138,34 +131,36 @@ std::optional<SlnCompileListWidget::Item> SlnCompileListWidget::selection() cons
   return toItem(item);
 }
 
-void SlnCompileListWidget::buildItems(const vcxproj::Solution& solution)
+void SlnCompileListWidget::addProject(const vcxproj::Project& project)
 {
-  for (const vcxproj::Project& p : solution.projects)
+  QString projectname = QString::fromStdString(project.name);
+
+  QStringList configs;
+
+  for (const vcxproj::ProjectConfiguration& pconf : project.projectConfigurationList)
   {
-    QString projectname = QString::fromStdString(p.name);
+    configs.append(QString::fromStdString(pconf.name));
+  }
 
-    QStringList configs;
+  setUpdatesEnabled(false);
 
-    for (const vcxproj::ProjectConfiguration& pconf : p.projectConfigurationList)
-    {
-      configs.append(QString::fromStdString(pconf.name));
-    }
+  for (const std::string& filepath : project.compileList)
+  {
+    Item item;
+    item.project = projectname;
+    item.compile = QString::fromStdString(filepath);
 
-    for (const std::string& filepath : p.compileList)
+    for (QString conf : configs)
     {
-      Item item;
-      item.project = projectname;
-      item.compile = QString::fromStdString(filepath);
-      
-      for (QString conf : configs)
-      {
-        item.projectConfiguration = conf;
-       
-        QListWidgetItem* listitem = createListItem(item);
-        addItem(listitem);
-      }
+      item.projectConfiguration = conf;
+
+      QListWidgetItem* listitem = createListItem(item);
+      addItem(listitem);
+      listitem->setHidden(!acceptItem(item));
     }
   }
+
+  setUpdatesEnabled(true);
 }
 
 QListWidgetItem* SlnCompileListWidget::createListItem(const Item& item)
@@ -192,35 +187,35 @@ void SlnCompileListWidget::updateFilters()
   for (int i(0); i < count(); ++i)
   {
     QListWidgetItem* listitem = item(i);
-    Item itemdata = toItem(listitem);
-
-    bool visible = (projectFilter().isEmpty() || itemdata.project == projectFilter())
-      && (projectConfigurationFilter().isEmpty() || itemdata.projectConfiguration == projectConfigurationFilter());
-
-    listitem->setHidden(!visible);
+    listitem->setHidden(!acceptItem(toItem(listitem)));
   }
 }
 
+bool SlnCompileListWidget::acceptItem(const Item& item) const
+{
+  return (projectFilter().isEmpty() || item.project == projectFilter())
+    && (projectConfigurationFilter().isEmpty() || item.projectConfiguration == projectConfigurationFilter());
+}
+
 /* Dialog */
 
-OpenSlnDialog::OpenSlnDialog(vcxproj::Solution s, QWidget* parent) : QDialog(parent),
-  m_solution(std::move(s))
+OpenSlnDialog::OpenSlnDialog(QWidget* parent) : QDialog(parent),
+  m_loader(new SolutionLoader(this))
 {
   setWindowTitle("Open Visual Studio Solution");
   setModal(true);
 
-  auto* description_display = new QLabel(
-    "Visual Studio Solution: " + QString::fromStdString(m_solution.filepath.string())
-  );
+  m_description_display = new QLabel();
+  m_progress_display = new QLabel();
 
-  m_projects_widget = new SlnProjectListWidget(m_solution);
+  m_projects_widget = new SlnProjectListWidget();
   m_configs_widget = new SlnProjectConfigurationListWidget();
 
   auto* instruction_display = new QLabel(
     "Select a translation unit: "
   );
 
-  m_compiles_widget = new SlnCompileListWidget(m_solution);
+  m_compiles_widget = new SlnCompileListWidget();
 
   m_ok_button = new QPushButton("Ok");
   auto* cancel_button = new QPushButton("Cancel");
@@ -233,7 +228,8 @@ OpenSlnDialog::OpenSlnDialog(vcxproj::Solution s, QWidget* parent) : QDialog(par
   {
     auto* layout = new QVBoxLayout;
 
-    layout->addWidget(description_display);
+    layout->addWidget(m_description_display);
+    layout->addWidget(m_progress_display);
     
     {
       auto* sublayout = new QHBoxLayout;
@@ -260,6 +256,10 @@ OpenSlnDialog::OpenSlnDialog(vcxproj::Solution s, QWidget* parent) : QDialog(par
   }
 
   {
+    connect(m_loader, &SolutionLoader::projectLoaded, this, &OpenSlnDialog::onProjectLoaded);
+    connect(m_loader, &SolutionLoader::projectFailed, this, &OpenSlnDialog::updateProgress);
+    connect(m_loader, &SolutionLoader::finished, this, &OpenSlnDialog::updateProgress);
+
     connect(m_projects_widget, &SlnProjectListWidget::selectionChanged, this, [this]() {
       auto sel = m_projects_widget->selection();
       m_configs_widget->setProject(findProject(sel.value_or(std::string())));
@@ -285,6 +285,24 @@ OpenSlnDialog::OpenSlnDialog(vcxproj::Solution s, QWidget* parent) : QDialog(par
   }
 }
 
+/**
+ * \brief starts loading a solution
+ * \param slnpath  the path of the solution file
+ * 
+ * Returns false if the solution file could not be read.
+ * The projects are added to the dialog as they are loaded.
+ */
+bool OpenSlnDialog::load(const QString& slnpath)
+{
+  if (!m_loader->load(slnpath))
+    return false;
+
+  m_description_display->setText("Visual Studio Solution: " + slnpath);
+  updateProgress();
+
+  return true;
+}
+
 int OpenSlnDialog::resultCode() const
 {
   return QDialog::result();
@@ -318,9 +336,38 @@ std::unique_ptr<TranslationUnit> OpenSlnDialog::result() const
 
 const vcxproj::Project* OpenSlnDialog::findProject(const std::string& name) const
 {
-  auto it = std::find_if(m_solution.projects.begin(), m_solution.projects.end(), [&name](const vcxproj::Project& p) {
+  const vcxproj::Solution& solution = m_loader->solution();
+
+  auto it = std::find_if(solution.projects.begin(), solution.projects.end(), [&name](const vcxproj::Project& p) {
     return p.name == name;
     });
 
-  return it != m_solution.projects.end() ? &(*it) : nullptr;
+  return it != solution.projects.end() ? &(*it) : nullptr;
+}
+
+void OpenSlnDialog::onProjectLoaded(int index)
+{
+  const vcxproj::Project& project = m_loader->solution().projects.at(index);
+  m_projects_widget->addProject(project);
+  m_compiles_widget->addProject(project);
+  updateProgress();
+}
+
+void OpenSlnDialog::updateProgress()
+{
+  if (m_loader->isFinished())
+  {
+    if (m_loader->failedProjectCount() > 0)
+      m_progress_display->setText(QString("%1 project(s) could not be loaded.").arg(m_loader->failedProjectCount()));
+    else
+      m_progress_display->clear();
+
+    m_progress_display->setVisible(m_loader->failedProjectCount() > 0);
+  }
+  else
+  {
+    m_progress_display->setText(QString("Loading projects (%1/%2)...")
+      .arg(m_loader->loadedProjectCount() + m_loader->failedProjectCount())
+      .arg(m_loader->projectCount()));
+  }
 }
@@ -15,10 +15,14 @@
 #include <memory>
 
 class QDir;
+class QLabel;
+class QPushButton;
 class QTabWidget;
 
 class TranslationUnit;
 
+class SolutionLoader;
+
 class SlnProjectListWidget;
 class SlnProjectConfigurationListWidget;
 class SlnCompileListWidget;
@@ -27,16 +31,22 @@ class OpenSlnDialog : public QDialog
 {
   Q_OBJECT
 public:
-  explicit OpenSlnDialog(vcxproj::Solution s, QWidget* parent = nullptr);
+  explicit OpenSlnDialog(QWidget* parent = nullptr);
+
+  bool load(const QString& slnpath);
 
   int resultCode() const;
   std::unique_ptr<TranslationUnit> result() const;
 
 private:
   const vcxproj::Project* findProject(const std::string& name) const;
+  void onProjectLoaded(int index);
+  void updateProgress();
 
 private:
-  vcxproj::Solution m_solution;
+  SolutionLoader* m_loader = nullptr;
+  QLabel* m_description_display = nullptr;
+  QLabel* m_progress_display = nullptr;
   SlnProjectListWidget* m_projects_widget = nullptr;
   SlnProjectConfigurationListWidget* m_configs_widget = nullptr;
   SlnCompileListWidget* m_compiles_widget = nullptr;
@@ -11,25 +11,21 @@
 
 namespace vcxproj
 {
-struct Solution;
+struct Project;
 } // namespace vcxproj
 
 class SlnProjectListWidget : public QListWidget
 {
   Q_OBJECT
 public:
-  explicit SlnProjectListWidget(const vcxproj::Solution& s, QWidget* parent = nullptr);
+  explicit SlnProjectListWidget(QWidget* parent = nullptr);
 
   std::optional<std::string> selection() const;
 
+  void addProject(const vcxproj::Project& project);
+
 Q_SIGNALS:
   void selectionChanged();
-
-private:
-  void buildItems(const vcxproj::Solution& solution);
-
-private:
-  const vcxproj::Solution& m_solution;
 };
 
 class SlnProjectConfigurationListWidget : public QListWidget
@@ -53,7 +49,9 @@ class SlnCompileListWidget : public QListWidget
 {
   Q_OBJECT
 public:
-  explicit SlnCompileListWidget(const vcxproj::Solution& s, QWidget* parent = nullptr);
+  explicit SlnCompileListWidget(QWidget* parent = nullptr);
+
+  void addProject(const vcxproj::Project& project);
 
   const QString& projectFilter() const;
   void setProjectFilter(const QString& f);
@@ -74,9 +72,9 @@ Q_SIGNALS:
   void selectionChanged();
 
 private:
-  void buildItems(const vcxproj::Solution& solution);
   static QListWidgetItem* createListItem(const Item& item);
   static Item toItem(QListWidgetItem* listitem);
+  bool acceptItem(const Item& item) const;
   void updateFilters();
 
 private:
@@ -60,6 +60,15 @@ void AstModel::setTranslationUnit(TranslationUnit* tunit)
         setTranslationUnit(nullptr);
       }
       });
+
+    // the cursors of the model belong to the previous clang translation unit
+    connect(tunit, &TranslationUnit::reparsed, this, [this, tunit]() {
+      if (translationUnit() == tunit) {
+        beginResetModel();
+        m_db->clear();
+        endResetModel();
+      }
+      });
   }
 
   endResetModel();
@@ -127,7 +127,10 @@ QVariant ClangIndexModel::data(const QModelIndex& index, int role) const
     }
     else if (col == 1)
     {
-      return toString(tu->state());
+      if (tu->flags() & TranslationUnit::Skeleton)
+        return toString(tu->state()) + " (outline)";
+      else
+        return toString(tu->state());
     }
   }
 
@@ -146,6 +149,8 @@ QString ClangIndexModel::toString(TranslationUnit::State s)
     return "Parsing";
   case TranslationUnit::State::Suspended:
     return "Suspended";
+  case TranslationUnit::State::Hibernated:
+    return "Hibernated";
   default:
     return {};
   }
@@ -6,16 +6,18 @@
 
 #include "resource/iconcache.h"
 
+#include <utils/executor.h>
+
 #include <libclang-utils/clang-translation-unit.h>
 
-#include <QtConcurrent>
+#include <QFutureWatcher>
 
 #include <QDebug>
 
 
-static std::shared_ptr<EntityModel::Tree> build_entitymodel_tree(const clark::IndexingResult* index)
+static std::shared_ptr<EntityModel::Tree> build_entitymodel_tree(std::shared_ptr<const clark::IndexingResult> index)
 {
-  return std::make_shared<EntityModel::Tree>(index->symbols);
+  return std::make_shared<EntityModel::Tree>(std::move(index));
 }
 
 
@@ -68,6 +70,17 @@ EntityModel::Tree::Tree(const std::map<clark::USR, std::unique_ptr<clark::Entity
   }
 }
 
+/**
+ * \brief builds the tree of the entities of an indexing result
+ * 
+ * The tree keeps the result alive, so that it remains valid when 
+ * the translation unit is indexed again.
+ */
+EntityModel::Tree::Tree(std::shared_ptr<const clark::IndexingResult> result) : Tree(result->symbols)
+{
+  m_indexing_result = std::move(result);
+}
+
 EntityModel::Node* EntityModel::Tree::root()
 {
   return node(0);
@@ -91,14 +104,11 @@ EntityModel::EntityModel(TranslationUnitIndexing* idx, QObject* parent) : QAbstr
   {
     connect(idx, &TranslationUnitIndexing::destroyed, this, &EntityModel::resetTree);
 
-    if (!idx->isReady())
-    {
-      connect(idx, &TranslationUnitIndexing::ready, this, &EntityModel::computeTree);
-    }
-    else
-    {
+    // the tree is built again when the translation unit is indexed again
+    connect(idx, &TranslationUnitIndexing::ready, this, &EntityModel::computeTree);
+
+    if (idx->isReady())
       computeTree();
-    }
   }
 }
 
@@ -274,7 +284,14 @@ EntityModel::Tree* EntityModel::tree() const
 
 void EntityModel::computeTree()
 {
-  QFuture<TreeSharedPtr> future_tree = QtConcurrent::run(build_entitymodel_tree, &translationUnitIndexing()->indexingResult());
+  std::shared_ptr<const clark::IndexingResult> result = translationUnitIndexing()->sharedIndexingResult();
+
+  if (!result)
+    return;
+
+  QFuture<TreeSharedPtr> future_tree = Executor::get(Executor::Interactive).run([result]() {
+    return build_entitymodel_tree(result);
+    });
   auto watcher = new QFutureWatcher<TreeSharedPtr>(this);
   connect(watcher, &QFutureWatcher<TreeSharedPtr>::finished, this, &EntityModel::onTreeReady);
   watcher->setFuture(future_tree);
@@ -47,6 +47,7 @@ public:
   {
   private:
     std::vector<Node> m_nodes;
+    std::shared_ptr<const clark::IndexingResult> m_indexing_result; // owns the entities of the nodes
 
   public:
     Tree();
@@ -54,6 +55,7 @@ public:
     ~Tree() = default;
 
     explicit Tree(const std::map<clark::USR, std::unique_ptr<clark::Entity>>& entities);
+    explicit Tree(std::shared_ptr<const clark::IndexingResult> result);
     
     Node* root();
     const std::vector<Node>& nodes() const;
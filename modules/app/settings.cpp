@@ -73,3 +73,30 @@ QString Settings::libclangPathKey()
 {
   return "libclang/path";
 }
+
+QString Settings::singlePassIndexingKey()
+{
+  return "indexing/singlepass";
+}
+
+QString Settings::indexingWorkersKey()
+{
+  return "indexing/workers";
+}
+
+/**
+ * \brief returns the key storing the time after which a worker process is considered hung, in seconds
+ */
+QString Settings::indexingJobTimeoutKey()
+{
+  return "indexing/jobtimeout";
+}
+
+/**
+ * \brief returns the key storing the number of threads of an executor
+ * \param executorName  the name of the executor (see Executor::name())
+ */
+QString Settings::executorThreadCountKey(const QString& executorName)
+{
+  return "executors/" + executorName + "/threads";
+}
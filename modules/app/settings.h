@@ -31,6 +31,10 @@ public:
   void writeString(const QString& key, const QString& val);
 
   static QString libclangPathKey();
+  static QString singlePassIndexingKey();
+  static QString indexingWorkersKey();
+  static QString indexingJobTimeoutKey();
+  static QString executorThreadCountKey(const QString& executorName);
 
 Q_SIGNALS:
   void valueChanged(const QString& key);
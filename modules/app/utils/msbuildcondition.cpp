@@ -0,0 +1,340 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "msbuildcondition.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <stdexcept>
+
+namespace clark
+{
+
+namespace msbuild
+{
+
+/**
+ * \brief replaces the $(Name) references in a string by the value of the properties
+ * 
+ * Undefined properties expand to an empty string, as in MSBuild.
+ */
+std::string expand_properties(const std::string& str, const Properties& properties)
+{
+  std::string result;
+  result.reserve(str.size());
+
+  size_t i = 0;
+
+  while (i < str.size())
+  {
+    if (str[i] == '$' && i + 1 < str.size() && str[i + 1] == '(')
+    {
+      size_t end = str.find(')', i + 2);
+
+      if (end != std::string::npos)
+      {
+        auto it = properties.find(str.substr(i + 2, end - i - 2));
+
+        if (it != properties.end())
+          result += it->second;
+
+        i = end + 1;
+        continue;
+      }
+    }
+
+    result.push_back(str[i++]);
+  }
+
+  return result;
+}
+
+namespace
+{
+
+bool iequals(const std::string& a, const char* b)
+{
+  size_t n = std::char_traits<char>::length(b);
+
+  if (a.size() != n)
+    return false;
+
+  return std::equal(a.begin(), a.end(), b, [](char x, char y) {
+    return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+/**
+ * \brief a recursive descent parser for MSBuild conditions
+ * 
+ * Supported grammar:
+ * \code
+ *   or-expr    := and-expr ('or' and-expr)*
+ *   and-expr   := unary ('and' unary)*
+ *   unary      := '!' unary | comparison
+ *   comparison := operand (('==' | '!=' | '<' | '>' | '<=' | '>=') operand)?
+ *   operand    := '(' or-expr ')' | quoted-string | function-call | word
+ * \endcode
+ * Only the Exists() and HasTrailingSlash() functions are supported.
+ */
+class ConditionParser
+{
+public:
+  ConditionParser(const std::string& condition, const Properties& properties) :
+    m_text(condition),
+    m_properties(properties)
+  {
+
+  }
+
+  bool parse()
+  {
+    std::string value = parseOr();
+    skipSpaces();
+
+    if (m_pos != m_text.size())
+      throw std::runtime_error("unexpected trailing characters in condition");
+
+    return toBool(value);
+  }
+
+private:
+  static bool toBool(const std::string& value)
+  {
+    if (iequals(value, "true"))
+      return true;
+    else if (iequals(value, "false") || value.empty())
+      return false;
+
+    throw std::runtime_error("expression is not a boolean");
+  }
+
+  static std::string fromBool(bool b)
+  {
+    return b ? "true" : "false";
+  }
+
+  void skipSpaces()
+  {
+    while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos])))
+      ++m_pos;
+  }
+
+  bool consume(const char* token)
+  {
+    skipSpaces();
+
+    size_t n = std::char_traits<char>::length(token);
+
+    if (m_text.compare(m_pos, n, token) != 0)
+      return false;
+
+    m_pos += n;
+    return true;
+  }
+
+  bool consumeKeyword(const char* keyword)
+  {
+    skipSpaces();
+
+    size_t n = std::char_traits<char>::length(keyword);
+
+    if (m_pos + n > m_text.size() || !iequals(m_text.substr(m_pos, n), keyword))
+      return false;
+
+    if (m_pos + n < m_text.size() && (std::isalnum(static_cast<unsigned char>(m_text[m_pos + n])) || m_text[m_pos + n] == '_'))
+      return false;
+
+    m_pos += n;
+    return true;
+  }
+
+  std::string parseOr()
+  {
+    std::string lhs = parseAnd();
+
+    while (consumeKeyword("or"))
+    {
+      std::string rhs = parseAnd();
+      lhs = fromBool(toBool(lhs) || toBool(rhs));
+    }
+
+    return lhs;
+  }
+
+  std::string parseAnd()
+  {
+    std::string lhs = parseUnary();
+
+    while (consumeKeyword("and"))
+    {
+      std::string rhs = parseUnary();
+      lhs = fromBool(toBool(lhs) && toBool(rhs));
+    }
+
+    return lhs;
+  }
+
+  std::string parseUnary()
+  {
+    skipSpaces();
+
+    if (m_pos < m_text.size() && m_text[m_pos] == '!' && m_text.compare(m_pos, 2, "!=") != 0)
+    {
+      ++m_pos;
+      return fromBool(!toBool(parseUnary()));
+    }
+
+    return parseComparison();
+  }
+
+  std::string parseComparison()
+  {
+    std::string lhs = parseOperand();
+
+    for (const char* op : { "==", "!=", "<=", ">=", "<", ">" })
+    {
+      if (consume(op))
+      {
+        std::string rhs = parseOperand();
+        return fromBool(compare(op, lhs, rhs));
+      }
+    }
+
+    return lhs;
+  }
+
+  static bool compare(const std::string& op, const std::string& lhs, const std::string& rhs)
+  {
+    if (op == "==")
+      return lhs.size() == rhs.size() && iequals(lhs, rhs.c_str());
+    else if (op == "!=")
+      return !(lhs.size() == rhs.size() && iequals(lhs, rhs.c_str()));
+
+    // relational operators only apply to numbers
+    double a = std::stod(lhs);
+    double b = std::stod(rhs);
+
+    if (op == "<")
+      return a < b;
+    else if (op == ">")
+      return a > b;
+    else if (op == "<=")
+      return a <= b;
+    else
+      return a >= b;
+  }
+
+  std::string parseOperand()
+  {
+    skipSpaces();
+
+    if (m_pos >= m_text.size())
+      throw std::runtime_error("unexpected end of condition");
+
+    if (m_text[m_pos] == '(')
+    {
+      ++m_pos;
+      std::string value = parseOr();
+
+      if (!consume(")"))
+        throw std::runtime_error("expected ')'");
+
+      return value;
+    }
+
+    if (m_text[m_pos] == '\'')
+      return parseQuotedString();
+
+    size_t begin = m_pos;
+
+    while (m_pos < m_text.size() && (std::isalnum(static_cast<unsigned char>(m_text[m_pos])) || m_text[m_pos] == '_' || m_text[m_pos] == '.'))
+      ++m_pos;
+
+    if (begin == m_pos)
+      throw std::runtime_error("unexpected character in condition");
+
+    std::string word = m_text.substr(begin, m_pos - begin);
+
+    if (consume("("))
+    {
+      std::string arg = parseQuotedString();
+
+      if (!consume(")"))
+        throw std::runtime_error("expected ')'");
+
+      return callFunction(word, arg);
+    }
+
+    return word;
+  }
+
+  std::string parseQuotedString()
+  {
+    skipSpaces();
+
+    if (m_pos >= m_text.size() || m_text[m_pos] != '\'')
+      throw std::runtime_error("expected a quoted string");
+
+    size_t end = m_text.find('\'', m_pos + 1);
+
+    if (end == std::string::npos)
+      throw std::runtime_error("unterminated string");
+
+    std::string value = m_text.substr(m_pos + 1, end - m_pos - 1);
+    m_pos = end + 1;
+
+    return expand_properties(value, m_properties);
+  }
+
+  static std::string callFunction(const std::string& name, const std::string& arg)
+  {
+    if (iequals(name, "exists"))
+    {
+      std::error_code ec;
+      return fromBool(!arg.empty() && std::filesystem::exists(std::filesystem::u8path(arg), ec));
+    }
+    else if (iequals(name, "hastrailingslash"))
+    {
+      return fromBool(!arg.empty() && (arg.back() == '/' || arg.back() == '\\'));
+    }
+
+    throw std::runtime_error("unsupported function in condition");
+  }
+
+private:
+  const std::string& m_text;
+  const Properties& m_properties;
+  size_t m_pos = 0;
+};
+
+} // namespace
+
+/**
+ * \brief evaluates an MSBuild condition
+ * \param condition   the condition, e.g. "'$(Configuration)|$(Platform)'=='Debug|Win32'"
+ * \param properties  the value of the properties referenced by the condition
+ * 
+ * An empty condition evaluates to true.
+ * Conditions that cannot be evaluated evaluate to false.
+ */
+bool evaluate_condition(const std::string& condition, const Properties& properties)
+{
+  if (std::all_of(condition.begin(), condition.end(), [](char c) { return std::isspace(static_cast<unsigned char>(c)); }))
+    return true;
+
+  try
+  {
+    return ConditionParser(condition, properties).parse();
+  }
+  catch (...)
+  {
+    return false;
+  }
+}
+
+} // namespace msbuild
+
+} // namespace clark
@@ -0,0 +1,27 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_MSBUILDCONDITION_H
+#define CLARK_MSBUILDCONDITION_H
+
+#include <map>
+#include <string>
+
+namespace clark
+{
+
+namespace msbuild
+{
+
+using Properties = std::map<std::string, std::string>;
+
+std::string expand_properties(const std::string& str, const Properties& properties);
+
+bool evaluate_condition(const std::string& condition, const Properties& properties);
+
+} // namespace msbuild
+
+} // namespace clark
+
+#endif // CLARK_MSBUILDCONDITION_H
@@ -0,0 +1,264 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "solutionloader.h"
+
+#include <utils/executor.h>
+
+#include <vcxproj/project.h>
+
+#include <QFutureWatcher>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+namespace
+{
+
+struct CachedProject
+{
+  std::filesystem::file_time_type last_write_time;
+  std::shared_ptr<const vcxproj::Project> project;
+};
+
+std::mutex g_project_cache_mutex;
+std::map<std::filesystem::path, CachedProject> g_project_cache;
+
+std::shared_ptr<const vcxproj::Project> load_project_cached(const std::filesystem::path& path)
+{
+  std::error_code ec;
+  std::filesystem::file_time_type mtime = std::filesystem::last_write_time(path, ec);
+
+  if (ec)
+    return nullptr;
+
+  {
+    std::lock_guard<std::mutex> lock{ g_project_cache_mutex };
+    auto it = g_project_cache.find(path);
+
+    if (it != g_project_cache.end() && it->second.last_write_time == mtime)
+      return it->second.project;
+  }
+
+  std::shared_ptr<const vcxproj::Project> project;
+
+  try
+  {
+    project = std::make_shared<const vcxproj::Project>(vcxproj::load_project(path));
+  }
+  catch (...)
+  {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock{ g_project_cache_mutex };
+  g_project_cache[path] = CachedProject{ mtime, project };
+  return project;
+}
+
+// reads the next double-quoted string starting at position 'pos'
+bool read_quoted(const std::string& line, size_t& pos, std::string& out)
+{
+  size_t begin = line.find('"', pos);
+
+  if (begin == std::string::npos)
+    return false;
+
+  size_t end = line.find('"', begin + 1);
+
+  if (end == std::string::npos)
+    return false;
+
+  out = line.substr(begin + 1, end - begin - 1);
+  pos = end + 1;
+  return true;
+}
+
+} // namespace
+
+SolutionLoader::SolutionLoader(QObject* parent) : QObject(parent)
+{
+
+}
+
+SolutionLoader::~SolutionLoader()
+{
+  // pending watchers are children of the loader and get destroyed with it,
+  // projects that are still being parsed will only end up in the cache
+}
+
+/**
+ * \brief reads the list of C++ projects referenced by a solution file
+ * \param slnpath  the path of the solution
+ * 
+ * Lines of the form 
+ * \code
+ *   Project("{GUID}") = "name", "relative\path.vcxproj", "{GUID}"
+ * \endcode
+ * are recognized; projects that are not .vcxproj files are ignored.
+ */
+std::vector<SolutionLoader::ProjectEntry> SolutionLoader::readProjectEntries(const std::filesystem::path& slnpath)
+{
+  std::vector<ProjectEntry> result;
+
+  std::ifstream file{ slnpath };
+
+  if (!file.is_open())
+    throw std::runtime_error("could not open solution file");
+
+  const std::filesystem::path sln_dir = slnpath.parent_path();
+
+  std::string line;
+
+  while (std::getline(file, line))
+  {
+    if (line.rfind("Project(", 0) != 0)
+      continue;
+
+    size_t pos = line.find('=');
+
+    if (pos == std::string::npos)
+      continue;
+
+    ProjectEntry entry;
+    std::string relpath;
+
+    if (!read_quoted(line, pos, entry.name) || !read_quoted(line, pos, relpath))
+      continue;
+
+    for (char& c : relpath)
+    {
+      if (c == '\\')
+        c = '/';
+    }
+
+    std::filesystem::path filepath = std::filesystem::u8path(relpath);
+
+    if (filepath.extension() != ".vcxproj")
+      continue;
+
+    entry.filepath = (sln_dir / filepath).lexically_normal();
+    result.push_back(std::move(entry));
+  }
+
+  return result;
+}
+
+/**
+ * \brief starts loading a solution
+ * \param slnpath  the path of the solution file
+ * 
+ * Returns false if the solution file could not be read.
+ * Projects are loaded asynchronously, on the index executor so that 
+ * they do not delay the parsing of translation units.
+ */
+bool SolutionLoader::load(const QString& slnpath)
+{
+  std::vector<ProjectEntry> entries;
+
+  try
+  {
+    entries = readProjectEntries(std::filesystem::u8path(slnpath.toStdString()));
+  }
+  catch (...)
+  {
+    return false;
+  }
+
+  cancelPendingProjects();
+
+  m_solution = vcxproj::Solution();
+  m_solution.filepath = std::filesystem::u8path(slnpath.toStdString());
+  // reserving upfront keeps pointers to the projects valid while loading
+  m_solution.projects.reserve(entries.size());
+  m_project_count = static_cast<int>(entries.size());
+  m_failed_count = 0;
+
+  if (entries.empty())
+  {
+    QMetaObject::invokeMethod(this, &SolutionLoader::finished, Qt::QueuedConnection);
+    return true;
+  }
+
+  for (const ProjectEntry& entry : entries)
+  {
+    using Watcher = QFutureWatcher<std::shared_ptr<const vcxproj::Project>>;
+
+    auto* watcher = new Watcher(this);
+
+    connect(watcher, &Watcher::finished, this, [this, watcher, entry]() {
+      m_pending_watchers.erase(std::find(m_pending_watchers.begin(), m_pending_watchers.end(), watcher));
+      watcher->deleteLater();
+      onProjectLoaded(entry, watcher->result());
+      });
+
+    m_pending_watchers.push_back(watcher);
+
+    std::filesystem::path path = entry.filepath;
+    watcher->setFuture(Executor::get(Executor::Index).run([path]() { return load_project_cached(path); }));
+  }
+
+  return true;
+}
+
+/**
+ * \brief stops waiting for the projects of the previous solution
+ * 
+ * The projects that are being parsed still end up in the cache.
+ */
+void SolutionLoader::cancelPendingProjects()
+{
+  for (QFutureWatcherBase* watcher : m_pending_watchers)
+  {
+    watcher->disconnect(this);
+    watcher->deleteLater();
+  }
+
+  m_pending_watchers.clear();
+}
+
+const vcxproj::Solution& SolutionLoader::solution() const
+{
+  return m_solution;
+}
+
+int SolutionLoader::projectCount() const
+{
+  return m_project_count;
+}
+
+int SolutionLoader::loadedProjectCount() const
+{
+  return static_cast<int>(m_solution.projects.size());
+}
+
+int SolutionLoader::failedProjectCount() const
+{
+  return m_failed_count;
+}
+
+bool SolutionLoader::isFinished() const
+{
+  return loadedProjectCount() + failedProjectCount() == projectCount();
+}
+
+void SolutionLoader::onProjectLoaded(const ProjectEntry& entry, std::shared_ptr<const vcxproj::Project> project)
+{
+  if (project)
+  {
+    m_solution.projects.push_back(*project);
+    m_solution.projects.back().name = entry.name;
+    Q_EMIT projectLoaded(static_cast<int>(m_solution.projects.size()) - 1);
+  }
+  else
+  {
+    ++m_failed_count;
+    Q_EMIT projectFailed(QString::fromStdString(entry.filepath.u8string()));
+  }
+
+  if (isFinished())
+    Q_EMIT finished();
+}
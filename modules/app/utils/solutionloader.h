@@ -0,0 +1,77 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_SOLUTIONLOADER_H
+#define CLARK_SOLUTIONLOADER_H
+
+// QObject needs to be included before solution.h, see openslndialog.h
+#include <QObject>
+
+class QFutureWatcherBase;
+
+#include <vcxproj/solution.h>
+
+#include <filesystem>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * \brief loads the projects of a Visual Studio solution in the background
+ * 
+ * The solution file is read synchronously (it only lists the projects) 
+ * and the projects are then parsed in parallel.
+ * The projectLoaded() signal is emitted every time a project becomes 
+ * available in solution().
+ * 
+ * Parsed projects are cached for the lifetime of the application and are 
+ * reused as long as the modification time of their file does not change.
+ * 
+ * Loading another solution discards the projects of the previous one that 
+ * are still being parsed.
+ */
+class SolutionLoader : public QObject
+{
+  Q_OBJECT
+public:
+  explicit SolutionLoader(QObject* parent = nullptr);
+  ~SolutionLoader();
+
+  struct ProjectEntry
+  {
+    std::string name;
+    std::filesystem::path filepath;
+  };
+
+  static std::vector<ProjectEntry> readProjectEntries(const std::filesystem::path& slnpath);
+
+  bool load(const QString& slnpath);
+
+  const vcxproj::Solution& solution() const;
+
+  int projectCount() const;
+  int loadedProjectCount() const;
+  int failedProjectCount() const;
+  bool isFinished() const;
+
+Q_SIGNALS:
+  void projectLoaded(int index);
+  void projectFailed(const QString& path);
+  void finished();
+
+protected:
+  void onProjectLoaded(const ProjectEntry& entry, std::shared_ptr<const vcxproj::Project> project);
+
+private:
+  void cancelPendingProjects();
+
+private:
+  std::vector<QFutureWatcherBase*> m_pending_watchers;
+  vcxproj::Solution m_solution;
+  int m_project_count = 0;
+  int m_failed_count = 0;
+};
+
+#endif // CLARK_SOLUTIONLOADER_H
@@ -4,17 +4,107 @@
 
 #include "tufromsln.h"
 
+#include "msbuildcondition.h"
+
 #include "program/translationunit.h"
 
+#include <cctype>
+#include <map>
+#include <mutex>
+#include <string_view>
+
 namespace clark
 {
 
+namespace
+{
+
+std::mutex g_memo_mutex;
+
+// (condition, configuration name) -> result of the evaluation
+std::map<std::pair<std::string, std::string>, bool> g_condition_memo;
+
+// (additionalIncludeDirectories, preprocessorDefinitions) -> interned options;
+// the options are released with the last translation unit using them
+std::map<std::pair<std::string, std::string>, std::weak_ptr<const program::CompileOptions>> g_options_memo;
+
+template<typename F>
+void for_each_item(std::string_view list, F&& f)
+{
+  while (!list.empty())
+  {
+    size_t sep = list.find(';');
+    std::string_view item = list.substr(0, sep);
+
+    while (!item.empty() && std::isspace(static_cast<unsigned char>(item.front())))
+      item.remove_prefix(1);
+
+    while (!item.empty() && std::isspace(static_cast<unsigned char>(item.back())))
+      item.remove_suffix(1);
+
+    // skip empty items and references to item metadata, e.g. %(AdditionalIncludeDirectories)
+    if (!item.empty() && item.find("%(") == std::string_view::npos)
+      f(item);
+
+    if (sep == std::string_view::npos)
+      break;
+
+    list.remove_prefix(sep + 1);
+  }
+}
+
+} // namespace
+
+/**
+ * \brief returns the properties defined by a project configuration
+ * 
+ * A configuration named "Debug|Win32" defines the "Configuration" and 
+ * "Platform" properties.
+ */
+std::map<std::string, std::string> configuration_properties(const vcxproj::ProjectConfiguration& conf)
+{
+  msbuild::Properties props;
+
+  size_t sep = conf.name.find('|');
+  props["Configuration"] = conf.name.substr(0, sep);
+
+  if (sep != std::string::npos)
+    props["Platform"] = conf.name.substr(sep + 1);
+
+  return props;
+}
+
+/**
+ * \brief evaluates an MSBuild condition for a given configuration
+ * 
+ * Results are memoized: the same handful of conditions is usually 
+ * repeated in every project of a solution.
+ */
+bool evaluate_condition(const std::string& condition, const vcxproj::ProjectConfiguration& conf)
+{
+  auto key = std::make_pair(condition, conf.name);
+
+  {
+    std::lock_guard<std::mutex> lock{ g_memo_mutex };
+    auto it = g_condition_memo.find(key);
+
+    if (it != g_condition_memo.end())
+      return it->second;
+  }
+
+  bool result = msbuild::evaluate_condition(condition, configuration_properties(conf));
+
+  std::lock_guard<std::mutex> lock{ g_memo_mutex };
+  g_condition_memo[std::move(key)] = result;
+  return result;
+}
+
 const vcxproj::ItemDefinitionGroup* defgroup4conf(const vcxproj::Project& project, const vcxproj::ProjectConfiguration& conf)
 {
   for (const vcxproj::ItemDefinitionGroup& idg : project.itemDefinitionGroupList)
   {
-    if (idg.condition.find(conf.name) != std::string::npos) // $todo: technically not correct, 
-      return &idg; // 'condition' should be properly evaluated
+    if (evaluate_condition(idg.condition, conf))
+      return &idg;
   }
 
   return nullptr;
@@ -24,40 +114,70 @@ program::CompileOptions idg2copts(const vcxproj::ItemDefinitionGroup& idg)
 {
   program::CompileOptions params;
 
-  QStringList incdirs = QString::fromStdString(idg.additionalIncludeDirectories).split(';');
+  for_each_item(idg.additionalIncludeDirectories, [&params](std::string_view incdir) {
+    params.includedirs.insert(std::string(incdir));
+    });
+
+  for_each_item(idg.preprocessorDefinitions, [&params](std::string_view def) {
+    size_t p = def.find('=');
 
-  for (const QString& incdir : incdirs)
-    params.includedirs.insert(incdir.toStdString());
+    if (p != std::string_view::npos)
+      params.defines[std::string(def.substr(0, p))] = std::string(def.substr(p + 1));
+    else
+      params.defines[std::string(def)] = "";
+    });
+
+  return params;
+}
 
-  QStringList defines = QString::fromStdString(idg.preprocessorDefinitions).split(';');
+/**
+ * \brief returns the interned compile options of an item definition group
+ * 
+ * The conversion is memoized on the content of the group so that 
+ * translation units of the same project share one options object.
+ * The memo does not keep the options alive: like program::intern(), it 
+ * only refers to options that are still in use.
+ */
+std::shared_ptr<const program::CompileOptions> idg2sharedcopts(const vcxproj::ItemDefinitionGroup& idg)
+{
+  auto key = std::make_pair(idg.additionalIncludeDirectories, idg.preprocessorDefinitions);
 
-  for (const QString& def : defines)
   {
-    int p = def.indexOf('=');
+    std::lock_guard<std::mutex> lock{ g_memo_mutex };
+    auto it = g_options_memo.find(key);
 
-    if (p != -1)
+    if (it != g_options_memo.end())
     {
-      std::string name = def.mid(0, p).toStdString();
-      std::string value = def.mid(p + 1).toStdString();
-      params.defines[name] = value;
+      if (std::shared_ptr<const program::CompileOptions> opts = it->second.lock())
+        return opts;
     }
+  }
+
+  std::shared_ptr<const program::CompileOptions> result = program::intern(idg2copts(idg));
+
+  std::lock_guard<std::mutex> lock{ g_memo_mutex };
+
+  // drop the entries of the solutions that were closed
+  for (auto it = g_options_memo.begin(); it != g_options_memo.end(); )
+  {
+    if (it->second.expired())
+      it = g_options_memo.erase(it);
     else
-    {
-      params.defines[def.toStdString()] = "";
-    }
+      ++it;
   }
 
-  return params;
+  g_options_memo[std::move(key)] = result;
+  return result;
 }
 
 std::unique_ptr<TranslationUnit> sln2tu(const vcxproj::Project& project, const vcxproj::ProjectConfiguration& conf, const std::string& compile)
 {
   const vcxproj::ItemDefinitionGroup* idg = defgroup4conf(project, conf);
 
-  program::CompileOptions params = idg2copts(*idg);
-
   auto tu = std::make_unique<TranslationUnit>(QString::fromStdString(compile));
-  tu->setCompileOptions(params);
+
+  if (idg)
+    tu->setCompileOptions(idg2sharedcopts(*idg));
 
   return tu;
 }
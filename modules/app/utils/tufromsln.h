@@ -7,7 +7,9 @@
 
 #include <vcxproj/project.h>
 
+#include <map>
 #include <memory>
+#include <string>
 
 class TranslationUnit;
 
@@ -19,9 +21,13 @@ struct CompileOptions;
 namespace clark
 {
 
+std::map<std::string, std::string> configuration_properties(const vcxproj::ProjectConfiguration& conf);
+bool evaluate_condition(const std::string& condition, const vcxproj::ProjectConfiguration& conf);
+
 const vcxproj::ItemDefinitionGroup* defgroup4conf(const vcxproj::Project& project, const vcxproj::ProjectConfiguration& conf);
 
 program::CompileOptions idg2copts(const vcxproj::ItemDefinitionGroup& idg);
+std::shared_ptr<const program::CompileOptions> idg2sharedcopts(const vcxproj::ItemDefinitionGroup& idg);
 
 std::unique_ptr<TranslationUnit> sln2tu(const vcxproj::Project& project, const vcxproj::ProjectConfiguration& conf, const std::string& compile);
 
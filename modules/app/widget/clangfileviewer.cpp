@@ -5,7 +5,7 @@
 #include "clangfileviewer.h"
 
 #include "sema/clangsyntaxhighlighter.h"
-#include "sema/tusymbolinfoprovider.h"
+#include "sema/indexedsymbolinfoprovider.h"
 
 #include <libclang-utils/clang-translation-unit.h>
 
@@ -13,16 +13,20 @@
  * \brief constructs a file viewer
  * \param thandle  a valid handle to the translation unit
  * \param file     the file
+ * \param indexing optional indexing of the translation unit
  * \param parent   optional parent widget
  * 
  * The path and content of \a file are retrieved from the translation unit.
  */
-ClangFileViewer::ClangFileViewer(const TranslationUnitHandle& thandle, const libclang::File& file, QWidget* parent) :
+ClangFileViewer::ClangFileViewer(const TranslationUnitHandle& thandle, const libclang::File& file, TranslationUnitIndexing* indexing, QWidget* parent) :
   CodeViewer(file.getFileName().c_str(), thandle.clangTranslationunit().getFileContents(file), parent),
   m_thandle(thandle),
   m_file(file)
 {
-  setup(this, thandle, file);
+  // connected before the highlighter so that the text is up-to-date when it runs
+  connect(m_thandle.translationUnit(), &TranslationUnit::reparsed, this, &ClangFileViewer::onTranslationUnitReparsed);
+
+  setup(this, thandle, file, indexing);
 }
 
 const libclang::File& ClangFileViewer::file() const
@@ -30,11 +34,35 @@ const libclang::File& ClangFileViewer::file() const
   return m_file;
 }
 
+/**
+ * \brief updates the content of the viewer after the translation unit was reparsed
+ * 
+ * The content may have changed on disk or through an unsaved-file overlay 
+ * of the ClangIndex.
+ */
+void ClangFileViewer::onTranslationUnitReparsed()
+{
+  const libclang::TranslationUnit& tu = m_thandle.clangTranslationunit();
+  m_file = tu.getFile(m_file.getFileName());
+  updateDocumentContent(tu.getFileContents(m_file));
+}
+
 /**
  * \brief install a syntax highlighter and symbol info provider on the codeviewer
  */
-void ClangFileViewer::setup(CodeViewer* viewer, const TranslationUnitHandle& thandle, const libclang::File& file)
+void ClangFileViewer::setup(CodeViewer* viewer, const TranslationUnitHandle& thandle, const libclang::File& file, TranslationUnitIndexing* indexing)
 {
   viewer->setSyntaxHighlighter(new ClangSyntaxHighlighter(thandle, file, viewer->document()));
-  viewer->setSymbolInfoProvider(new TranslationUnitSymbolInfoProvider(thandle, *viewer->document()));
+  viewer->setSymbolInfoProvider(new IndexedSymbolInfoProvider(thandle, *viewer->document(), indexing));
+}
+
+/**
+ * \brief sets the indexing used to find the references to a symbol
+ * 
+ * This has no effect if the viewer was not set up with setup().
+ */
+void ClangFileViewer::setIndexing(CodeViewer* viewer, TranslationUnitIndexing* indexing)
+{
+  if (auto* provider = qobject_cast<IndexedSymbolInfoProvider*>(viewer->symbolInfoProvider()))
+    provider->setIndexing(indexing);
 }
@@ -11,6 +11,8 @@
 
 #include <libclang-utils/clang-file.h>
 
+class TranslationUnitIndexing;
+
 /**
  * \brief a code viewer for libclang files
  */
@@ -18,11 +20,15 @@ class ClangFileViewer : public CodeViewer
 {
   Q_OBJECT
 public:
-  ClangFileViewer(const TranslationUnitHandle& thandle, const libclang::File& file, QWidget* parent = nullptr);
+  ClangFileViewer(const TranslationUnitHandle& thandle, const libclang::File& file, TranslationUnitIndexing* indexing = nullptr, QWidget* parent = nullptr);
   
   const libclang::File& file() const;
 
-  static void setup(CodeViewer* viewer, const TranslationUnitHandle& thandle, const libclang::File& file);
+  static void setup(CodeViewer* viewer, const TranslationUnitHandle& thandle, const libclang::File& file, TranslationUnitIndexing* indexing = nullptr);
+  static void setIndexing(CodeViewer* viewer, TranslationUnitIndexing* indexing);
+
+protected Q_SLOTS:
+  void onTranslationUnitReparsed();
 
 private:
   TranslationUnitHandle m_thandle;
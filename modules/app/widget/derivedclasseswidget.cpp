@@ -51,18 +51,36 @@ void DerivedClassesWidget::setIndexing(TranslationUnitIndexing* idx)
   m_bases.clear();
   m_classes.clear();
 
+  if (m_indexing)
+    disconnect(m_indexing, nullptr, this, nullptr);
+
   m_indexing = idx;
+  m_indexing_result = m_indexing ? m_indexing->sharedIndexingResult() : nullptr;
 
   if (m_indexing)
   {
-    init(idx->indexingResult());
+    if (m_indexing_result)
+      init(*m_indexing_result);
+
     connect(m_indexing, &QObject::destroyed, this, &DerivedClassesWidget::clear);
+    connect(m_indexing, &TranslationUnitIndexing::ready, this, &DerivedClassesWidget::onIndexingReady);
   }
 
   fillCombobox();
   fillTree();
 }
 
+/**
+ * \brief fills the widget again from the new indexing result
+ */
+void DerivedClassesWidget::onIndexingReady()
+{
+  m_indexing_result = m_indexing->sharedIndexingResult();
+  init(*m_indexing_result);
+  fillCombobox();
+  fillTree();
+}
+
 void DerivedClassesWidget::clear()
 {
   setIndexing(nullptr);
@@ -9,6 +9,7 @@
 #include <QWidget>
 
 #include <map>
+#include <memory>
 #include <vector>
 
 class QComboBox;
@@ -29,6 +30,9 @@ public:
 
   void clear();
 
+protected Q_SLOTS:
+  void onIndexingReady();
+
 protected:
   void init(const clark::IndexingResult& idx);
   void fillCombobox();
@@ -37,6 +41,7 @@ protected:
 
 private:
   TranslationUnitIndexing* m_indexing = nullptr;
+  std::shared_ptr<const clark::IndexingResult> m_indexing_result; // owns the entities of the tables
   std::vector<clark::BaseClass> m_bases;
   struct DerivationInfo { size_t offset = 0; size_t count = 0; };
   std::map<const clark::Entity*, DerivationInfo> m_derivation_table;
@@ -42,14 +42,11 @@ void FileWidget::setIndexing(TranslationUnitIndexing* idx)
       setIndexing(nullptr);
       });
 
-    if (!m_indexing->isReady())
-    {
-      connect(m_indexing, &TranslationUnitIndexing::ready, this, &FileWidget::fillItems);
-    }
-    else
-    {
+    // the list is filled again when the translation unit is indexed again
+    connect(m_indexing, &TranslationUnitIndexing::ready, this, &FileWidget::fillItems);
+
+    if (m_indexing->isReady())
       fillItems();
-    }
   }
 }
 
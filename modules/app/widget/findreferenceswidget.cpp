@@ -6,17 +6,22 @@
 
 #include <indexing/indexer.h>
 
+#include <utils/executor.h>
+#include <utils/telemetry.h>
+
 #include <QTreeWidget>
 
 #include <QVBoxLayout>
 
-#include <QtConcurrent>
+#include <QFutureWatcher>
 
 #include <algorithm>
 #include <iterator>
 
 static QList<clark::EntityReference> find_references(const clark::IndexingResult* index, const clark::Entity* entity)
 {
+  clark::telemetry::ScopedSpan span{ clark::telemetry::Category::Query, "find references" };
+
   QList<clark::EntityReference> result;
 
   std::copy_if(index->references.begin(), index->references.end(), std::back_inserter(result), [entity](const clark::EntityReference& eref) {
@@ -78,11 +83,16 @@ void FindReferencesWidget::setIndexing(TranslationUnitIndexing* idx)
   if (m_indexing == idx)
     return;
 
+  if (m_indexing)
+    disconnect(m_indexing, nullptr, this, nullptr);
+
   m_indexing = idx;
+  m_indexing_result = m_indexing ? m_indexing->sharedIndexingResult() : nullptr;
 
   if (m_indexing)
   {
     connect(m_indexing, &QObject::destroyed, this, &FindReferencesWidget::clear);
+    connect(m_indexing, &TranslationUnitIndexing::ready, this, &FindReferencesWidget::onIndexingReady);
   }
 
   computeReferences();
@@ -100,6 +110,9 @@ void FindReferencesWidget::setEntity(const clark::Entity* e)
 
   m_entity = e;
 
+  // the entity belongs to the current indexing result
+  m_indexing_result = m_indexing ? m_indexing->sharedIndexingResult() : nullptr;
+
   computeReferences();
 }
 
@@ -110,19 +123,34 @@ void FindReferencesWidget::clear()
 
 void FindReferencesWidget::computeReferences()
 {
-  if (!m_indexing)
+  if (!m_indexing || !m_indexing_result)
   {
     fillTree({});
     return;
   }
 
-  QFuture<QList<clark::EntityReference>> f = QtConcurrent::run(find_references, &indexing()->indexingResult(), entity());
+  QFuture<QList<clark::EntityReference>> f = Executor::get(Executor::Interactive).run([index = m_indexing_result, e = entity()]() {
+    return find_references(index.get(), e);
+    });
   auto watcher = new QFutureWatcher<QList<clark::EntityReference>>(this);
   connect(watcher, &QFutureWatcher<QList<clark::EntityReference>>::finished, this, &FindReferencesWidget::onReferencesComputationFinished);
   watcher->setFuture(f);
   m_references_future = watcher;
 }
 
+/**
+ * \brief looks up the entity in the new indexing result and computes its references again
+ */
+void FindReferencesWidget::onIndexingReady()
+{
+  std::string usr = m_entity ? m_entity->usr : std::string();
+
+  m_indexing_result = m_indexing->sharedIndexingResult();
+  m_entity = (!usr.empty() && m_indexing_result) ? clark::find_entity(*m_indexing_result, usr) : nullptr;
+
+  computeReferences();
+}
+
 void FindReferencesWidget::onReferencesComputationFinished()
 {
   auto* watcher = qobject_cast<QFutureWatcherBase*>(sender());
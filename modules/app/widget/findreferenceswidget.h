@@ -12,6 +12,7 @@
 #include <QList>
 
 #include <map>
+#include <memory>
 #include <vector>
 
 class QComboBox;
@@ -41,6 +42,7 @@ Q_SIGNALS:
 
 protected Q_SLOTS:
   void computeReferences();
+  void onIndexingReady();
   void onReferencesComputationFinished();
   void onTreeItemDoubleClicked(QTreeWidgetItem* item);
 
@@ -50,6 +52,7 @@ protected:
 
 private:
   TranslationUnitIndexing* m_indexing = nullptr;
+  std::shared_ptr<const clark::IndexingResult> m_indexing_result;
   const clark::Entity* m_entity = nullptr;
   QFutureWatcher<QList<clark::EntityReference>>* m_references_future = nullptr;
   QTreeWidget* m_tree_widget = nullptr;
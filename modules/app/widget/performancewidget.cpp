@@ -0,0 +1,133 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "performancewidget.h"
+
+#include <utils/telemetry.h>
+
+#include <QFile>
+#include <QFileDialog>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QTimer>
+
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+
+static QString format_duration(int64_t us)
+{
+  if (us < 1000)
+    return QString::number(us) + "us";
+  else if (us < 1000 * 1000)
+    return QString::number(us / 1000.0, 'f', 1) + "ms";
+  else
+    return QString::number(us / (1000.0 * 1000.0), 'f', 2) + "s";
+}
+
+PerformanceWidget::PerformanceWidget(QWidget* parent) : QWidget(parent)
+{
+  m_table = new QTableWidget(static_cast<int>(clark::telemetry::CategoryCount), 7);
+  m_refresh_timer = new QTimer(this);
+
+  {
+    m_table->setHorizontalHeaderLabels({ "Operation", "Count", "Mean", "p50", "p90", "p99", "Max" });
+    m_table->verticalHeader()->setVisible(false);
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->setSelectionMode(QAbstractItemView::NoSelection);
+  }
+
+  auto* export_button = new QPushButton("Export trace...");
+  auto* clear_button = new QPushButton("Clear");
+
+  auto* layout = new QVBoxLayout;
+  {
+    layout->addWidget(m_table);
+
+    auto* buttons = new QHBoxLayout;
+    buttons->addStretch();
+    buttons->addWidget(clear_button);
+    buttons->addWidget(export_button);
+    layout->addLayout(buttons);
+  }
+  setLayout(layout);
+
+  m_refresh_timer->setInterval(1000);
+
+  connect(m_refresh_timer, &QTimer::timeout, this, &PerformanceWidget::refresh);
+  connect(export_button, &QPushButton::clicked, this, &PerformanceWidget::exportTrace);
+  connect(clear_button, &QPushButton::clicked, this, &PerformanceWidget::clear);
+
+  refresh();
+}
+
+void PerformanceWidget::refresh()
+{
+  for (size_t i(0); i < clark::telemetry::CategoryCount; ++i)
+  {
+    auto category = static_cast<clark::telemetry::Category>(i);
+    clark::telemetry::Histogram h = clark::telemetry::Recorder::instance().histogram(category);
+
+    QStringList values = {
+      clark::telemetry::category_name(category),
+      QString::number(h.count()),
+      format_duration(h.mean()),
+      format_duration(h.percentile(0.5)),
+      format_duration(h.percentile(0.9)),
+      format_duration(h.percentile(0.99)),
+      format_duration(h.max()),
+    };
+
+    for (int col(0); col < values.size(); ++col)
+    {
+      QTableWidgetItem* item = m_table->item(static_cast<int>(i), col);
+
+      if (!item)
+      {
+        item = new QTableWidgetItem;
+        m_table->setItem(static_cast<int>(i), col, item);
+      }
+
+      item->setText(values.at(col));
+    }
+  }
+}
+
+void PerformanceWidget::exportTrace()
+{
+  QString path = QFileDialog::getSaveFileName(this, "Export trace", QString(), "Trace files (*.json)");
+
+  if (path.isEmpty())
+    return;
+
+  QFile file{ path };
+
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    QMessageBox::warning(this, "Export trace", "Could not open " + path + " for writing.");
+    return;
+  }
+
+  file.write(clark::telemetry::Recorder::instance().toChromeTrace());
+}
+
+void PerformanceWidget::clear()
+{
+  clark::telemetry::Recorder::instance().clear();
+  refresh();
+}
+
+void PerformanceWidget::showEvent(QShowEvent* ev)
+{
+  QWidget::showEvent(ev);
+  refresh();
+  m_refresh_timer->start();
+}
+
+void PerformanceWidget::hideEvent(QHideEvent* ev)
+{
+  m_refresh_timer->stop();
+  QWidget::hideEvent(ev);
+}
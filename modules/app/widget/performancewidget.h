@@ -0,0 +1,33 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#pragma once
+
+#include <QWidget>
+
+class QTableWidget;
+class QTimer;
+
+/**
+ * \brief displays the latency histograms recorded by the telemetry
+ */
+class PerformanceWidget : public QWidget
+{
+  Q_OBJECT
+public:
+  explicit PerformanceWidget(QWidget* parent = nullptr);
+
+public Q_SLOTS:
+  void refresh();
+  void exportTrace();
+  void clear();
+
+protected:
+  void showEvent(QShowEvent* ev) override;
+  void hideEvent(QHideEvent* ev) override;
+
+private:
+  QTableWidget* m_table = nullptr;
+  QTimer* m_refresh_timer = nullptr;
+};
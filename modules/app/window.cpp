@@ -17,33 +17,42 @@
 #include "widget/derivedclasseswidget.h"
 #include "widget/filewidget.h"
 #include "widget/findreferenceswidget.h"
+#include "widget/performancewidget.h"
 
 #include "application.h"
+#include "clangindexregistry.h"
 #include "settings.h"
 
+#include <sema/indexedfileinfoprovider.h>
 #include <sema/tusymbolinfoprovider.h>
 
+#include <indexing/entity.h>
 #include <indexing/indexer.h>
 
 #include <codeviewer/codeviewer.h>
 #include <codeviewer/syntaxhighlighter.h>
 
 #include <program/clangindex.h>
+#include <program/compilationdatabase.h>
 #include <program/libclang.h>
 
+#include <utils/executor.h>
 #include <utils/io.h>
 
 #include <libclang-utils/clang-translation-unit.h>
 
 #include <QAction>
 #include <QDockWidget>
+#include <QFileSystemWatcher>
 #include <QMenu>
 #include <QMenuBar>
 #include <QSplitter>
 #include <QStatusBar>
 #include <QTabWidget>
 
+#include <QDir>
 #include <QFileDialog>
+#include <QFutureWatcher>
 #include <QMessageBox>
 
 #include <QHBoxLayout>
@@ -53,6 +62,8 @@
 
 #include <QDebug>
 
+#include <algorithm>
+
 Window::Window(Application& app, TranslationUnit* tu) :
   m_app(app)
 {
@@ -73,6 +84,8 @@ void Window::setupUi()
     QMenu* menu = menuBar()->addMenu("&File");
     m_new_tu_action = menu->addAction("New Translation Unit...", this, &Window::newTranslationUnit);
 
+    m_open_compiledb_action = menu->addAction("Open Compilation Database...", this, &Window::openCompilationDatabase);
+
     m_close_action = menu->addAction("&Close", this, &Window::closeTranslationUnit);
 
     menu->addSeparator();
@@ -86,6 +99,8 @@ void Window::setupUi()
     m_astview_action = menu->addAction("AST", this, &Window::createAstView);
     m_view_symbols_action = menu->addAction("Symbols", this, &Window::createEntityView);
     m_view_derivedclasses_action = menu->addAction("Derived classes", this, &Window::createDerivedClassesWidget);
+    menu->addSeparator();
+    menu->addAction("Performance", this, &Window::createPerformanceWidget);
   }
 
   {
@@ -104,6 +119,9 @@ void Window::setupUi()
 
   setCentralWidget(m_documents_tab_widget);
 
+  m_file_watcher = new QFileSystemWatcher(this);
+  connect(m_file_watcher, &QFileSystemWatcher::fileChanged, this, &Window::onFileChanged);
+
   statusBar()->showMessage("Hello World!", 500);
 
   refreshUi();
@@ -125,20 +143,20 @@ void Window::setTranslationUnit(TranslationUnit* tu)
   {
     closeTranslationUnit();
 
+    // translation units are shared between windows
+    if (tu && !tu->clangIndex())
+      tu = m_app.dependency<ClangIndexRegistry>().addTranslationUnit(tu);
+
     m_translation_unit = tu;
 
     if (m_translation_unit)
     {
-      if (!m_translation_unit->clangIndex())
-      {
-        LibClang& lib = m_app.get<LibClang>();
-        auto* index = new ClangIndex(lib, this);
-        m_translation_unit->setClangIndex(index);
-      }
+      // the index can be used before the translation unit is loaded
+      setupTranslationUnitIndexing();
 
       if (m_translation_unit->isLoaded())
       {
-        m_handle.reset(*m_translation_unit);
+        onTranslationUnitLoaded();
       }
       else
       {
@@ -183,20 +201,14 @@ void Window::newTranslationUnit()
   if (path.isEmpty())
     return;
 
-  vcxproj::Solution solution;
+  OpenSlnDialog dialog{ this };
 
-  try
-  {
-    solution = vcxproj::load_solution(path.toStdString());
-  }
-  catch (...)
+  if (!dialog.load(path))
   {
     QMessageBox::warning(this, "Visual Studio Solution", "Failed to open Visual Studio Solution.", QMessageBox::Ok);
     return;
   }
 
-  OpenSlnDialog dialog{ solution, this };
-  
   if (dialog.exec() != QDialog::Accepted)
     return;
 
@@ -209,6 +221,78 @@ void Window::newTranslationUnit()
   }
 }
 
+void Window::openCompilationDatabase()
+{
+  QString path = QFileDialog::getOpenFileName(this, "Open Compilation Database", QString(), QString("Compilation Database (*.json)"));
+
+  if (path.isEmpty())
+    return;
+
+  statusBar()->showMessage("Loading compilation database...");
+  m_open_compiledb_action->setEnabled(false);
+
+  using Watcher = QFutureWatcher<std::vector<TranslationUnit*>>;
+  auto* watcher = new Watcher(this);
+
+  connect(watcher, &Watcher::finished, this, [this, watcher, path]() {
+    watcher->deleteLater();
+    m_open_compiledb_action->setEnabled(true);
+    onCompilationDatabaseLoaded(path, watcher->result());
+    });
+
+  QThread* target_thread = thread();
+
+  watcher->setFuture(Executor::get(Executor::Parse).run([path, target_thread]() {
+    program::CompilationDatabaseLoader loader;
+    loader.setTargetThread(target_thread);
+
+    try
+    {
+      return loader.load(path.toStdString());
+    }
+    catch (...)
+    {
+      return std::vector<TranslationUnit*>();
+    }
+    }));
+}
+
+void Window::onCompilationDatabaseLoaded(const QString& path, std::vector<TranslationUnit*> tus)
+{
+  statusBar()->clearMessage();
+
+  if (tus.empty())
+  {
+    QMessageBox::warning(this, "Compilation Database", "Failed to open Compilation Database.", QMessageBox::Ok);
+    return;
+  }
+
+  QString source = QFileDialog::getOpenFileName(this, "Open Translation Unit", QFileInfo(path).absolutePath(),
+    QString("C/C++ source files (*.c *.cc *.cpp *.cxx *.c++)"));
+
+  source = QDir::cleanPath(QDir::fromNativeSeparators(source));
+
+  auto it = std::find_if(tus.begin(), tus.end(), [&source](const TranslationUnit* tu) {
+    return tu->filePath() == source;
+    });
+
+  if (it == tus.end())
+  {
+    if (!source.isEmpty())
+      QMessageBox::warning(this, "Compilation Database", "The file is not part of the Compilation Database.", QMessageBox::Ok);
+
+    qDeleteAll(tus);
+    return;
+  }
+
+  const size_t index = std::distance(tus.begin(), it);
+  tus = m_app.dependency<ClangIndexRegistry>().addTranslationUnits(tus);
+
+  setTranslationUnit(tus.at(index));
+
+  statusBar()->showMessage(QString("%1 translation units added.").arg(tus.size()), 2000);
+}
+
 void Window::showEvent(QShowEvent* ev)
 {
   QMainWindow::showEvent(ev);
@@ -231,6 +315,7 @@ void Window::refreshUi()
   bool has_idx = translationUnitIndexing() != nullptr;
 
   m_new_tu_action->setEnabled(m_app.get<LibClang>().libclangAvailable());
+  m_open_compiledb_action->setEnabled(m_app.get<LibClang>().libclangAvailable());
   m_close_action->setEnabled(has_tunit);
   m_view_files_action->setEnabled(has_idx);
   m_astview_action->setEnabled(has_tunit);
@@ -246,7 +331,22 @@ void Window::onTranslationUnitLoaded()
 
   statusBar()->showMessage("Done!", 500);
 
-  m_translation_unit_indexing = new TranslationUnitIndexing(*m_translation_unit, this);
+  // takes the result of the single-pass indexing, if any, even if a worker is indexing the translation unit
+  m_translation_unit_indexing->start();
+
+  refreshUi();
+}
+
+/**
+ * \brief gets the indexing of the translation unit
+ * 
+ * The indexing is shared with the other windows showing the same translation unit; 
+ * if another window already indexed it, viewers can navigate includes with 
+ * the index while the translation unit is loading.
+ */
+void Window::setupTranslationUnitIndexing()
+{
+  m_translation_unit_indexing = &m_app.dependency<ClangIndexRegistry>().indexing(*m_translation_unit);
 
   connect(m_translation_unit_indexing, &TranslationUnitIndexing::started, this, [this]() {
     statusBar()->showMessage("Indexing...");
@@ -254,14 +354,61 @@ void Window::onTranslationUnitLoaded()
 
   connect(m_translation_unit_indexing, &TranslationUnitIndexing::ready, this, &Window::onTranslationUnitIndexingReady);
 
-  m_translation_unit_indexing->start();
-
-  refreshUi();
+  if (m_translation_unit_indexing->isReady())
+    onTranslationUnitIndexingReady();
 }
 
 void Window::onTranslationUnitIndexingReady()
 {
   const clark::IndexingResult& idx = translationUnitIndexing()->indexingResult();
+
+  // namespaces and types of the project are highlighted in viewers that 
+  // do not use the translation unit
+  {
+    auto names = std::make_shared<KnownNames>();
+
+    for (const auto& p : idx.symbols)
+    {
+      const clark::Entity& e = *p.second;
+
+      switch (e.kind)
+      {
+      case clark::Whatsit::CXXNamespace:
+      case clark::Whatsit::CXXNamespaceAlias:
+        names->namespaces.insert(e.name);
+        break;
+      case clark::Whatsit::Typedef:
+      case clark::Whatsit::Enum:
+      case clark::Whatsit::Struct:
+      case clark::Whatsit::Union:
+      case clark::Whatsit::CXXClass:
+      case clark::Whatsit::CXXTypeAlias:
+        if (!e.name.empty())
+          names->types.insert(e.name);
+        break;
+      default:
+        break;
+      }
+    }
+
+    m_known_names = std::move(names);
+  }
+
+  for (int i(0); i < m_documents_tab_widget->count(); ++i)
+  {
+    auto* viewer = qobject_cast<CodeViewer*>(m_documents_tab_widget->widget(i));
+
+    if (viewer)
+    {
+      applyKnownNames(viewer);
+
+      if (qobject_cast<ClangFileViewer*>(viewer) || viewer->symbolInfoProvider())
+        ClangFileViewer::setIndexing(viewer, translationUnitIndexing());
+      else
+        setIndexedFileInfoProvider(viewer);
+    }
+  }
+
   int duration = std::chrono::duration_cast<std::chrono::milliseconds>(idx.indexing_time).count();
   statusBar()->showMessage(QString("Indexing completed! (%1ms)").arg(QString::number(duration)), 500);
 
@@ -280,12 +427,28 @@ QDockWidget* Window::dock(QWidget* w, Qt::DockWidgetArea area)
 
 void Window::onTabCloseRequested(int index)
 {
+  if (auto* viewer = qobject_cast<CodeViewer*>(m_documents_tab_widget->widget(index)))
+    m_file_watcher->removePath(viewer->documentPath());
+
   m_documents_tab_widget->widget(index)->deleteLater();
   m_documents_tab_widget->removeTab(index);
 }
 
+void Window::onFileChanged(const QString& path)
+{
+  // some editors save by replacing the file, which removes it from the watcher
+  if (clark::io::exists(path) && !m_file_watcher->files().contains(path))
+    m_file_watcher->addPath(path);
+
+  if (m_translation_unit)
+    m_translation_unit->clangIndex()->notifyFileChanged(path);
+}
+
 void Window::closeAllDocuments()
 {
+  if (!m_file_watcher->files().isEmpty())
+    m_file_watcher->removePaths(m_file_watcher->files());
+
   // Delete all widgets that may hold a handle to a translation unit
   while (m_documents_tab_widget->count() > 0)
   {
@@ -311,7 +474,7 @@ void Window::onHandleReady()
       continue;
     }
 
-    ClangFileViewer::setup(viewer, translationUnitHandle(), f);
+    ClangFileViewer::setup(viewer, translationUnitHandle(), f, translationUnitIndexing());
     connect(viewer, &CodeViewer::symbolUnderCursorClicked, this, &Window::onSymbolClicked);
     connect(viewer, &CodeViewer::includeDirectiveClicked, this, &Window::gotoDocument);
   }
@@ -328,11 +491,16 @@ void Window::closeTranslationUnit()
   {
     if (m_translation_unit_indexing->parent() == this)
       delete m_translation_unit_indexing;
+    else
+      disconnect(m_translation_unit_indexing, nullptr, this, nullptr);
 
     m_translation_unit_indexing = nullptr;
   }
   
   m_handle.reset();
+  m_known_names.reset();
+
+  disconnect(m_translation_unit, nullptr, this, nullptr);
 
   if (m_translation_unit->parent() == this)
     m_translation_unit->deleteLater();
@@ -355,7 +523,7 @@ bool Window::openDocument(const QString& path)
       return openFileOnDisk(path);
     }
 
-    auto* viewer = new ClangFileViewer(translationUnitHandle(), f);
+    auto* viewer = new ClangFileViewer(translationUnitHandle(), f, translationUnitIndexing());
 
     addCodeviewer(viewer);
 
@@ -375,10 +543,15 @@ bool Window::openFileOnDisk(const QString& path)
   QString document_content = QString::fromUtf8(clark::io::read_from_disk(path));
 
   auto* viewer = new CodeViewer(path, document_content);
+  applyKnownNames(viewer);
 
   constexpr bool connect_signals = false;
   addCodeviewer(viewer, connect_signals);
 
+  // the includes are completed once the indexing is ready
+  if (translationUnitIndexing())
+    setIndexedFileInfoProvider(viewer);
+
   return true;
 }
 
@@ -418,6 +591,9 @@ void Window::addCodeviewer(CodeViewer* viewer, bool connectSignals)
   int tabindex = m_documents_tab_widget->addTab(viewer, QFileInfo(path).fileName());
   m_documents_tab_widget->setTabToolTip(tabindex, path);
 
+  if (clark::io::exists(path))
+    m_file_watcher->addPath(path);
+
   if (connectSignals)
   {
     connect(viewer, &CodeViewer::symbolUnderCursorClicked, this, &Window::onSymbolClicked);
@@ -425,6 +601,24 @@ void Window::addCodeviewer(CodeViewer* viewer, bool connectSignals)
   }
 }
 
+void Window::applyKnownNames(CodeViewer* viewer)
+{
+  if (!m_known_names)
+    return;
+
+  if (auto* highlighter = qobject_cast<CpptokSyntaxHighlighter*>(viewer->syntaxHighlighter()))
+    highlighter->nameHighlighter().setKnownNames(m_known_names);
+}
+
+/**
+ * \brief lets a viewer that does not use the translation unit navigate includes using the index
+ */
+void Window::setIndexedFileInfoProvider(CodeViewer* viewer)
+{
+  viewer->setSymbolInfoProvider(new IndexedFileInfoProvider(translationUnitIndexing()));
+  connect(viewer, &CodeViewer::includeDirectiveClicked, this, &Window::gotoDocument, Qt::UniqueConnection);
+}
+
 CodeViewer* Window::findCodeviewer(const QString& path) const
 {
   if (path.contains('\\'))
@@ -532,6 +726,13 @@ void Window::createDerivedClassesWidget()
     });
 }
 
+void Window::createPerformanceWidget()
+{
+  auto* v = new PerformanceWidget;
+  v->setWindowTitle("Performance");
+  dock(v, Qt::DockWidgetArea::BottomDockWidgetArea);
+}
+
 void Window::createFindReferencesWidget(const clark::Entity* e)
 {
   auto* v = new FindReferencesWidget(translationUnitIndexing(), e);
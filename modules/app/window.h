@@ -9,7 +9,10 @@
 
 #include <QMainWindow>
 
+#include <memory>
+
 class QAction;
+class QFileSystemWatcher;
 
 namespace libclang
 {
@@ -22,7 +25,9 @@ struct Entity;
 } // namespace clark
 
 class Application;
+class ClangIndex;
 class CodeViewer;
+struct KnownNames;
 class TranslationUnitIndexing;
 
 class Window : public QMainWindow
@@ -45,6 +50,7 @@ public:
 protected Q_SLOTS:
   void about();
   void newTranslationUnit();
+  void openCompilationDatabase();
   void refreshUi();
 
 protected:
@@ -61,14 +67,19 @@ protected Q_SLOTS:
 protected:
   QDockWidget* dock(QWidget* w, Qt::DockWidgetArea area);
   void onTabCloseRequested(int index);
+  void onFileChanged(const QString& path);
   void onHandleReady();
+  void setupTranslationUnitIndexing();
 
+  void onCompilationDatabaseLoaded(const QString& path, std::vector<TranslationUnit*> tus);
   void closeTranslationUnit();
   bool openDocument(const QString& path);
   bool openFileOnDisk(const QString& path);
   void gotoDocument(const QString& path);
   void gotoDocumentLine(const QString& path, int l);
   void addCodeviewer(CodeViewer* viewer, bool connectSignals = true);
+  void applyKnownNames(CodeViewer* viewer);
+  void setIndexedFileInfoProvider(CodeViewer* viewer);
   CodeViewer* findCodeviewer(const QString& path) const;
   void onSymbolClicked();
 
@@ -81,6 +92,8 @@ protected:
 
   void createDerivedClassesWidget();
 
+  void createPerformanceWidget();
+
   void checkLibClangPath();
 
   void openSettingsDialog();
@@ -89,11 +102,13 @@ private:
   TranslationUnit* m_translation_unit = nullptr;
   TranslationUnitHandle m_handle;
   TranslationUnitIndexing* m_translation_unit_indexing = nullptr;
+  std::shared_ptr<const KnownNames> m_known_names;
 
 private:
   Application& m_app;
   /* File menu */
   QAction* m_new_tu_action = nullptr;
+  QAction* m_open_compiledb_action = nullptr;
   QAction* m_close_action = nullptr;
   /* View menu */
   QAction* m_view_files_action = nullptr;
@@ -104,6 +119,7 @@ private:
   QAction* m_settings_action = nullptr;
   /* Central widget */
   QTabWidget* m_documents_tab_widget = nullptr;
+  QFileSystemWatcher* m_file_watcher = nullptr;
 };
 
 #endif // CLARK_WINDOW_H
@@ -10,9 +10,13 @@
 
 #include <QFile>
 #include <QMenu>
+#include <QScrollBar>
+#include <QTextBlock>
 
 #include <QDebug>
 
+#include <algorithm>
+
 CodeViewer::CodeViewer(const QString& documentPath, const QString& documentContent, QWidget* parent) : QPlainTextEdit(parent)
 {
   document()->setDefaultFont(courierFont());
@@ -24,6 +28,9 @@ CodeViewer::CodeViewer(const QString& documentPath, const QString& documentConte
   document()->setMetaInformation(QTextDocument::MetaInformation::DocumentUrl, QString(documentPath).replace('\\', '/'));
 
   m_syntax_highlighter = new CpptokSyntaxHighlighter(document());
+
+  connect(this, &QPlainTextEdit::updateRequest, this, &CodeViewer::updateVisibleBlocks);
+  connect(document(), &QTextDocument::contentsChanged, this, [this]() { m_block_positions.clear(); });
 }
 
 /**
@@ -36,6 +43,74 @@ QString CodeViewer::documentPath() const
   return document()->metaInformation(QTextDocument::MetaInformation::DocumentUrl);
 }
 
+/**
+ * \brief replaces the content of the document
+ * \param content  the new content
+ * 
+ * Only the lines that differ from the current content are replaced, so 
+ * that the syntax highlighter only processes the modified blocks and 
+ * the scroll position is preserved.
+ */
+void CodeViewer::updateDocumentContent(const QString& content)
+{
+  QStringList old_lines = document()->toPlainText().split('\n');
+  QStringList new_lines = content.split('\n');
+
+  int prefix = 0;
+
+  while (prefix < old_lines.size() && prefix < new_lines.size() && old_lines.at(prefix) == new_lines.at(prefix))
+    ++prefix;
+
+  if (prefix == old_lines.size() && prefix == new_lines.size())
+    return;
+
+  int suffix = 0;
+
+  while (suffix < old_lines.size() - prefix && suffix < new_lines.size() - prefix
+    && old_lines.at(old_lines.size() - 1 - suffix) == new_lines.at(new_lines.size() - 1 - suffix))
+    ++suffix;
+
+  int scroll = verticalScrollBar()->value();
+
+  QTextCursor cursor{ document() };
+  cursor.beginEditBlock();
+
+  // select the modified lines, including the line separator that precedes 
+  // them so that lines can be removed entirely
+  if (prefix > 0)
+  {
+    cursor.setPosition(document()->findBlockByNumber(prefix - 1).position());
+    cursor.movePosition(QTextCursor::EndOfBlock);
+  }
+
+  int last_changed = old_lines.size() - suffix - 1;
+  QStringList replacement = new_lines.mid(prefix, new_lines.size() - suffix - prefix);
+
+  if (last_changed >= prefix)
+  {
+    QTextBlock last = document()->findBlockByNumber(last_changed);
+    int end = last.position() + last.length() - 1;
+
+    // removing the first lines also removes the separator that follows them
+    if (prefix == 0 && replacement.isEmpty())
+      end += 1;
+
+    cursor.setPosition(end, QTextCursor::KeepAnchor);
+  }
+
+  QString text = replacement.join('\n');
+
+  if (prefix > 0 && !replacement.isEmpty())
+    text.prepend('\n');
+  else if (prefix == 0 && !replacement.isEmpty() && last_changed < prefix)
+    text.append('\n');
+
+  cursor.insertText(text);
+  cursor.endEditBlock();
+
+  verticalScrollBar()->setValue(scroll);
+}
+
 CppSyntaxHighlighter* CodeViewer::syntaxHighlighter() const
 {
   return m_syntax_highlighter;
@@ -51,7 +126,69 @@ void CodeViewer::setSyntaxHighlighter(CppSyntaxHighlighter* highlighter)
   m_syntax_highlighter = highlighter;
 
   if (m_syntax_highlighter)
+  {
+    if (document()->blockCount() > lazyHighlightingThreshold())
+      m_syntax_highlighter->setLazyHighlighting(true);
+
+    updateVisibleBlocks();
     m_syntax_highlighter->rehighlight();
+  }
+}
+
+/**
+ * \brief returns the number of lines above which lazy highlighting is used
+ * 
+ * See CppSyntaxHighlighter::setLazyHighlighting().
+ */
+int CodeViewer::lazyHighlightingThreshold()
+{
+  return 5000;
+}
+
+/**
+ * \brief returns the numbers of the first and last visible blocks
+ */
+std::pair<int, int> CodeViewer::visibleBlockRange() const
+{
+  int first = firstVisibleBlock().blockNumber();
+  int last = cursorForPosition(QPoint(0, viewport()->height() - 1)).blockNumber();
+  return { first, std::max(first, last) };
+}
+
+/**
+ * \brief returns the position of each block, indexed by block number
+ * 
+ * The table is computed on demand and discarded when the content of 
+ * the document changes.
+ */
+const std::vector<int>& CodeViewer::blockPositions()
+{
+  if (m_block_positions.empty())
+  {
+    m_block_positions.reserve(document()->blockCount());
+
+    for (QTextBlock b = document()->begin(); b.isValid(); b = b.next())
+      m_block_positions.push_back(b.position());
+  }
+
+  return m_block_positions;
+}
+
+/**
+ * \brief updates what depends on the range of visible blocks
+ * 
+ * The range is reported to the syntax highlighter, and the highlighted 
+ * references are recomputed if the viewport has scrolled.
+ */
+void CodeViewer::updateVisibleBlocks()
+{
+  std::pair<int, int> range = visibleBlockRange();
+
+  if (m_syntax_highlighter && m_syntax_highlighter->lazyHighlighting())
+    m_syntax_highlighter->setVisibleBlocks(range.first, range.second);
+
+  if (m_token_under_cursor.references && range != m_selections_range)
+    refreshExtraSelections();
 }
 
 QFont CodeViewer::courierFont()
@@ -75,6 +212,7 @@ void CodeViewer::setSymbolInfoProvider(SymbolInfoProvider* provider)
 
   if (m_info_provider)
   {
+    disconnect(m_info_provider, nullptr, this, nullptr);
     m_info_provider->deleteLater();
     m_info_provider = nullptr;
   }
@@ -84,6 +222,8 @@ void CodeViewer::setSymbolInfoProvider(SymbolInfoProvider* provider)
   if (m_info_provider)
   {
     m_info_provider->setParent(this);
+    connect(m_info_provider, &SymbolInfoProvider::symbolAvailable, this, &CodeViewer::onSymbolAvailable);
+    connect(m_info_provider, &SymbolInfoProvider::invalidated, this, &CodeViewer::onSymbolInfoInvalidated);
   
     fetchIncludes();
   }
@@ -94,9 +234,15 @@ static bool contains(int startCol, int span, int col)
   return col >= startCol && col < startCol + span;
 }
 
+/**
+ * \brief returns the symbol under the mouse cursor
+ * 
+ * This returns nullptr while the symbol of the hovered token is being 
+ * looked up.
+ */
 SymbolObject* CodeViewer::symbolUnderCursor() const
 {
-  return m_token_under_cursor.symbol;
+  return m_token_under_cursor.symbol_pending ? nullptr : m_token_under_cursor.symbol;
 }
 
 void CodeViewer::goToLine(int l)
@@ -143,16 +289,26 @@ void CodeViewer::updateTokenUnderCursor(const QTextCursor& cursor)
     return;
 
   QTextBlock block = cursor.block();
-  QString text = block.text();
-  int line = cursor.block().blockNumber() + 1;
+  int line = block.blockNumber() + 1;
   int col = cursor.positionInBlock() + 1;
 
   // Check if it's the same token as before
   if (line == m_token_under_cursor.line && contains(m_token_under_cursor.col, m_token_under_cursor.span, col))
     return;
 
-  QStringLineTokenizer tokenizer;
-  tokenizer.tokenize(cursor.block().text());
+  // the tokens of the hovered line are kept until the mouse moves to another line
+  if (m_hovered_block.number != block.blockNumber() || m_hovered_block.revision != block.revision())
+  {
+    m_hovered_block.number = block.blockNumber();
+    m_hovered_block.revision = block.revision();
+
+    // tokenize() keeps the lexer state, which must not leak from the previously 
+    // hovered line (e.g., an unterminated comment)
+    m_hovered_block.tokenizer.lexer.state = cpptok::Tokenizer().state;
+    m_hovered_block.tokenizer.tokenize(block.text());
+  }
+
+  const QStringLineTokenizer& tokenizer = m_hovered_block.tokenizer;
 
   auto tokit = tokenizer.tokenAt(col);
 
@@ -180,13 +336,14 @@ void CodeViewer::updateTokenUnderCursor(const QTextCursor& cursor)
     tokinfo.document = document();
     tokinfo.token = *tokit;
 
-    SymbolObject* sym = symbolInfoProvider()->getSymbol(tokinfo);
-    setTokenUnderCursor(line, col, span, sym);
+    requestSymbolUnderCursor(tokinfo, span);
   }
 }
 
 void CodeViewer::setTokenUnderCursor(int line, int col, int span, SymbolObject* sym)
 {
+  cancelSymbolRequest();
+
   m_token_under_cursor.line = line;
   m_token_under_cursor.col = col;
   m_token_under_cursor.span = span;
@@ -197,6 +354,8 @@ void CodeViewer::setTokenUnderCursor(int line, int col, int span, SymbolObject*
 
 void CodeViewer::setTokenUnderCursor(int line, int col, int span, QString includedFile)
 {
+  cancelSymbolRequest();
+
   m_token_under_cursor.line = line;
   m_token_under_cursor.col = col;
   m_token_under_cursor.span = span;
@@ -210,6 +369,51 @@ void CodeViewer::clearTokenUnderCursor()
   setTokenUnderCursor(-1, -1, 0, nullptr);
 }
 
+/**
+ * \brief asks the symbol info provider for the symbol of the hovered token
+ * 
+ * The previous symbol is kept (but not reported by symbolUnderCursor()) 
+ * until the provider answers, so that moving between two references to 
+ * the same symbol does not clear the highlighted references.
+ */
+void CodeViewer::requestSymbolUnderCursor(const TokenInfo& tokinfo, int span)
+{
+  m_token_under_cursor.line = tokinfo.line;
+  m_token_under_cursor.col = tokinfo.column;
+  m_token_under_cursor.span = span;
+  m_token_under_cursor.symbol_pending = true;
+
+  setIncludedFileUnderCursor(QString());
+
+  symbolInfoProvider()->requestSymbol(tokinfo);
+}
+
+void CodeViewer::cancelSymbolRequest()
+{
+  if (m_token_under_cursor.symbol_pending)
+  {
+    m_token_under_cursor.symbol_pending = false;
+
+    if (symbolInfoProvider())
+      symbolInfoProvider()->cancelSymbolRequest();
+  }
+}
+
+void CodeViewer::onSymbolAvailable(int line, int col, SymbolObject* sym)
+{
+  if (!m_token_under_cursor.symbol_pending || line != m_token_under_cursor.line || col != m_token_under_cursor.col)
+  {
+    // the mouse has moved to another token since the request
+    if (sym)
+      sym->deleteLater();
+
+    return;
+  }
+
+  m_token_under_cursor.symbol_pending = false;
+  setSymbolUnderCursor(sym);
+}
+
 void CodeViewer::setSymbolUnderCursor(SymbolObject* sym)
 {
   if (m_token_under_cursor.symbol != sym)
@@ -315,20 +519,50 @@ void CodeViewer::fetchIncludes()
   }
 }
 
+/**
+ * \brief drops the symbol under the cursor and the includes obtained from the symbol info provider
+ * 
+ * The includes are fetched again.
+ */
+void CodeViewer::onSymbolInfoInvalidated()
+{
+  clearTokenUnderCursor();
+  clearIncludes();
+  fetchIncludes();
+}
+
+/**
+ * \brief highlights the references to the symbol under the mouse cursor
+ * 
+ * Only the references in the visible blocks are highlighted; this is 
+ * recomputed when the viewport scrolls (see updateVisibleBlocks()).
+ */
 void CodeViewer::refreshExtraSelections()
 {
   QList<QTextEdit::ExtraSelection> extraSelections;
 
+  m_selections_range = visibleBlockRange();
+
   if (m_token_under_cursor.references && !m_token_under_cursor.references->referencesInFile().empty())
   {
+    const std::vector<int>& positions = blockPositions();
+    const int first = m_selections_range.first;
+    const int last = m_selections_range.second;
+    const int length = m_token_under_cursor.symbol->name().length();
+
     for (const SymbolReferencesInDocument::Position& pos : m_token_under_cursor.references->referencesInFile())
     {
+      int blocknum = pos.line - 1;
+
+      if (blocknum < first || blocknum > last || blocknum >= int(positions.size()))
+        continue;
+
       QTextEdit::ExtraSelection selection;
       selection.format.setBackground(QColor("lightcyan"));
-      selection.cursor = QTextCursor(document()->findBlockByNumber(pos.line - 1));
-      int blockpos = selection.cursor.block().position();
+      selection.cursor = QTextCursor(document());
+      int blockpos = positions[blocknum];
       selection.cursor.setPosition(blockpos + pos.col - 1, QTextCursor::MoveAnchor);
-      selection.cursor.setPosition(blockpos + pos.col - 1 + symbolUnderCursor()->name().length(), QTextCursor::KeepAnchor);
+      selection.cursor.setPosition(blockpos + pos.col - 1 + length, QTextCursor::KeepAnchor);
       extraSelections.append(selection);
     }
   }
@@ -5,8 +5,13 @@
 #ifndef CLARK_CODEVIEWER_H
 #define CLARK_CODEVIEWER_H
 
+#include "tokenizer.h"
+
 #include <QPlainTextEdit>
 
+#include <utility>
+#include <vector>
+
 class CppSyntaxHighlighter;
 
 class IncludesInFile;
@@ -14,6 +19,8 @@ class SymbolObject;
 class SymbolReferencesInDocument;
 class SymbolInfoProvider;
 
+struct TokenInfo;
+
 class CodeViewer : public QPlainTextEdit
 {
   Q_OBJECT
@@ -22,10 +29,13 @@ public:
   ~CodeViewer() = default;
 
   QString documentPath() const;
+  void updateDocumentContent(const QString& content);
 
   CppSyntaxHighlighter* syntaxHighlighter() const;
   void setSyntaxHighlighter(CppSyntaxHighlighter* highlighter);
 
+  static int lazyHighlightingThreshold();
+
   static QFont courierFont();
 
   SymbolInfoProvider* symbolInfoProvider() const;
@@ -54,6 +64,9 @@ protected:
   void setTokenUnderCursor(int line, int col, int span, SymbolObject* sym);
   void setTokenUnderCursor(int line, int col, int span, QString includedFile);
   void clearTokenUnderCursor();
+  void requestSymbolUnderCursor(const TokenInfo& tokinfo, int span);
+  void cancelSymbolRequest();
+  void onSymbolAvailable(int line, int col, SymbolObject* sym);
   void setSymbolUnderCursor(SymbolObject* sym);
   void onSymbolUnderCursorChanged();
   void onSymbolUnderCursorInfoAvailable();
@@ -61,7 +74,11 @@ protected:
   void onIncludeUnderCursorChanged();
   void clearIncludes();
   void fetchIncludes();
+  void onSymbolInfoInvalidated();
   void refreshExtraSelections();
+  void updateVisibleBlocks();
+  std::pair<int, int> visibleBlockRange() const;
+  const std::vector<int>& blockPositions();
 
 private:
   struct TokenUnderCursor
@@ -70,14 +87,26 @@ private:
     int col = -1;
     int span = 0;
     SymbolObject* symbol = nullptr;
+    bool symbol_pending = false;
     SymbolReferencesInDocument* references = nullptr;
     QString included_file;
   };
 
+private:
+  struct HoveredBlock
+  {
+    int number = -1;
+    int revision = -1;
+    QStringLineTokenizer tokenizer;
+  };
+
 private:
   CppSyntaxHighlighter* m_syntax_highlighter = nullptr;
   SymbolInfoProvider* m_info_provider = nullptr;
   TokenUnderCursor m_token_under_cursor;
+  HoveredBlock m_hovered_block;
+  std::vector<int> m_block_positions;
+  std::pair<int, int> m_selections_range{ -1, -1 };
   IncludesInFile* m_includes = nullptr;
 };
 
@@ -29,6 +29,31 @@ SymbolObject* SymbolInfoProvider::getSymbol(const TokenInfo& /* tokinfo */)
   return nullptr;
 }
 
+/**
+ * \brief requests the symbol at a given location
+ * \param tokinfo  the token
+ * 
+ * The symbol is delivered with the symbolAvailable() signal, whose 
+ * receiver takes ownership of the symbol (which may be null).
+ * Only the latest request is guaranteed to be answered: a request 
+ * supersedes the ones that have not been answered yet.
+ * 
+ * The default implementation calls getSymbol() and emits the signal 
+ * immediately.
+ */
+void SymbolInfoProvider::requestSymbol(const TokenInfo& tokinfo)
+{
+  Q_EMIT symbolAvailable(tokinfo.line, tokinfo.column, getSymbol(tokinfo));
+}
+
+/**
+ * \brief cancels the symbol request that has not been answered yet
+ */
+void SymbolInfoProvider::cancelSymbolRequest()
+{
+
+}
+
 SymbolReferencesInDocument* SymbolInfoProvider::getReferencesInDocument(SymbolObject* /* symbol */, const QString& /* filePath */)
 {
   return nullptr;
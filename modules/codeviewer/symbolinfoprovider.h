@@ -35,9 +35,15 @@ public:
   bool hasFeature(Feature f) const;
 
   virtual SymbolObject* getSymbol(const TokenInfo& tokinfo);
+  virtual void requestSymbol(const TokenInfo& tokinfo);
+  virtual void cancelSymbolRequest();
   virtual SymbolReferencesInDocument* getReferencesInDocument(SymbolObject* symbol, const QString& filePath);
 
   virtual ::IncludesInFile* getIncludesInFile(const QString& filePath);
+
+Q_SIGNALS:
+  void symbolAvailable(int line, int col, SymbolObject* symbol);
+  void invalidated(); // the symbols and includes previously returned are no longer valid
 };
 
 #endif // CLARK_SYMBOLINFOPROVIDER_H
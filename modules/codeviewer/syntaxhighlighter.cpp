@@ -4,10 +4,14 @@
 
 #include "syntaxhighlighter.h"
 
+#include <QElapsedTimer>
+#include <QTextBlock>
 #include <QTextDocument>
+#include <QTimer>
 
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
-#include <set>
 
 CppSyntaxHighlighter::CppSyntaxHighlighter(QTextDocument* document) : QSyntaxHighlighter(document)
 {
@@ -51,6 +55,11 @@ CppSyntaxHighlighter::CppSyntaxHighlighter(QTextDocument* document) : QSyntaxHig
 
   fmt.setForeground(QColor("#008000"));
   initFormat(Format::Comment, fmt);
+
+  m_idle_timer = new QTimer(this);
+  m_idle_timer->setSingleShot(true);
+  m_idle_timer->setInterval(0);
+  connect(m_idle_timer, &QTimer::timeout, this, &CppSyntaxHighlighter::formatPendingBlocks);
 }
 
 CppSyntaxHighlighter::~CppSyntaxHighlighter()
@@ -74,6 +83,196 @@ const std::vector<QTextCharFormat>& CppSyntaxHighlighter::formats() const
   return m_formats;
 }
 
+// number of blocks above and below the viewport that are formatted immediately
+static constexpr int LazyHighlightingMargin = 100;
+
+// maximum time spent formatting blocks in one slice, in milliseconds
+static constexpr int LazyHighlightingSlice = 8;
+
+/**
+ * \brief returns whether lazy highlighting is enabled
+ */
+bool CppSyntaxHighlighter::lazyHighlighting() const
+{
+  return m_lazy;
+}
+
+void CppSyntaxHighlighter::setLazyHighlighting(bool on)
+{
+  if (m_lazy != on)
+  {
+    m_lazy = on;
+    m_formatted_blocks.clear();
+
+    if (!m_lazy)
+    {
+      m_idle_timer->stop();
+      rehighlight();
+    }
+  }
+}
+
+/**
+ * \brief sets the range of blocks that are visible
+ * \param first  the block number of the first visible block
+ * \param last   the block number of the last visible block
+ * 
+ * In lazy mode, the blocks in the range that have not been formatted yet 
+ * are formatted immediately.
+ */
+void CppSyntaxHighlighter::setVisibleBlocks(int first, int last)
+{
+  m_first_visible_block = first;
+  m_last_visible_block = last;
+
+  if (!m_lazy || !document())
+    return;
+
+  int begin = std::max(0, first - LazyHighlightingMargin);
+  int end = std::min(document()->blockCount(), last + LazyHighlightingMargin + 1);
+
+  for (int n(begin); n < end; ++n)
+  {
+    if (n >= static_cast<int>(m_formatted_blocks.size()) || !m_formatted_blocks[n])
+      formatBlock(n);
+  }
+}
+
+/**
+ * \brief returns whether the current block should be formatted
+ * 
+ * This always returns true if lazy highlighting is disabled.
+ * Otherwise, blocks outside of the visible range are marked as pending 
+ * and formatted later.
+ */
+bool CppSyntaxHighlighter::shouldFormatCurrentBlock()
+{
+  if (!m_lazy)
+    return true;
+
+  const int count = document()->blockCount();
+
+  if (static_cast<int>(m_formatted_blocks.size()) != count)
+  {
+    m_formatted_blocks.assign(count, false);
+    m_next_pending_block = 0;
+  }
+
+  const int n = currentBlock().blockNumber();
+
+  bool visible = n >= m_first_visible_block - LazyHighlightingMargin 
+    && n <= m_last_visible_block + LazyHighlightingMargin;
+
+  if (m_forced || visible)
+  {
+    m_formatted_blocks[n] = true;
+    return true;
+  }
+
+  m_formatted_blocks[n] = false;
+  m_next_pending_block = std::min(m_next_pending_block, n);
+
+  if (!m_idle_timer->isActive())
+    m_idle_timer->start();
+
+  return false;
+}
+
+/**
+ * \brief highlights some blocks again
+ * \param blocks  the block numbers of the blocks
+ * 
+ * This is a cheaper alternative to rehighlight() when only a few blocks 
+ * need to be updated.
+ * In lazy mode, only the blocks near the visible range are highlighted 
+ * immediately, the others are marked as pending.
+ */
+void CppSyntaxHighlighter::rehighlightBlocks(const std::vector<int>& blocks)
+{
+  if (!document())
+    return;
+
+  if (!m_lazy)
+  {
+    for (int n : blocks)
+      formatBlock(n);
+
+    return;
+  }
+
+  const int count = document()->blockCount();
+
+  if (static_cast<int>(m_formatted_blocks.size()) != count)
+  {
+    m_formatted_blocks.assign(count, false);
+    m_next_pending_block = 0;
+  }
+
+  bool pending = false;
+
+  for (int n : blocks)
+  {
+    if (n < 0 || n >= count)
+      continue;
+
+    bool visible = n >= m_first_visible_block - LazyHighlightingMargin
+      && n <= m_last_visible_block + LazyHighlightingMargin;
+
+    if (visible)
+    {
+      formatBlock(n);
+    }
+    else
+    {
+      m_formatted_blocks[n] = false;
+      m_next_pending_block = std::min(m_next_pending_block, n);
+      pending = true;
+    }
+  }
+
+  if (pending && !m_idle_timer->isActive())
+    m_idle_timer->start();
+}
+
+void CppSyntaxHighlighter::formatBlock(int n)
+{
+  QTextBlock block = document()->findBlockByNumber(n);
+
+  if (!block.isValid())
+    return;
+
+  m_forced = true;
+  rehighlightBlock(block);
+  m_forced = false;
+}
+
+void CppSyntaxHighlighter::formatPendingBlocks()
+{
+  if (!m_lazy || !document())
+    return;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  const int count = std::min(document()->blockCount(), static_cast<int>(m_formatted_blocks.size()));
+
+  while (m_next_pending_block < count)
+  {
+    if (!m_formatted_blocks[m_next_pending_block])
+    {
+      formatBlock(m_next_pending_block);
+
+      if (timer.elapsed() >= LazyHighlightingSlice)
+      {
+        m_idle_timer->start();
+        return;
+      }
+    }
+
+    ++m_next_pending_block;
+  }
+}
+
 
 SyntaxHighlighterNameHighlighter::SyntaxHighlighterNameHighlighter(QObject* parent) : QObject(parent)
 {
@@ -85,27 +284,158 @@ SyntaxHighlighterNameHighlighter::~SyntaxHighlighterNameHighlighter()
 
 }
 
-CppSyntaxHighlighter::Format SyntaxHighlighterNameHighlighter::format(const QTextDocument& document, int line, int col, std::string_view text)
+namespace
+{
+
+struct BuiltinName
+{
+  std::string_view name;
+  CppSyntaxHighlighter::Format format;
+};
+
+constexpr BuiltinName builtin_names[] = {
+  { "std", CppSyntaxHighlighter::Format::NamespaceName },
+  { "Eigen", CppSyntaxHighlighter::Format::NamespaceName },
+  { "Poco", CppSyntaxHighlighter::Format::NamespaceName },
+  { "Qt", CppSyntaxHighlighter::Format::NamespaceName },
+  { "size_t", CppSyntaxHighlighter::Format::Typename },
+  { "ptrdiff_t", CppSyntaxHighlighter::Format::Typename },
+  { "nullptr_t", CppSyntaxHighlighter::Format::Typename },
+  { "max_align_t", CppSyntaxHighlighter::Format::Typename },
+  { "int8_t", CppSyntaxHighlighter::Format::Typename },
+  { "int16_t", CppSyntaxHighlighter::Format::Typename },
+  { "int32_t", CppSyntaxHighlighter::Format::Typename },
+  { "int64_t", CppSyntaxHighlighter::Format::Typename },
+  { "uint8_t", CppSyntaxHighlighter::Format::Typename },
+  { "uint16_t", CppSyntaxHighlighter::Format::Typename },
+  { "uint32_t", CppSyntaxHighlighter::Format::Typename },
+  { "uint64_t", CppSyntaxHighlighter::Format::Typename },
+  { "intptr_t", CppSyntaxHighlighter::Format::Typename },
+  { "uintptr_t", CppSyntaxHighlighter::Format::Typename },
+  { "intmax_t", CppSyntaxHighlighter::Format::Typename },
+  { "uintmax_t", CppSyntaxHighlighter::Format::Typename },
+};
+
+constexpr size_t builtin_names_count = sizeof(builtin_names) / sizeof(builtin_names[0]);
+
+constexpr uint32_t fnv1a(std::string_view str, uint32_t seed)
 {
-  static const std::set<std::string> known_namespaces = {
-    "std", "Eigen", "Poco", "Qt"
-  };
+  uint32_t h = 2166136261u ^ seed;
 
-  static const std::set<std::string> known_types = {
+  for (char c : str)
+  {
+    h ^= static_cast<unsigned char>(c);
+    h *= 16777619u;
+  }
 
-  };
+  return h;
+}
 
+/**
+ * \brief a collision-free hash table of the built-in names
+ * 
+ * The table is built at compile time by searching for a seed of the 
+ * hash function that maps every built-in name to a distinct slot.
+ */
+struct BuiltinNamesTable
+{
+  static constexpr size_t size = 128; // power of two
+  static constexpr uint32_t max_seed = 100000;
+
+  uint32_t seed = 0;
+  int slots[size] = {};
+
+  constexpr int find(std::string_view name) const
   {
-    auto it = known_namespaces.find(std::string(text));
+    int i = slots[fnv1a(name, seed) & (size - 1)];
+    return (i >= 0 && builtin_names[i].name == name) ? i : -1;
+  }
+};
 
-    if (it != known_namespaces.end())
-      return CppSyntaxHighlighter::Format::NamespaceName;
+constexpr BuiltinNamesTable build_builtin_names_table()
+{
+  for (uint32_t seed = 0; seed < BuiltinNamesTable::max_seed; ++seed)
+  {
+    BuiltinNamesTable table;
+    table.seed = seed;
+
+    for (size_t i(0); i < BuiltinNamesTable::size; ++i)
+      table.slots[i] = -1;
+
+    bool ok = true;
+
+    for (size_t i(0); i < builtin_names_count && ok; ++i)
+    {
+      int& slot = table.slots[fnv1a(builtin_names[i].name, seed) & (BuiltinNamesTable::size - 1)];
+
+      if (slot != -1)
+        ok = false;
+      else
+        slot = static_cast<int>(i);
+    }
+
+    if (ok)
+      return table;
+  }
+
+  BuiltinNamesTable failure;
+  failure.seed = BuiltinNamesTable::max_seed;
+  return failure;
+}
+
+constexpr BuiltinNamesTable builtin_names_table = build_builtin_names_table();
+
+static_assert(builtin_names_table.seed < BuiltinNamesTable::max_seed, "could not build a perfect hash of the built-in names");
+static_assert(builtin_names_table.find("std") == 0, "perfect hash of the built-in names is broken");
+
+} // namespace
+
+/**
+ * \brief returns the format of a built-in name
+ * 
+ * Returns CppSyntaxHighlighter::Format::Default if \a name is not a built-in name.
+ */
+CppSyntaxHighlighter::Format SyntaxHighlighterNameHighlighter::builtinFormat(std::string_view name)
+{
+  int i = builtin_names_table.find(name);
+  return i != -1 ? builtin_names[i].format : CppSyntaxHighlighter::Format::Default;
+}
+
+const std::shared_ptr<const KnownNames>& SyntaxHighlighterNameHighlighter::knownNames() const
+{
+  return m_known_names;
+}
+
+/**
+ * \brief sets the names known to be namespaces or types
+ * 
+ * The names can be shared between several highlighters.
+ * This emits update(), which triggers a rehighlight.
+ */
+void SyntaxHighlighterNameHighlighter::setKnownNames(std::shared_ptr<const KnownNames> names)
+{
+  if (m_known_names != names)
+  {
+    m_known_names = std::move(names);
+    Q_EMIT update();
   }
+}
 
+CppSyntaxHighlighter::Format SyntaxHighlighterNameHighlighter::format(const QTextDocument& document, int line, int col, std::string_view text)
+{
   {
-    auto it = known_types.find(std::string(text));
+    CppSyntaxHighlighter::Format f = builtinFormat(text);
+
+    if (f != CppSyntaxHighlighter::Format::Default)
+      return f;
+  }
+
+  if (m_known_names)
+  {
+    if (m_known_names->namespaces.find(text) != m_known_names->namespaces.end())
+      return CppSyntaxHighlighter::Format::NamespaceName;
 
-    if (it != known_types.end())
+    if (m_known_names->types.find(text) != m_known_names->types.end())
       return CppSyntaxHighlighter::Format::Typename;
   }
 
@@ -9,13 +9,27 @@
 
 #include <QSyntaxHighlighter>
 
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
 #include <vector>
 
+class QTimer;
+
 /**
  * \brief base class for C++ syntax highlighter
  * 
  * This class provides a list of formats that subclasses can use to
  * highlight C++ source code in a QTextDocument.
+ * 
+ * In lazy mode, only the visible blocks (plus a margin) are formatted 
+ * immediately; the other blocks are formatted in small time slices when 
+ * the event loop is idle.
+ * Subclasses opt in by calling shouldFormatCurrentBlock() in highlightBlock(); 
+ * they must still set the state of every block, as the state of a block 
+ * is used to highlight the next one.
  */
 class CppSyntaxHighlighter : public QSyntaxHighlighter
 {
@@ -46,15 +60,32 @@ public:
     ST_Comment = 1,
   };
 
+  bool lazyHighlighting() const;
+  void setLazyHighlighting(bool on = true);
+  void setVisibleBlocks(int first, int last);
+
 protected:
   void initFormat(Format fmt, const QTextCharFormat& value);
   void setFormat(int start, int count, Format fmt);
+  bool shouldFormatCurrentBlock();
+  void rehighlightBlocks(const std::vector<int>& blocks);
 
 protected:
   const std::vector<QTextCharFormat>& formats() const;
 
+private:
+  void formatBlock(int n);
+  void formatPendingBlocks();
+
 private:
   std::vector<QTextCharFormat> m_formats;
+  bool m_lazy = false;
+  bool m_forced = false;
+  int m_first_visible_block = 0;
+  int m_last_visible_block = -1;
+  std::vector<bool> m_formatted_blocks;
+  int m_next_pending_block = 0;
+  QTimer* m_idle_timer = nullptr;
 };
 
 class SyntaxHighlighterNameHighlighter;
@@ -84,8 +115,23 @@ private:
   SyntaxHighlighterNameHighlighter* m_name_highlighter = nullptr;
 };
 
+/**
+ * \brief a set of names known to be namespaces or types
+ * 
+ * The sets support lookup with a std::string_view.
+ */
+struct KnownNames
+{
+  std::set<std::string, std::less<>> namespaces;
+  std::set<std::string, std::less<>> types;
+};
+
 /**
  * \brief provides highlighting of identifiers
+ * 
+ * Identifiers are first looked up in a compile-time table of built-in 
+ * names (e.g., "std", "size_t"), then in an optional set of known names 
+ * that can be provided at runtime (e.g., from the index of a project).
  */
 class SyntaxHighlighterNameHighlighter : public QObject
 {
@@ -94,10 +140,18 @@ public:
   explicit SyntaxHighlighterNameHighlighter(QObject* parent = nullptr);
   ~SyntaxHighlighterNameHighlighter();
 
+  static CppSyntaxHighlighter::Format builtinFormat(std::string_view name);
+
+  const std::shared_ptr<const KnownNames>& knownNames() const;
+  void setKnownNames(std::shared_ptr<const KnownNames> names);
+
   virtual CppSyntaxHighlighter::Format format(const QTextDocument& document, int line, int col, std::string_view text);
 
 Q_SIGNALS:
   void update();
+
+private:
+  std::shared_ptr<const KnownNames> m_known_names;
 };
 
 #endif // CLARK_SYNTAXHIGHLIGHTER_H
@@ -9,15 +9,75 @@
 
 #include <QString>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CLARK_TOKENIZER_SSE2
+#include <emmintrin.h>
+#endif // SSE2
+
+namespace detail
+{
+
+#ifdef CLARK_TOKENIZER_SSE2
+// returns whether (a & b) == 0, i.e. SSE4.1's _mm_testz_si128() with SSE2 instructions
+inline bool testz(__m128i a, __m128i b)
+{
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(a, b), _mm_setzero_si128())) == 0xFFFF;
+}
+#endif // CLARK_TOKENIZER_SSE2
+
+/**
+ * \brief converts an ASCII UTF-16 string to a std::string
+ * \param str   the UTF-16 code units
+ * \param n     the number of code units
+ * \param out   the output string, resized to \a n on success
+ * 
+ * Returns false (and leaves \a out in an unspecified state) if the string 
+ * contains non-ASCII characters.
+ */
+inline bool ascii_to_std_string(const ushort* str, int n, std::string& out)
+{
+  out.resize(n);
+  char* dest = &out[0];
+  int i = 0;
+
+#ifdef CLARK_TOKENIZER_SSE2
+  const __m128i non_ascii_mask = _mm_set1_epi16(static_cast<short>(0xFF80));
+
+  for (; i + 8 <= n; i += 8)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+
+    if (!testz(v, non_ascii_mask))
+      return false;
+
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dest + i), _mm_packus_epi16(v, v));
+  }
+#endif // CLARK_TOKENIZER_SSE2
+
+  for (; i < n; ++i)
+  {
+    if (str[i] >= 0x80)
+      return false;
+
+    dest[i] = static_cast<char>(str[i]);
+  }
+
+  return true;
+}
+
+} // namespace detail
+
 class QStringLineTokenizer
 {
 public:
   QString qstring;
-  std::string text;
-  std::vector<int> offsets;
+  std::string text; // UTF-8
+  bool ascii = true; // if true, 'offsets' is empty as UTF-8 and UTF-16 offsets are the same
+  std::vector<int> offsets; // UTF-8 offset -> UTF-16 offset
   cpptok::Tokenizer lexer;
 
   void tokenize(const QString& qstr)
@@ -25,55 +85,13 @@ public:
     qstring = qstr;
 
     lexer.output.clear();
+    offsets.clear();
 
-    {
-      offsets.clear();
-      text.clear();
-
-      text = qstr.toStdString();
+    // 'text' and 'offsets' keep their capacity from one line to the next
+    ascii = detail::ascii_to_std_string(qstr.utf16(), qstr.size(), text);
 
-      int offset = 0;
-
-      for (int i(0); i < qstr.size(); ++i)
-      {
-        QChar c = qstr.at(i);
-
-        int codepoint = c.unicode();
-
-        if (c.isSurrogate())
-        {
-          ++i;
-          codepoint = c.isLowSurrogate() ? QChar::surrogateToUcs4(qstr.at(i), c) : QChar::surrogateToUcs4(c, qstr.at(i));
-        }
-
-        if (codepoint <= 0x007F)
-        {
-          offsets.push_back(offset);
-        }
-        else if (codepoint <= 0x07FF)
-        {
-          offsets.push_back(offset);
-          offsets.push_back(offset);
-        }
-        else if (codepoint <= 0xFFFF)
-        {
-          offsets.push_back(offset);
-          offsets.push_back(offset);
-          offsets.push_back(offset);
-        }
-        else
-        {
-          offsets.push_back(offset);
-          offsets.push_back(offset);
-          offsets.push_back(offset);
-          offsets.push_back(offset);
-        }
-
-        offset += c.isSurrogate() ? 2 : 1;
-      }
-
-      offsets.push_back(offset);
-    }
+    if (!ascii)
+      encodeUtf8(qstr);
 
     lexer.tokenize(text);
   }
@@ -81,29 +99,97 @@ public:
   int offset(const cpptok::Token& tok) const
   {
     size_t off = tok.text().data() - text.data();
-    return offsets.at(off);
+    return ascii ? static_cast<int>(off) : offsets.at(off);
   }
 
   int length(const cpptok::Token& tok) const
   {
+    if (ascii)
+      return static_cast<int>(tok.text().length());
 
     size_t off = tok.text().data() - text.data();
     off += tok.text().length();
     return offsets.at(off) - offset(tok);
   }
 
+private:
+  void encodeUtf8(const QString& qstr)
+  {
+    text.clear();
+
+    int offset = 0;
+
+    for (int i(0); i < qstr.size(); ++i)
+    {
+      QChar c = qstr.at(i);
+
+      uint codepoint = c.unicode();
+
+      if (c.isSurrogate() && i + 1 < qstr.size())
+      {
+        ++i;
+        codepoint = c.isLowSurrogate() ? QChar::surrogateToUcs4(qstr.at(i), c) : QChar::surrogateToUcs4(c, qstr.at(i));
+      }
+
+      if (codepoint <= 0x007F)
+      {
+        text.push_back(static_cast<char>(codepoint));
+        offsets.push_back(offset);
+      }
+      else if (codepoint <= 0x07FF)
+      {
+        text.push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
+        text.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+        offsets.insert(offsets.end(), 2, offset);
+      }
+      else if (codepoint <= 0xFFFF)
+      {
+        text.push_back(static_cast<char>(0xE0 | (codepoint >> 12)));
+        text.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+        text.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+        offsets.insert(offsets.end(), 3, offset);
+      }
+      else
+      {
+        text.push_back(static_cast<char>(0xF0 | (codepoint >> 18)));
+        text.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+        text.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+        text.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+        offsets.insert(offsets.end(), 4, offset);
+      }
+
+      offset += codepoint > 0xFFFF ? 2 : 1;
+    }
+
+    offsets.push_back(offset);
+  }
+
+public:
   int col(const cpptok::Token& tok) const
   {
     return std::distance(text.data(), tok.text().data()) + 1;
   }
 
+  /**
+   * \brief returns the token at a given column
+   * 
+   * Tokens are ordered by position in the line, so the token is found 
+   * with a binary search.
+   */
   std::vector<cpptok::Token>::const_iterator tokenAt(int col) const
   {
-    for (auto it = lexer.output.begin(); it != lexer.output.end(); ++it)
-    {
-      if (this->col(*it) <= col && this->col(*it) + it->text().length() > col)
-        return it;
-    }
+    // first token starting after 'col'
+    auto it = std::upper_bound(lexer.output.begin(), lexer.output.end(), col, [this](int c, const cpptok::Token& tok) {
+      return c < this->col(tok);
+      });
+
+    if (it == lexer.output.begin())
+      return lexer.output.end();
+
+    --it;
+
+    if (this->col(*it) + static_cast<int>(it->text().length()) > col)
+      return it;
 
     return lexer.output.end();
   }
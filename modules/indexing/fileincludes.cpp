@@ -0,0 +1,48 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "fileincludes.h"
+
+#include <algorithm>
+
+namespace clark
+{
+
+/**
+ * \brief groups the include directives of an indexing result by file
+ * \param idx  the indexing result
+ * 
+ * The indexing result must outlive this object.
+ */
+FileIncludes::FileIncludes(const IndexingResult& idx)
+{
+  for (const Include& inc : idx.ppincludes)
+  {
+    if (inc.file && inc.included_file)
+      m_includes[inc.file->path].push_back(Entry{ inc.line, inc.included_file });
+  }
+
+  for (auto& p : m_includes)
+  {
+    std::sort(p.second.begin(), p.second.end(), [](const Entry& lhs, const Entry& rhs) {
+      return lhs.line < rhs.line;
+      });
+  }
+}
+
+/**
+ * \brief returns the include directives of a file
+ * \param path  the "generic" path of the file (i.e., with forward slashes)
+ * 
+ * Returns nullptr if the indexing result has no include directive in the file. 
+ * This does not mean that the file has no include directives: the includes 
+ * of a precompiled header, for example, are not part of the indexing result.
+ */
+const std::vector<FileIncludes::Entry>* FileIncludes::find(const std::string& path) const
+{
+  auto it = m_includes.find(path);
+  return it != m_includes.end() ? &(it->second) : nullptr;
+}
+
+} // namespace clark
@@ -0,0 +1,43 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_FILEINCLUDES_H
+#define CLARK_FILEINCLUDES_H
+
+#include "indexingresult.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace clark
+{
+
+/**
+ * \brief the include directives of an indexing result grouped by file
+ * 
+ * In each file, the include directives are sorted by line.
+ * Only files with at least one include directive are listed.
+ */
+class FileIncludes
+{
+public:
+  FileIncludes() = default;
+  explicit FileIncludes(const IndexingResult& idx);
+
+  struct Entry
+  {
+    int line;
+    const File* included_file;
+  };
+
+  const std::vector<Entry>* find(const std::string& path) const;
+
+private:
+  std::map<std::string, std::vector<Entry>> m_includes;
+};
+
+} // namespace clark
+
+#endif // CLARK_FILEINCLUDES_H
@@ -0,0 +1,78 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "filereferences.h"
+
+#include <algorithm>
+#include <functional>
+#include <tuple>
+
+namespace clark
+{
+
+static bool reference_less(const EntityReference* lhs, const EntityReference* rhs)
+{
+  if (lhs->symbol != rhs->symbol)
+    return std::less<const Entity*>()(lhs->symbol, rhs->symbol);
+
+  return std::tie(lhs->line, lhs->col) < std::tie(rhs->line, rhs->col);
+}
+
+/**
+ * \brief groups the references of an indexing result by file
+ * \param idx  the indexing result
+ * 
+ * The indexing result must outlive this object.
+ */
+FileReferences::FileReferences(const IndexingResult& idx)
+{
+  for (const auto& p : idx.files)
+    m_files[p.second->path] = p.second.get();
+
+  for (const EntityReference& ref : idx.references)
+  {
+    if (ref.file && ref.symbol)
+      m_references[ref.file].push_back(&ref);
+  }
+
+  for (auto& p : m_references)
+    std::sort(p.second.begin(), p.second.end(), reference_less);
+}
+
+/**
+ * \brief finds a file given its path
+ * \param path  the "generic" path of the file (i.e., with forward slashes)
+ */
+const File* FileReferences::findFile(const std::string& path) const
+{
+  auto it = m_files.find(path);
+  return it != m_files.end() ? it->second : nullptr;
+}
+
+/**
+ * \brief returns the references to an entity in a file
+ * 
+ * The references are sorted by position.
+ */
+FileReferences::Range FileReferences::references(const File& file, const Entity& e) const
+{
+  auto it = m_references.find(&file);
+
+  if (it == m_references.end())
+    return Range{ const_iterator(), const_iterator() };
+
+  const std::vector<const EntityReference*>& refs = it->second;
+
+  auto first = std::lower_bound(refs.begin(), refs.end(), &e, [](const EntityReference* ref, const Entity* ent) {
+    return std::less<const Entity*>()(ref->symbol, ent);
+    });
+
+  auto last = std::upper_bound(first, refs.end(), &e, [](const Entity* ent, const EntityReference* ref) {
+    return std::less<const Entity*>()(ent, ref->symbol);
+    });
+
+  return Range{ first, last };
+}
+
+} // namespace clark
@@ -0,0 +1,54 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_FILEREFERENCES_H
+#define CLARK_FILEREFERENCES_H
+
+#include "indexingresult.h"
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace clark
+{
+
+/**
+ * \brief the references of an indexing result grouped by file
+ * 
+ * In each file, the references are sorted by entity and then by position, 
+ * so that the references to an entity in a file form a contiguous range.
+ */
+class FileReferences
+{
+public:
+  FileReferences() = default;
+  explicit FileReferences(const IndexingResult& idx);
+
+  typedef std::vector<const EntityReference*>::const_iterator const_iterator;
+
+  struct Range
+  {
+    const_iterator first;
+    const_iterator last;
+
+    const_iterator begin() const { return first; }
+    const_iterator end() const { return last; }
+    bool empty() const { return first == last; }
+    size_t size() const { return static_cast<size_t>(last - first); }
+  };
+
+  const File* findFile(const std::string& path) const;
+
+  Range references(const File& file, const Entity& e) const;
+
+private:
+  std::map<std::string, const File*> m_files;
+  std::unordered_map<const File*, std::vector<const EntityReference*>> m_references;
+};
+
+} // namespace clark
+
+#endif // CLARK_FILEREFERENCES_H
@@ -0,0 +1,152 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "includegraphprefetchpolicy.h"
+
+#include "program/clangindex.h"
+#include "program/translationunit.h"
+
+#include <algorithm>
+#include <filesystem>
+
+IncludeGraphPrefetchPolicy::IncludeGraphPrefetchPolicy()
+{
+
+}
+
+IncludeGraphPrefetchPolicy::~IncludeGraphPrefetchPolicy()
+{
+
+}
+
+/**
+ * \brief records the files included by a translation unit
+ * \param tu      the translation unit
+ * \param result  the result of indexing the translation unit
+ * 
+ * This function is thread-safe.
+ */
+void IncludeGraphPrefetchPolicy::addIncludes(const TranslationUnit& tu, const clark::IndexingResult& result)
+{
+  std::set<std::string> files;
+
+  for (const clark::Include& inc : result.ppincludes)
+  {
+    if (inc.included_file)
+      files.insert(inc.included_file->path);
+  }
+
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  auto [entry, inserted] = m_includes.try_emplace(&tu);
+  std::set<std::string>& includes = entry->second;
+
+  if (inserted)
+  {
+    // the slot runs in the thread destroying the translation unit, before 
+    // a new translation unit can be created at the same address
+    const TranslationUnit* key = &tu;
+
+    QObject::connect(&tu, &TranslationUnit::aboutToBeDestroyed, &m_context, [this, key]() {
+      removeIncludes(key);
+      }, Qt::DirectConnection);
+  }
+
+  for (const std::string& f : includes)
+    m_include_count[f] -= 1;
+
+  includes = std::move(files);
+
+  for (const std::string& f : includes)
+    m_include_count[f] += 1;
+}
+
+void IncludeGraphPrefetchPolicy::removeIncludes(const TranslationUnit* tu)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  auto it = m_includes.find(tu);
+
+  if (it == m_includes.end())
+    return;
+
+  for (const std::string& f : it->second)
+    m_include_count[f] -= 1;
+
+  m_includes.erase(it);
+}
+
+static std::string file_stem(const std::string& path)
+{
+  return std::filesystem::u8path(path).stem().u8string();
+}
+
+std::vector<TranslationUnit*> IncludeGraphPrefetchPolicy::neighbours(const ClangIndex& index, const TranslationUnit& tu, size_t max)
+{
+  std::vector<std::pair<double, TranslationUnit*>> candidates;
+
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+
+    auto it = m_includes.find(&tu);
+
+    if (it != m_includes.end())
+    {
+      const std::set<std::string>& includes = it->second;
+
+      std::set<std::string> stems;
+
+      for (const std::string& f : includes)
+        stems.insert(file_stem(f));
+
+      for (TranslationUnit* other : index.translationUnits())
+      {
+        if (other == &tu)
+          continue;
+
+        double score = 0;
+
+        if (stems.count(file_stem(other->filePath().toStdString())))
+          score += 1;
+
+        auto other_it = m_includes.find(other);
+
+        if (other_it != m_includes.end())
+        {
+          for (const std::string& f : other_it->second)
+          {
+            if (includes.count(f))
+              score += 1.0 / std::max(m_include_count[f], 1);
+          }
+        }
+
+        if (score > 0)
+          candidates.emplace_back(score, other);
+      }
+    }
+  }
+
+  std::stable_sort(candidates.begin(), candidates.end(), [](const std::pair<double, TranslationUnit*>& a, const std::pair<double, TranslationUnit*>& b) {
+    return a.first > b.first;
+    });
+
+  std::vector<TranslationUnit*> result;
+
+  for (size_t i(0); i < candidates.size() && result.size() < max; ++i)
+    result.push_back(candidates.at(i).second);
+
+  if (result.size() < max)
+  {
+    for (TranslationUnit* other : PrefetchPolicy::neighbours(index, tu, max))
+    {
+      if (result.size() == max)
+        break;
+
+      if (std::find(result.begin(), result.end(), other) == result.end())
+        result.push_back(other);
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,53 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_INCLUDEGRAPHPREFETCHPOLICY_H
+#define CLARK_INCLUDEGRAPHPREFETCHPOLICY_H
+
+#include "indexingresult.h"
+
+#include "program/prefetchpolicy.h"
+
+#include <QObject>
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+/**
+ * \brief a prefetch policy based on the include graph of indexed translation units
+ * 
+ * Translation units that include the same files as the opened translation unit 
+ * are considered neighbours; files that are included by many translation units 
+ * (e.g., standard headers) carry less weight than rarely included ones.
+ * Translation units whose main file matches a header included by the opened 
+ * translation unit (e.g., "foo.cpp" for "foo.h") come first.
+ * 
+ * Translation units are forgotten when they are destroyed.
+ * 
+ * When the include graph is not sufficient, the project structure is used 
+ * as in PrefetchPolicy.
+ */
+class IncludeGraphPrefetchPolicy : public PrefetchPolicy
+{
+public:
+  IncludeGraphPrefetchPolicy();
+  ~IncludeGraphPrefetchPolicy();
+
+  void addIncludes(const TranslationUnit& tu, const clark::IndexingResult& result);
+
+  std::vector<TranslationUnit*> neighbours(const ClangIndex& index, const TranslationUnit& tu, size_t max) override;
+
+private:
+  void removeIncludes(const TranslationUnit* tu);
+
+private:
+  std::mutex m_mutex;
+  std::map<const TranslationUnit*, std::set<std::string>> m_includes;
+  std::map<std::string, int> m_include_count;
+  QObject m_context; // destroyed first, disconnects from the translation units
+};
+
+#endif // CLARK_INCLUDEGRAPHPREFETCHPOLICY_H
@@ -4,17 +4,24 @@
 
 #include "indexer.h"
 
+#include "indexingloader.h"
+#include "workerpool.h"
+
 #include "program/clangindex.h"
 
+#include "utils/executor.h"
+#include "utils/telemetry.h"
+
 #include <libclang-utils/index-action.h>
 #include <libclang-utils/clang-cursor.h>
 
 #include <QRunnable>
-#include <QThreadPool>
 
 #include <cassert>
 #include <filesystem>
 #include <iostream>
+#include <optional>
+#include <shared_mutex>
 
 namespace clark
 {
@@ -399,6 +406,45 @@ IndexingResult index_translation_unit(libclang::Index& index, libclang::Translat
   return std::move(tui.result);
 }
 
+/**
+ * \brief parses and indexes a translation unit in a single pass
+ * \param index        the libclang index
+ * \param file         the path of the main source file
+ * \param includedirs  the include directories
+ * \param pch          the path of a precompiled header to include, or an empty string
+ * \param options      parsing options (see CXTranslationUnit_Flags)
+ * \param tunit        receives the parsed translation unit
+ * 
+ * Contrary to index_translation_unit(), the AST is only traversed once.
+ */
+IndexingResult parse_and_index_translation_unit(libclang::Index& index, const std::string& file, const std::set<std::string>& includedirs, 
+  const std::string& pch, int options, std::unique_ptr<libclang::TranslationUnit>& tunit)
+{
+  libclang::IndexAction action{ index };
+
+  std::vector<std::string> args;
+  args.reserve(includedirs.size() + 2);
+
+  for (const std::string& dir : includedirs)
+    args.push_back("-I" + dir);
+
+  if (!pch.empty())
+  {
+    args.push_back("-include-pch");
+    args.push_back(pch);
+  }
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  TranslationUnitIndexer tui{ index.api };
+  tunit = std::make_unique<libclang::TranslationUnit>(action.indexSourceFile(tui, file, args, options));
+
+  auto end = std::chrono::high_resolution_clock::now();
+  tui.result.indexing_time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+
+  return std::move(tui.result);
+}
+
 /**
  * \brief retrieves the content of a file from the translation unit
  * \param tunit  the translation unit
@@ -426,17 +472,39 @@ public:
 
   void run() override
   {
-    libclang::Index& clangindex = indexing->translationUnit().clangIndex()->libclangIndex();
-    libclang::TranslationUnit& tunit = *indexing->translationUnit().clangTranslationUnit();
-    clark::IndexingResult ir = clark::index_translation_unit(clangindex, tunit);
-    indexing->setIndexingResult(std::move(ir));
+    TranslationUnit& tu = indexing->translationUnit();
+
+    // the clang translation unit cannot be replaced or suspended while it is indexed
+    std::shared_lock<std::shared_mutex> access{ tu.accessMutex() };
+
+    if (tu.state() != TranslationUnit::Loaded)
+    {
+      QMetaObject::invokeMethod(indexing, "onIndexingSkipped", Qt::QueuedConnection);
+      return;
+    }
+
+    const int generation = tu.generation();
+
+    libclang::Index& clangindex = tu.clangIndex()->libclangIndex();
+    libclang::TranslationUnit& tunit = *tu.clangTranslationUnit();
+    clark::telemetry::ScopedSpan span{ clark::telemetry::Category::Index, tu.filePath().toStdString() };
+    auto ir = std::make_shared<clark::IndexingResult>(clark::index_translation_unit(clangindex, tunit));
+
+    access.unlock();
+
+    // the result is set in the thread of the indexing, where it is used
+    TranslationUnitIndexing* target = indexing;
+    QMetaObject::invokeMethod(target, [target, ir, generation]() {
+      target->setIndexingResult(std::move(*ir), generation);
+      }, Qt::QueuedConnection);
   }
 };
 
 TranslationUnitIndexing::TranslationUnitIndexing(TranslationUnit& tunit, QObject* parent) : QObject(parent),
   m_translation_unit(tunit)
 {
-
+  connect(&tunit, &TranslationUnit::reparsed, this, &TranslationUnitIndexing::onTranslationUnitReparsed);
+  connect(&tunit, &TranslationUnit::loaded, this, &TranslationUnitIndexing::onTranslationUnitLoaded);
 }
 
 
@@ -460,15 +528,92 @@ TranslationUnit& TranslationUnitIndexing::translationUnit() const
   return m_translation_unit;
 }
 
+IndexingWorkerPool* TranslationUnitIndexing::workerPool() const
+{
+  return m_worker_pool;
+}
+
+/**
+ * \brief sets the pool of worker processes used by start()
+ * 
+ * If no pool is set, the translation unit is indexed in-process.
+ */
+void TranslationUnitIndexing::setWorkerPool(IndexingWorkerPool* pool)
+{
+  m_worker_pool = pool;
+}
+
+/**
+ * \brief starts indexing the translation unit
+ * 
+ * The translation unit does not need to be loaded if a worker pool is set.
+ * If the translation unit was indexed while it was parsed, that result is 
+ * used instead, even if a worker is already indexing it: the result of 
+ * the worker is then discarded as out-of-date.
+ */
 void TranslationUnitIndexing::start()
 {
-  if (isStarted() || isReady())
+  if (isReady())
     return;
 
-  QThreadPool::globalInstance()->start(new IndexTranslationUnit(this));
+  ClangIndex* index = translationUnit().clangIndex();
+  auto* factory = index ? dynamic_cast<IndexingLoaderFactory*>(&index->loaderFactory()) : nullptr;
 
-  m_state = Started;
-  emit started();
+  if (factory)
+  {
+    // the translation unit may have been indexed while it was parsed
+    std::optional<clark::IndexingResult> result = factory->takeIndexingResult(translationUnit());
+
+    if (result.has_value())
+    {
+      if (!isStarted())
+      {
+        m_state = Started;
+        emit started();
+      }
+
+      setIndexingResult(std::move(*result), translationUnit().generation());
+      return;
+    }
+  }
+
+  if (isStarted())
+    return;
+
+  m_started_generation = translationUnit().generation();
+
+  if (m_worker_pool)
+  {
+    m_state = Started;
+    emit started();
+    m_worker_pool->submit(this);
+  }
+  else
+  {
+    startInProcess();
+  }
+}
+
+/**
+ * \brief indexes the translation unit in a thread of this process
+ * 
+ * This is used by start() when no worker pool is set, and by the worker 
+ * pool when a translation unit cannot be indexed by a worker process.
+ */
+void TranslationUnitIndexing::startInProcess()
+{
+  if (isReady())
+    return;
+
+  m_started_generation = translationUnit().generation();
+
+  Executor::get(Executor::Index).start(new IndexTranslationUnit(this));
+
+  if (!isStarted())
+  {
+    m_state = Started;
+    emit started();
+  }
 }
 
 const clark::IndexingResult& TranslationUnitIndexing::indexingResult() const
@@ -478,12 +623,152 @@ const clark::IndexingResult& TranslationUnitIndexing::indexingResult() const
   if (!isReady())
     return static_result;
   else
-    return m_result;
+    return *m_result;
 }
 
+/**
+ * \brief returns the indexing result, or nullptr if the indexing is not ready
+ * 
+ * The result is replaced when the translation unit is indexed again after 
+ * a reparse; tasks and objects that keep pointers into the result must 
+ * hold it through this pointer, and refresh them on ready().
+ */
+std::shared_ptr<const clark::IndexingResult> TranslationUnitIndexing::sharedIndexingResult() const
+{
+  return isReady() ? m_result : nullptr;
+}
+
+/**
+ * \brief sets the result of the indexing started with start() or startInProcess()
+ */
 void TranslationUnitIndexing::setIndexingResult(clark::IndexingResult r)
 {
-  m_result = std::move(r);
+  setIndexingResult(std::move(r), m_started_generation);
+}
+
+/**
+ * \brief sets the indexing result
+ * \param r           the result
+ * \param generation  the generation of the translation unit that was indexed
+ * 
+ * If the translation unit was reparsed since it was indexed, it is indexed again.
+ * A result that is older than the current one is discarded.
+ * This function must be called from the thread of the object.
+ */
+void TranslationUnitIndexing::setIndexingResult(clark::IndexingResult r, int generation)
+{
+  if (isReady() && generation < m_generation)
+    return;
+
+  m_file_references.reset();
+  m_result = std::make_shared<const clark::IndexingResult>(std::move(r));
+  m_file_includes = clark::FileIncludes(*m_result);
+  m_generation = generation;
   m_state = Ready;
+  m_reindexing = false;
   Q_EMIT ready();
+
+  if (m_generation != translationUnit().generation() && translationUnit().state() == TranslationUnit::Loaded)
+    reindex();
+}
+
+/**
+ * \brief returns the generation of the translation unit when it was indexed
+ * 
+ * The indexing result is up-to-date if this is equal to TranslationUnit::generation(), 
+ * otherwise the translation unit is being indexed again.
+ * Returns -1 if the indexing is not ready.
+ */
+int TranslationUnitIndexing::translationUnitGeneration() const
+{
+  return isReady() ? m_generation : -1;
+}
+
+/**
+ * \brief indexes the translation unit again after it was reparsed
+ * 
+ * The previous result stays available until the new one is ready.
+ * The translation unit is indexed in-process as worker processes 
+ * do not see the unsaved files of the ClangIndex.
+ */
+void TranslationUnitIndexing::reindex()
+{
+  ClangIndex* index = translationUnit().clangIndex();
+  auto* factory = index ? dynamic_cast<IndexingLoaderFactory*>(&index->loaderFactory()) : nullptr;
+
+  if (factory)
+  {
+    // the translation unit may have been indexed while it was reparsed
+    std::optional<clark::IndexingResult> result = factory->takeIndexingResult(translationUnit());
+
+    if (result.has_value())
+    {
+      setIndexingResult(std::move(*result), translationUnit().generation());
+      return;
+    }
+  }
+
+  m_reindexing = true;
+  Executor::get(Executor::Index).start(new IndexTranslationUnit(this));
+  emit started();
+}
+
+void TranslationUnitIndexing::onTranslationUnitReparsed()
+{
+  // a running indexing checks the generation when it completes
+  if (isReady() && !m_reindexing)
+    reindex();
+}
+
+/**
+ * \brief indexes the translation unit again if it was loaded after it was indexed
+ * 
+ * This happens when a worker process indexed the translation unit before 
+ * it was opened.
+ */
+void TranslationUnitIndexing::onTranslationUnitLoaded()
+{
+  if (isReady() && !m_reindexing && m_generation != translationUnit().generation() 
+    && translationUnit().state() == TranslationUnit::Loaded)
+    reindex();
+}
+
+void TranslationUnitIndexing::onIndexingSkipped()
+{
+  m_reindexing = false;
+
+  // the translation unit was unloaded before it could be indexed, or a 
+  // worker process hung on it; the indexing can be started again once 
+  // it is loaded
+  if (isStarted())
+    m_state = Init;
+}
+
+/**
+ * \brief returns the references of the indexing result grouped by file
+ * 
+ * The table is built on first use; this function must be called from 
+ * the thread of the object.
+ */
+const clark::FileReferences& TranslationUnitIndexing::fileReferences() const
+{
+  static const clark::FileReferences static_references = {};
+
+  if (!isReady())
+    return static_references;
+
+  if (!m_file_references)
+    m_file_references = std::make_unique<clark::FileReferences>(*m_result);
+
+  return *m_file_references;
+}
+
+/**
+ * \brief returns the include directives of the indexing result grouped by file
+ * 
+ * Unlike fileReferences(), the table is built when the indexing result is set.
+ */
+const clark::FileIncludes& TranslationUnitIndexing::fileIncludes() const
+{
+  return m_file_includes;
 }
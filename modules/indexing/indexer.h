@@ -5,6 +5,8 @@
 #ifndef CLARK_INDEXER_H
 #define CLARK_INDEXER_H
 
+#include "fileincludes.h"
+#include "filereferences.h"
 #include "indexingresult.h"
 
 #include "program/translationunit.h"
@@ -12,16 +14,26 @@
 #include <libclang-utils/clang-index.h>
 
 #include <QObject>
+#include <QPointer>
+
+#include <memory>
+#include <set>
+#include <string>
 
 namespace clark
 {
 
 IndexingResult index_translation_unit(libclang::Index& index, libclang::TranslationUnit& tunit);
 
+IndexingResult parse_and_index_translation_unit(libclang::Index& index, const std::string& file, const std::set<std::string>& includedirs, 
+  const std::string& pch, int options, std::unique_ptr<libclang::TranslationUnit>& tunit);
+
 const char* get_file_contents(const libclang::TranslationUnit& tunit, const File& file);
 
 } // namespace clark
 
+class IndexingWorkerPool;
+
 class TranslationUnitIndexing : public QObject
 {
   Q_OBJECT
@@ -41,19 +53,43 @@ public:
   
   TranslationUnit& translationUnit() const;
 
+  IndexingWorkerPool* workerPool() const;
+  void setWorkerPool(IndexingWorkerPool* pool);
+
   void start();
+  void startInProcess();
 
   const clark::IndexingResult& indexingResult() const;
+  std::shared_ptr<const clark::IndexingResult> sharedIndexingResult() const;
   void setIndexingResult(clark::IndexingResult r);
+  void setIndexingResult(clark::IndexingResult r, int generation);
+  int translationUnitGeneration() const;
+
+  const clark::FileReferences& fileReferences() const;
+  const clark::FileIncludes& fileIncludes() const;
 
 Q_SIGNALS:
   void started();
   void ready();
 
+protected:
+  void reindex();
+
+protected Q_SLOTS:
+  void onTranslationUnitReparsed();
+  void onTranslationUnitLoaded();
+  void onIndexingSkipped();
+
 private:
   TranslationUnit& m_translation_unit;
   State m_state = Init;
-  clark::IndexingResult m_result;
+  QPointer<IndexingWorkerPool> m_worker_pool;
+  std::shared_ptr<const clark::IndexingResult> m_result;
+  int m_generation = -1;
+  int m_started_generation = -1;
+  bool m_reindexing = false;
+  mutable std::unique_ptr<clark::FileReferences> m_file_references;
+  clark::FileIncludes m_file_includes;
 };
 
 #endif // CLARK_INDEXER_H
@@ -0,0 +1,314 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "indexingloader.h"
+
+#include "includegraphprefetchpolicy.h"
+#include "indexer.h"
+
+#include "program/precompiledheaders.h"
+
+#include "utils/telemetry.h"
+
+#include <libclang-utils/clang-translation-unit.h>
+
+#include <QRunnable>
+
+#include <QDebug>
+
+/**
+ * \brief returns the precompiled header to use for a translation unit, or an empty string
+ * 
+ * See ClangIndex::precompiledHeaders().
+ */
+static std::string precompiled_header(ClangIndex& index, const TranslationUnit& tu)
+{
+  PrecompiledHeaders* pchs = index.precompiledHeaders();
+  return pchs ? pchs->get(index.libclangIndex(), tu) : std::string();
+}
+
+/**
+ * \brief parses and indexes a translation unit that was never parsed
+ * 
+ * If the parse fails, the translation unit is parsed again by the loader 
+ * of the base factory, without indexing.
+ */
+class ParseAndIndexTranslationUnit : public QRunnable
+{
+private:
+  IndexingLoaderFactory& m_factory;
+  ClangIndex& m_index;
+  TranslationUnit& m_translation_unit;
+  bool m_skeleton;
+
+public:
+
+  explicit ParseAndIndexTranslationUnit(IndexingLoaderFactory& factory, ClangIndex& index, TranslationUnit& tu, bool skeleton = false) :
+    m_factory(factory),
+    m_index(index),
+    m_translation_unit(tu),
+    m_skeleton(skeleton)
+  {
+    setAutoDelete(true);
+  }
+
+  void run() override
+  {
+    m_translation_unit.setState(TranslationUnit::State::Parsing);
+
+    std::unique_ptr<libclang::TranslationUnit> clangtu;
+    clark::IndexingResult result;
+
+    int options = CXTranslationUnit_DetailedPreprocessingRecord;
+
+    // the indexing result of a skeleton is an outline: it has the declarations 
+    // and the includes, but not the references inside function bodies
+    if (m_skeleton)
+      options |= CXTranslationUnit_SkipFunctionBodies | CXTranslationUnit_Incomplete | CXTranslationUnit_KeepGoing;
+    else if (m_index.precompiledPreamble())
+      options |= CXTranslationUnit_PrecompiledPreamble;
+
+    try
+    {
+      clark::telemetry::ScopedSpan span{ clark::telemetry::Category::Parse, m_translation_unit.filePath().toStdString() };
+
+      result = clark::parse_and_index_translation_unit(m_index.libclangIndex(), m_translation_unit.filePath().toStdString(),
+        m_translation_unit.compileOptions().includedirs, precompiled_header(m_index, m_translation_unit), options, clangtu);
+    }
+    catch (const std::exception& ex)
+    {
+      qDebug() << "Could not parse and index" << m_translation_unit.filePath() << ":" << ex.what();
+      clangtu.reset();
+    }
+
+    if (!clangtu)
+    {
+      fallback();
+      return;
+    }
+
+    m_index.recordParseMemoryUsage(*clangtu, m_skeleton);
+
+    // the result must be available before the 'loaded' signal is emitted; 
+    // it describes the clang translation unit set below
+    m_factory.setIndexingResult(m_translation_unit, std::move(result), m_translation_unit.generation() + 1);
+
+    m_translation_unit.setFlag(TranslationUnit::Skeleton, m_skeleton);
+    m_translation_unit.setClangTranslationUnit(std::move(clangtu));
+  }
+
+private:
+  void fallback()
+  {
+    // the loaders of the base factory expect a translation unit that was never parsed
+    m_translation_unit.setState(TranslationUnit::State::AwaitingParsing);
+
+    std::unique_ptr<QRunnable> loader{ m_skeleton ? m_factory.TranslationUnitLoaderFactory::createSkeletonLoader(m_index, m_translation_unit)
+      : m_factory.TranslationUnitLoaderFactory::createLoader(m_index, m_translation_unit) };
+
+    try
+    {
+      loader->run();
+    }
+    catch (const std::exception& ex)
+    {
+      // the next request for the translation unit parses it again
+      qDebug() << "Could not parse" << m_translation_unit.filePath() << ":" << ex.what();
+      m_translation_unit.setState(TranslationUnit::State::AwaitingParsing);
+    }
+  }
+};
+
+/**
+ * \brief parses and indexes a translation unit that is already loaded
+ * 
+ * The result replaces the current clang translation unit like a reparse 
+ * (see TranslationUnit::setFullClangTranslationUnit()), the indexing result 
+ * is kept for the TranslationUnitIndexing of the translation unit.
+ */
+class FullParseAndIndexTranslationUnit : public QRunnable
+{
+private:
+  IndexingLoaderFactory& m_factory;
+  ClangIndex& m_index;
+  TranslationUnit& m_translation_unit;
+
+public:
+
+  explicit FullParseAndIndexTranslationUnit(IndexingLoaderFactory& factory, ClangIndex& index, TranslationUnit& tu) :
+    m_factory(factory),
+    m_index(index),
+    m_translation_unit(tu)
+  {
+    setAutoDelete(true);
+  }
+
+  void run() override
+  {
+    const int generation = m_translation_unit.generation();
+
+    std::unique_ptr<libclang::TranslationUnit> clangtu;
+    clark::IndexingResult result;
+
+    int options = CXTranslationUnit_DetailedPreprocessingRecord;
+
+    if (m_index.precompiledPreamble())
+      options |= CXTranslationUnit_PrecompiledPreamble;
+
+    try
+    {
+      clark::telemetry::ScopedSpan span{ clark::telemetry::Category::Parse, m_translation_unit.filePath().toStdString() };
+
+      result = clark::parse_and_index_translation_unit(m_index.libclangIndex(), m_translation_unit.filePath().toStdString(),
+        m_translation_unit.compileOptions().includedirs, precompiled_header(m_index, m_translation_unit), options, clangtu);
+    }
+    catch (const std::exception& ex)
+    {
+      qDebug() << "Could not parse" << m_translation_unit.filePath() << ":" << ex.what();
+      clangtu.reset();
+    }
+
+    if (clangtu)
+    {
+      // installing the clang translation unit increments the generation; 
+      // loading an unloaded translation unit increments it again, so the 
+      // result is only useful if the translation unit is loaded
+      if (m_translation_unit.state() == TranslationUnit::Loaded)
+        m_factory.setIndexingResult(m_translation_unit, std::move(result), generation + 1);
+
+      if (m_translation_unit.setFullClangTranslationUnit(std::move(clangtu), generation))
+        return;
+    }
+
+    m_translation_unit.setFlag(TranslationUnit::Reparsing, false);
+    m_translation_unit.setFlag(TranslationUnit::FullParseScheduled, false);
+  }
+};
+
+IndexingLoaderFactory::IndexingLoaderFactory()
+{
+
+}
+
+IndexingLoaderFactory::~IndexingLoaderFactory()
+{
+
+}
+
+/**
+ * \brief creates a loader that parses and indexes a translation unit that was never parsed
+ * 
+ * As in createFullParser(), the base implementation is used when the 
+ * ClangIndex has unsaved files.
+ */
+QRunnable* IndexingLoaderFactory::createLoader(ClangIndex& index, TranslationUnit& t)
+{
+  if (t.state() == TranslationUnit::State::AwaitingParsing && index.unsavedFiles().empty())
+    return new ParseAndIndexTranslationUnit(*this, index, t);
+  else
+    return TranslationUnitLoaderFactory::createLoader(index, t);
+}
+
+/**
+ * \brief creates a loader that parses a translation unit without its function bodies and indexes it
+ * 
+ * The outline index is available to TranslationUnitIndexing::start() until the full parse 
+ * of the translation unit replaces it.
+ */
+QRunnable* IndexingLoaderFactory::createSkeletonLoader(ClangIndex& index, TranslationUnit& t)
+{
+  if (t.state() == TranslationUnit::State::AwaitingParsing && index.unsavedFiles().empty())
+    return new ParseAndIndexTranslationUnit(*this, index, t, true);
+  else
+    return TranslationUnitLoaderFactory::createSkeletonLoader(index, t);
+}
+
+/**
+ * \brief creates a loader that fully parses and indexes a skeleton or a loaded translation unit
+ * 
+ * The base implementation is used when the ClangIndex has unsaved files, 
+ * as they cannot be passed to the indexer.
+ */
+QRunnable* IndexingLoaderFactory::createFullParser(ClangIndex& index, TranslationUnit& t)
+{
+  if (index.unsavedFiles().empty())
+    return new FullParseAndIndexTranslationUnit(*this, index, t);
+  else
+    return TranslationUnitLoaderFactory::createFullParser(index, t);
+}
+
+/**
+ * \brief stores the indexing result produced while parsing a translation unit
+ * \param t           the translation unit
+ * \param result      the indexing result
+ * \param generation  the generation of the clang translation unit that was indexed
+ */
+void IndexingLoaderFactory::setIndexingResult(TranslationUnit& t, clark::IndexingResult result, int generation)
+{
+  if (t.clangIndex())
+  {
+    if (auto* policy = dynamic_cast<IncludeGraphPrefetchPolicy*>(t.clangIndex()->prefetchPolicy()))
+      policy->addIncludes(t, result);
+  }
+
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  PendingResult& entry = m_results[&t];
+  entry.generation = generation;
+  entry.result = std::move(result);
+
+  if (t.clangIndex() && m_watched_translation_units.insert(&t).second)
+  {
+    TranslationUnit* tu = &t;
+
+    // the connections are removed with the index, before its translation units are destroyed
+    QObject::connect(tu, &TranslationUnit::aboutToBeDestroyed, t.clangIndex(), [this, tu]() {
+      std::lock_guard<std::mutex> lock{ m_mutex };
+      m_results.erase(tu);
+      m_watched_translation_units.erase(tu);
+      }, Qt::DirectConnection);
+
+    QObject::connect(tu, &TranslationUnit::stateChanged, t.clangIndex(), [this, tu]() {
+      TranslationUnit::State s = tu->state();
+
+      // the result would be out-of-date once the translation unit is loaded again
+      if (s == TranslationUnit::Suspended || s == TranslationUnit::Hibernated)
+        discardIndexingResult(*tu);
+      }, Qt::DirectConnection);
+  }
+}
+
+/**
+ * \brief removes the indexing result produced while parsing a translation unit, if any
+ */
+void IndexingLoaderFactory::discardIndexingResult(TranslationUnit& t)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  m_results.erase(&t);
+}
+
+/**
+ * \brief removes and returns the indexing result produced while parsing a translation unit
+ * \param t  the translation unit
+ * 
+ * Returns an empty optional if the translation unit was not indexed by this factory, 
+ * or if the clang translation unit was replaced or reparsed since it was indexed 
+ * (e.g. the full parse of a skeleton replaced the outline).
+ */
+std::optional<clark::IndexingResult> IndexingLoaderFactory::takeIndexingResult(TranslationUnit& t)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  auto it = m_results.find(&t);
+
+  if (it == m_results.end())
+    return std::nullopt;
+
+  std::optional<clark::IndexingResult> result;
+
+  if (it->second.generation == t.generation())
+    result = std::move(it->second.result);
+
+  m_results.erase(it);
+  return result;
+}
@@ -0,0 +1,55 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_INDEXINGLOADER_H
+#define CLARK_INDEXINGLOADER_H
+
+#include "indexingresult.h"
+
+#include "program/clangindex.h"
+
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+
+/**
+ * \brief a loader factory that indexes translation units while parsing them
+ * 
+ * Translation units that were never parsed are parsed and indexed in a single 
+ * pass over the AST; skeletons are indexed as well, which produces an outline 
+ * of the translation unit, and so are their full parses.
+ * Results that were not taken are discarded when the translation unit is 
+ * unloaded or destroyed.
+ * The indexing result is kept by the factory until TranslationUnitIndexing::start() 
+ * takes it, in which case no second traversal of the AST is required.
+ */
+class IndexingLoaderFactory : public TranslationUnitLoaderFactory
+{
+public:
+  IndexingLoaderFactory();
+  ~IndexingLoaderFactory();
+
+  QRunnable* createLoader(ClangIndex& index, TranslationUnit& t) override;
+  QRunnable* createSkeletonLoader(ClangIndex& index, TranslationUnit& t) override;
+  QRunnable* createFullParser(ClangIndex& index, TranslationUnit& t) override;
+
+  void setIndexingResult(TranslationUnit& t, clark::IndexingResult result, int generation);
+  std::optional<clark::IndexingResult> takeIndexingResult(TranslationUnit& t);
+  void discardIndexingResult(TranslationUnit& t);
+
+private:
+  struct PendingResult
+  {
+    int generation = 0;
+    clark::IndexingResult result;
+  };
+
+private:
+  std::mutex m_mutex;
+  std::map<TranslationUnit*, PendingResult> m_results;
+  std::set<TranslationUnit*> m_watched_translation_units;
+};
+
+#endif // CLARK_INDEXINGLOADER_H
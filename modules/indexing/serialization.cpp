@@ -0,0 +1,225 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "serialization.h"
+
+#include <QDataStream>
+
+#include <unordered_map>
+
+namespace clark
+{
+
+static const quint32 gSerializationMagic = 0x434C4B31; // "CLK1"
+
+static void write_string(QDataStream& stream, const std::string& str)
+{
+  stream << QByteArray::fromRawData(str.data(), static_cast<int>(str.size()));
+}
+
+static std::string read_string(QDataStream& stream)
+{
+  QByteArray bytes;
+  stream >> bytes;
+  return bytes.toStdString();
+}
+
+template<typename T>
+static qint32 index_of(const std::unordered_map<const T*, qint32>& indices, const T* ptr)
+{
+  auto it = indices.find(ptr);
+  return it != indices.end() ? it->second : -1;
+}
+
+template<typename T>
+static T* at(const std::vector<T*>& list, qint32 index)
+{
+  return index >= 0 && index < (qint32)list.size() ? list.at(index) : nullptr;
+}
+
+/**
+ * \brief writes an indexing result into a byte array
+ * \param result  the indexing result
+ * 
+ * Pointers between the elements of the result are written as indices, 
+ * so that deserialize() can rebuild the result in another process.
+ */
+QByteArray serialize(const IndexingResult& result)
+{
+  QByteArray data;
+  QDataStream stream{ &data, QIODevice::WriteOnly };
+
+  stream << gSerializationMagic;
+  stream << qint64(result.indexing_time.count());
+
+  std::unordered_map<const File*, qint32> files;
+  stream << quint32(result.files.size());
+
+  for (const auto& p : result.files)
+  {
+    files[p.second.get()] = qint32(files.size());
+    write_string(stream, p.second->path);
+  }
+
+  std::unordered_map<const Entity*, qint32> entities;
+
+  for (const auto& p : result.symbols)
+    entities[p.second.get()] = qint32(entities.size());
+
+  stream << quint32(result.symbols.size());
+
+  for (const auto& p : result.symbols)
+  {
+    const Entity& e = *p.second;
+    stream << qint32(e.kind) << qint32(e.flags) << index_of(entities, static_cast<const Entity*>(e.parent));
+    write_string(stream, e.name);
+    write_string(stream, e.usr);
+    write_string(stream, e.display_name);
+  }
+
+  stream << quint32(result.ppincludes.size());
+
+  for (const Include& inc : result.ppincludes)
+  {
+    stream << index_of(files, static_cast<const File*>(inc.file)) 
+      << index_of(files, static_cast<const File*>(inc.included_file)) 
+      << qint32(inc.line);
+  }
+
+  stream << quint32(result.references.size());
+
+  for (const EntityReference& ref : result.references)
+  {
+    stream << index_of(entities, static_cast<const Entity*>(ref.symbol)) 
+      << index_of(files, static_cast<const File*>(ref.file))
+      << qint32(ref.line) << qint32(ref.col)
+      << index_of(entities, static_cast<const Entity*>(ref.parent_symbol)) 
+      << qint32(ref.flags);
+  }
+
+  stream << quint32(result.bases.size());
+
+  for (const BaseClass& base : result.bases)
+  {
+    stream << qint32(base.access_specifier)
+      << index_of(entities, static_cast<const Entity*>(base.base))
+      << index_of(entities, static_cast<const Entity*>(base.derived));
+  }
+
+  return data;
+}
+
+/**
+ * \brief reads an indexing result written by serialize()
+ * \param data    the serialized indexing result
+ * \param result  receives the indexing result
+ * 
+ * Returns false if the data is not a valid serialized indexing result.
+ */
+bool deserialize(const QByteArray& data, IndexingResult& result)
+{
+  QDataStream stream{ data };
+
+  quint32 magic = 0;
+  stream >> magic;
+
+  if (magic != gSerializationMagic)
+    return false;
+
+  qint64 time = 0;
+  stream >> time;
+  result.indexing_time = std::chrono::milliseconds(time);
+
+  quint32 count = 0;
+
+  std::vector<File*> files;
+  stream >> count;
+  files.reserve(count);
+
+  for (quint32 i(0); i < count && stream.status() == QDataStream::Ok; ++i)
+  {
+    auto f = std::make_unique<File>();
+    f->path = read_string(stream);
+    files.push_back(f.get());
+    result.files[std::filesystem::u8path(f->path)] = std::move(f);
+  }
+
+  std::vector<Entity*> entities;
+  std::vector<qint32> parents;
+  stream >> count;
+  entities.reserve(count);
+  parents.reserve(count);
+
+  for (quint32 i(0); i < count && stream.status() == QDataStream::Ok; ++i)
+  {
+    qint32 kind, flags, parent;
+    stream >> kind >> flags >> parent;
+
+    auto e = std::make_unique<Entity>();
+    e->kind = static_cast<Whatsit>(kind);
+    e->flags = flags;
+    e->name = read_string(stream);
+    e->usr = read_string(stream);
+    e->display_name = read_string(stream);
+
+    entities.push_back(e.get());
+    parents.push_back(parent);
+    result.symbols[e->usr] = std::move(e);
+  }
+
+  for (size_t i(0); i < entities.size(); ++i)
+    entities[i]->parent = at(entities, parents.at(i));
+
+  stream >> count;
+  result.ppincludes.reserve(count);
+
+  for (quint32 i(0); i < count && stream.status() == QDataStream::Ok; ++i)
+  {
+    qint32 file, included_file, line;
+    stream >> file >> included_file >> line;
+
+    Include inc;
+    inc.file = at(files, file);
+    inc.included_file = at(files, included_file);
+    inc.line = line;
+    result.ppincludes.push_back(inc);
+  }
+
+  stream >> count;
+  result.references.reserve(count);
+
+  for (quint32 i(0); i < count && stream.status() == QDataStream::Ok; ++i)
+  {
+    qint32 symbol, file, line, col, parent, flags;
+    stream >> symbol >> file >> line >> col >> parent >> flags;
+
+    EntityReference ref;
+    ref.symbol = at(entities, symbol);
+    ref.file = at(files, file);
+    ref.line = line;
+    ref.col = col;
+    ref.parent_symbol = at(entities, parent);
+    ref.flags = flags;
+    result.references.push_back(ref);
+  }
+
+  stream >> count;
+  result.bases.reserve(count);
+
+  for (quint32 i(0); i < count && stream.status() == QDataStream::Ok; ++i)
+  {
+    qint32 access, base, derived;
+    stream >> access >> base >> derived;
+
+    BaseClass b;
+    b.access_specifier = static_cast<AccessSpecifier>(access);
+    b.base = at(entities, base);
+    b.derived = at(entities, derived);
+    result.bases.push_back(b);
+  }
+
+  return stream.status() == QDataStream::Ok;
+}
+
+} // namespace clark
@@ -0,0 +1,20 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_INDEXING_SERIALIZATION_H
+#define CLARK_INDEXING_SERIALIZATION_H
+
+#include "indexingresult.h"
+
+#include <QByteArray>
+
+namespace clark
+{
+
+QByteArray serialize(const IndexingResult& result);
+bool deserialize(const QByteArray& data, IndexingResult& result);
+
+} // namespace clark
+
+#endif // CLARK_INDEXING_SERIALIZATION_H
@@ -0,0 +1,84 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "worker.h"
+
+#include <QDataStream>
+#include <QtEndian>
+
+namespace clark
+{
+
+namespace worker
+{
+
+/**
+ * \brief prefixes a message with its length
+ */
+QByteArray frame(const QByteArray& message)
+{
+  QByteArray result;
+  result.resize(4);
+  qToBigEndian<quint32>(quint32(message.size()), result.data());
+  result.append(message);
+  return result;
+}
+
+/**
+ * \brief extracts the first complete message from a buffer
+ * \param buffer   the received bytes
+ * \param message  receives the message
+ * 
+ * Returns false if the buffer does not contain a complete message yet.
+ */
+bool unframe(QByteArray& buffer, QByteArray& message)
+{
+  if (buffer.size() < 4)
+    return false;
+
+  quint32 size = qFromBigEndian<quint32>(buffer.constData());
+
+  if (quint32(buffer.size() - 4) < size)
+    return false;
+
+  message = buffer.mid(4, int(size));
+  buffer.remove(0, int(size) + 4);
+  return true;
+}
+
+QByteArray write(const Request& request)
+{
+  QByteArray result;
+  QDataStream stream{ &result, QIODevice::WriteOnly };
+  stream << request.file << request.includedirs;
+  return result;
+}
+
+bool read(const QByteArray& message, Request& request)
+{
+  QDataStream stream{ message };
+  stream >> request.file >> request.includedirs;
+  return stream.status() == QDataStream::Ok;
+}
+
+QByteArray write(const Response& response)
+{
+  QByteArray result;
+  QDataStream stream{ &result, QIODevice::WriteOnly };
+  stream << quint8(response.status) << response.data;
+  return result;
+}
+
+bool read(const QByteArray& message, Response& response)
+{
+  QDataStream stream{ message };
+  quint8 status = Failure;
+  stream >> status >> response.data;
+  response.status = static_cast<Status>(status);
+  return stream.status() == QDataStream::Ok;
+}
+
+} // namespace worker
+
+} // namespace clark
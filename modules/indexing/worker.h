@@ -0,0 +1,55 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_INDEXING_WORKER_H
+#define CLARK_INDEXING_WORKER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+namespace clark
+{
+
+/**
+ * \brief messages exchanged between clark and the clark-worker processes
+ * 
+ * Messages are framed by a 32-bit big-endian length and sent over the 
+ * standard input and output of the worker.
+ */
+namespace worker
+{
+
+struct Request
+{
+  QString file;
+  QStringList includedirs;
+};
+
+enum Status
+{
+  Success = 0,
+  Failure = 1,
+};
+
+struct Response
+{
+  Status status = Failure;
+  QByteArray data; // the serialized IndexingResult, or an error message
+};
+
+QByteArray frame(const QByteArray& message);
+bool unframe(QByteArray& buffer, QByteArray& message);
+
+QByteArray write(const Request& request);
+bool read(const QByteArray& message, Request& request);
+
+QByteArray write(const Response& response);
+bool read(const QByteArray& message, Response& response);
+
+} // namespace worker
+
+} // namespace clark
+
+#endif // CLARK_INDEXING_WORKER_H
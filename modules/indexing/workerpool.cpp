@@ -0,0 +1,305 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "workerpool.h"
+
+#include "indexer.h"
+#include "serialization.h"
+#include "worker.h"
+
+#include "utils/telemetry.h"
+
+#include <QProcess>
+#include <QTimer>
+
+#include <QDebug>
+
+#include <algorithm>
+
+static constexpr int gMaxJobAttempts = 2;
+static constexpr int gMaxWorkerRestarts = 5;
+static constexpr int gDefaultJobTimeout = 5 * 60 * 1000;
+
+/**
+ * \brief constructs a pool of worker processes
+ * \param program       path of the clark-worker executable
+ * \param libclangPath  path of libclang, passed to the workers
+ * \param workerCount   number of worker processes
+ * \param parent        optional parent object
+ */
+IndexingWorkerPool::IndexingWorkerPool(const QString& program, const QString& libclangPath, int workerCount, QObject* parent) : QObject(parent),
+  m_program(program),
+  m_libclang_path(libclangPath),
+  m_job_timeout(gDefaultJobTimeout)
+{
+  for (int i(0); i < workerCount; ++i)
+  {
+    m_workers.push_back(std::make_unique<Worker>());
+    startWorker(*m_workers.back());
+  }
+}
+
+IndexingWorkerPool::~IndexingWorkerPool()
+{
+  for (std::unique_ptr<Worker>& w : m_workers)
+  {
+    if (!w->process)
+      continue;
+
+    disconnect(w->process, nullptr, this, nullptr);
+
+    // closing the standard input makes the worker exit its loop
+    w->process->closeWriteChannel();
+
+    if (!w->process->waitForFinished(1000))
+      w->process->kill();
+  }
+}
+
+int IndexingWorkerPool::workerCount() const
+{
+  return (int)std::count_if(m_workers.begin(), m_workers.end(), [this](const std::unique_ptr<Worker>& w) {
+    return isRunning(*w);
+    });
+}
+
+int IndexingWorkerPool::pendingJobCount() const
+{
+  return (int)m_jobs.size();
+}
+
+/**
+ * \brief returns the time after which a worker processing a translation unit is considered hung, in milliseconds
+ * 
+ * The default is 5 minutes; 0 means no timeout.
+ */
+int IndexingWorkerPool::jobTimeout() const
+{
+  return m_job_timeout;
+}
+
+/**
+ * \brief sets the time after which a worker processing a translation unit is considered hung
+ * \param msecs  the timeout in milliseconds, or 0 to disable the timeout
+ * 
+ * Jobs that were already sent to a worker keep their timeout.
+ */
+void IndexingWorkerPool::setJobTimeout(int msecs)
+{
+  m_job_timeout = std::max(msecs, 0);
+}
+
+/**
+ * \brief queues a translation unit for indexing
+ * 
+ * The indexing result is passed to TranslationUnitIndexing::setIndexingResult() 
+ * once a worker has processed the translation unit.
+ */
+void IndexingWorkerPool::submit(TranslationUnitIndexing* indexing)
+{
+  Job job;
+  job.indexing = indexing;
+  m_jobs.push_back(job);
+
+  dispatch();
+}
+
+void IndexingWorkerPool::startWorker(Worker& w)
+{
+  if (w.process)
+    w.process->deleteLater();
+
+  if (!w.timer)
+  {
+    w.timer = new QTimer(this);
+    w.timer->setSingleShot(true);
+
+    connect(w.timer, &QTimer::timeout, this, [this, &w]() {
+      onJobTimeout(w);
+      });
+  }
+
+  w.timer->stop();
+
+  w.process = new QProcess(this);
+  w.process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+  w.buffer.clear();
+
+  connect(w.process, &QProcess::readyReadStandardOutput, this, [this, &w]() {
+    onReadyRead(w);
+    });
+
+  connect(w.process, qOverload<int, QProcess::ExitStatus>(&QProcess::finished), this, [this, &w]() {
+    onWorkerStopped(w);
+    });
+
+  connect(w.process, &QProcess::errorOccurred, this, [this, &w](QProcess::ProcessError e) {
+    if (e == QProcess::FailedToStart)
+      onWorkerStopped(w);
+    });
+
+  QStringList args;
+
+  if (!m_libclang_path.isEmpty())
+    args << m_libclang_path;
+
+  w.process->start(m_program, args);
+}
+
+bool IndexingWorkerPool::isRunning(const Worker& w) const
+{
+  return w.process && w.process->state() != QProcess::NotRunning;
+}
+
+void IndexingWorkerPool::dispatch()
+{
+  for (std::unique_ptr<Worker>& w : m_workers)
+  {
+    if (m_jobs.empty())
+      return;
+
+    if (!isRunning(*w) || w->job.has_value())
+      continue;
+
+    Job job = m_jobs.front();
+    m_jobs.pop_front();
+
+    if (job.indexing)
+      send(*w, job);
+  }
+
+  if (workerCount() == 0)
+  {
+    // no worker left, index everything in-process
+    std::list<Job> jobs = std::move(m_jobs);
+    m_jobs.clear();
+
+    for (const Job& job : jobs)
+      fallback(job);
+  }
+}
+
+void IndexingWorkerPool::send(Worker& w, Job job)
+{
+  TranslationUnit& tu = job.indexing->translationUnit();
+
+  clark::worker::Request request;
+  request.file = tu.filePath();
+
+  for (const std::string& dir : tu.compileOptions().includedirs)
+    request.includedirs.append(QString::fromStdString(dir));
+
+  job.sent_at = clark::telemetry::Recorder::instance().now();
+  w.job = job;
+  w.process->write(clark::worker::frame(clark::worker::write(request)));
+
+  if (m_job_timeout > 0)
+    w.timer->start(m_job_timeout);
+}
+
+void IndexingWorkerPool::onReadyRead(Worker& w)
+{
+  w.buffer.append(w.process->readAllStandardOutput());
+
+  QByteArray message;
+
+  while (clark::worker::unframe(w.buffer, message))
+  {
+    if (!w.job.has_value())
+    {
+      qDebug() << "IndexingWorkerPool: unexpected message from worker";
+      continue;
+    }
+
+    Job job = *w.job;
+    w.job.reset();
+    w.timer->stop();
+
+    clark::worker::Response response;
+    clark::IndexingResult result;
+
+    bool ok = clark::worker::read(message, response)
+      && response.status == clark::worker::Success
+      && clark::deserialize(response.data, result);
+
+    if (!ok)
+    {
+      qDebug() << "IndexingWorkerPool: worker failed to index translation unit:" << response.data;
+      fallback(job);
+    }
+    else if (job.indexing)
+    {
+      clark::telemetry::Span span;
+      span.category = clark::telemetry::Category::Index;
+      span.detail = job.indexing->translationUnit().filePath().toStdString();
+      span.thread = clark::telemetry::current_thread_id();
+      span.start = job.sent_at;
+      span.duration = clark::telemetry::Recorder::instance().now() - job.sent_at;
+      clark::telemetry::Recorder::instance().record(std::move(span));
+
+      job.indexing->setIndexingResult(std::move(result));
+    }
+  }
+
+  dispatch();
+}
+
+void IndexingWorkerPool::onWorkerStopped(Worker& w)
+{
+  w.timer->stop();
+
+  if (w.job.has_value())
+  {
+    Job job = *w.job;
+    w.job.reset();
+
+    qDebug() << "IndexingWorkerPool: worker stopped while processing a translation unit";
+    Q_EMIT workerCrashed();
+
+    if (++job.attempts < gMaxJobAttempts)
+      m_jobs.push_front(job);
+    else
+      fallback(job);
+  }
+
+  if (w.restarts < gMaxWorkerRestarts)
+  {
+    w.restarts += 1;
+    startWorker(w);
+  }
+  else if (w.process)
+  {
+    w.process->deleteLater();
+    w.process = nullptr;
+  }
+
+  dispatch();
+}
+
+void IndexingWorkerPool::onJobTimeout(Worker& w)
+{
+  if (!w.job.has_value() || !isRunning(w))
+    return;
+
+  Job job = *w.job;
+  w.job.reset();
+
+  qDebug() << "IndexingWorkerPool: worker timed out while processing a translation unit";
+  Q_EMIT workerTimedOut();
+
+  // the translation unit is not indexed in-process either, as it would 
+  // block an indexing thread in the same way; it can be indexed again 
+  // once it is loaded
+  if (job.indexing)
+    QMetaObject::invokeMethod(job.indexing, "onIndexingSkipped");
+
+  // the worker is restarted by onWorkerStopped()
+  w.process->kill();
+}
+
+void IndexingWorkerPool::fallback(const Job& job)
+{
+  if (job.indexing)
+    job.indexing->startInProcess();
+}
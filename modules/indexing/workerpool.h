@@ -0,0 +1,88 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_WORKERPOOL_H
+#define CLARK_WORKERPOOL_H
+
+#include <QObject>
+#include <QPointer>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <optional>
+#include <vector>
+
+class QProcess;
+class QTimer;
+
+class TranslationUnitIndexing;
+
+/**
+ * \brief parses and indexes translation units in clark-worker processes
+ * 
+ * Running libclang in separate processes protects clark from translation 
+ * units that exhaust the memory or crash libclang, and avoids contention 
+ * on libclang's process-global state.
+ * 
+ * A worker that crashes is restarted and its job is retried once; jobs 
+ * that cannot be processed by a worker are indexed in-process.
+ * A worker that takes longer than jobTimeout() on a translation unit is 
+ * considered hung: it is killed and restarted, and the job is skipped 
+ * rather than retried, as it would likely hang again.
+ */
+class IndexingWorkerPool : public QObject
+{
+  Q_OBJECT
+public:
+  IndexingWorkerPool(const QString& program, const QString& libclangPath, int workerCount, QObject* parent = nullptr);
+  ~IndexingWorkerPool();
+
+  int workerCount() const;
+  int pendingJobCount() const;
+
+  int jobTimeout() const;
+  void setJobTimeout(int msecs);
+
+  void submit(TranslationUnitIndexing* indexing);
+
+Q_SIGNALS:
+  void workerCrashed();
+  void workerTimedOut();
+
+private:
+  struct Job
+  {
+    QPointer<TranslationUnitIndexing> indexing;
+    int attempts = 0;
+    int64_t sent_at = 0;
+  };
+
+  struct Worker
+  {
+    QProcess* process = nullptr;
+    QByteArray buffer;
+    std::optional<Job> job;
+    QTimer* timer = nullptr;
+    int restarts = 0;
+  };
+
+  void startWorker(Worker& w);
+  bool isRunning(const Worker& w) const;
+  void dispatch();
+  void send(Worker& w, Job job);
+  void onReadyRead(Worker& w);
+  void onWorkerStopped(Worker& w);
+  void onJobTimeout(Worker& w);
+  void fallback(const Job& job);
+
+private:
+  QString m_program;
+  QString m_libclang_path;
+  int m_job_timeout;
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  std::list<Job> m_jobs;
+};
+
+#endif // CLARK_WORKERPOOL_H
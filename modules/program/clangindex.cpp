@@ -5,28 +5,105 @@
 #include "clangindex.h"
 
 #include "libclang.h"
+#include "precompiledheaders.h"
+#include "prefetchpolicy.h"
+
+#include "utils/executor.h"
+#include "utils/memory.h"
+#include "utils/telemetry.h"
 
 #include <libclang-utils/clang-index.h>
 #include <libclang-utils/clang-translation-unit.h>
 
-#include <QThreadPool>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QTimer>
 
 #include <QDebug>
 
-#include <iostream>
+#include <algorithm>
+#include <condition_variable>
 #include <mutex>
+#include <shared_mutex>
+
+/**
+ * \brief builds the list of unsaved files passed to libclang
+ * 
+ * The strings of \a overlays must outlive the returned list.
+ */
+static std::vector<CXUnsavedFile> make_unsaved_files(const std::map<std::string, std::string>& overlays)
+{
+  std::vector<CXUnsavedFile> unsaved_files;
+  unsaved_files.reserve(overlays.size());
+
+  for (const auto& p : overlays)
+  {
+    CXUnsavedFile f;
+    f.Filename = p.first.c_str();
+    f.Contents = p.second.data();
+    f.Length = static_cast<unsigned long>(p.second.size());
+    unsaved_files.push_back(f);
+  }
+
+  return unsaved_files;
+}
+
+/**
+ * \brief parses the main file of a translation unit, using a precompiled header if possible
+ */
+static std::unique_ptr<libclang::TranslationUnit> parse_clang_translation_unit(ClangIndex& index, TranslationUnit& tu, int options)
+{
+  libclang::Index& cindex = index.libclangIndex();
+
+  std::string pch;
+
+  if (index.precompiledHeaders())
+    pch = index.precompiledHeaders()->get(cindex, tu);
+
+  if (pch.empty())
+  {
+    return std::make_unique<libclang::TranslationUnit>(cindex.parseTranslationUnit(tu.filePath().toStdString(),
+      tu.compileOptions().includedirs, options));
+  }
+  else
+  {
+    std::vector<std::string> args;
+
+    for (const std::string& dir : tu.compileOptions().includedirs)
+      args.push_back("-I" + dir);
+
+    args.push_back("-include-pch");
+    args.push_back(pch);
+
+    return std::make_unique<libclang::TranslationUnit>(cindex.parseTranslationUnit(tu.filePath().toStdString(),
+      args, options));
+  }
+}
 
 class ParseTranslationUnit : public QRunnable
 {
+public:
+
+  enum Mode
+  {
+    Full,
+    Skeleton, // function bodies are skipped, errors are ignored
+  };
+
 private:
   ClangIndex& m_index;
   TranslationUnit& m_translation_unit;
+  Mode m_mode;
 
 public:
 
-  explicit ParseTranslationUnit(ClangIndex& index, TranslationUnit& tu) :
+  explicit ParseTranslationUnit(ClangIndex& index, TranslationUnit& tu, Mode mode = Full) :
     m_index(index),
-    m_translation_unit(tu)
+    m_translation_unit(tu),
+    m_mode(mode)
   {
     setAutoDelete(true);
   }
@@ -34,132 +111,1005 @@ public:
   void run() override
   {
     m_translation_unit.setState(TranslationUnit::State::Parsing);
+    m_index.discardAstFile(m_translation_unit);
+
+    int options = CXTranslationUnit_DetailedPreprocessingRecord;
+
+    if (m_mode == Skeleton)
+      options |= CXTranslationUnit_SkipFunctionBodies | CXTranslationUnit_Incomplete | CXTranslationUnit_KeepGoing;
+    else if (m_index.precompiledPreamble())
+      options |= CXTranslationUnit_PrecompiledPreamble;
 
-    libclang::Index& cindex = m_index.libclangIndex();
+    // replacing the clang translation unit of a suspended translation unit is a reparse for its listeners
+    bool reparse = m_translation_unit.clangTranslationUnit() != nullptr;
 
-    auto start = std::chrono::high_resolution_clock::now();
+    clark::telemetry::ScopedSpan span{ clark::telemetry::Category::Parse, m_translation_unit.filePath().toStdString() };
 
-    auto clangtu = std::make_unique<libclang::TranslationUnit>(cindex.parseTranslationUnit(m_translation_unit.filePath().toStdString(),
-      m_translation_unit.compileOptions().includedirs, CXTranslationUnit_DetailedPreprocessingRecord));
+    std::unique_ptr<libclang::TranslationUnit> clangtu = parse_clang_translation_unit(m_index, m_translation_unit, options);
 
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+    m_index.recordParseMemoryUsage(*clangtu, m_mode == Skeleton);
 
-    std::cout << "Parsed " << m_translation_unit.filePath().toStdString() << " in " << duration.count() << "ms" << std::endl;
+    m_translation_unit.setFlag(TranslationUnit::Skeleton, m_mode == Skeleton);
 
+    if (m_mode == Full)
+      m_translation_unit.setFlag(TranslationUnit::FullParseScheduled, false);
+
+    m_translation_unit.setFlag(TranslationUnit::FromAstFile, false);
     m_translation_unit.setClangTranslationUnit(std::move(clangtu));
+
+    if (reparse)
+      Q_EMIT m_translation_unit.reparsed();
   }
 };
 
+/**
+ * \brief resumes a suspended translation unit by reparsing it in place
+ * 
+ * The translation unit is in the Parsing state during the reparse, so it 
+ * has no users; tasks that were started before it was suspended are 
+ * excluded by the access mutex.
+ */
 class ReparseTranslationUnit : public QRunnable
 {
 private:
   ClangIndex& m_index;
   TranslationUnit& m_translation_unit;
 
-public:
+public:
+
+  explicit ReparseTranslationUnit(ClangIndex& index, TranslationUnit& tu) :
+    m_index(index),
+    m_translation_unit(tu)
+  {
+    setAutoDelete(true);
+  }
+
+  void run() override
+  {
+    m_translation_unit.setState(TranslationUnit::State::Parsing);
+    m_index.discardAstFile(m_translation_unit);
+
+    {
+      std::unique_lock<std::shared_mutex> access{ m_translation_unit.accessMutex() };
+
+      clark::telemetry::ScopedSpan span{ clark::telemetry::Category::Reparse, m_translation_unit.filePath().toStdString() };
+
+      // the strings must outlive the reparse
+      std::map<std::string, std::string> overlays = m_index.unsavedFiles();
+      std::vector<CXUnsavedFile> unsaved_files = make_unsaved_files(overlays);
+
+      libclang::TranslationUnit& tu = *m_translation_unit.clangTranslationUnit();
+      tu.reparseTranslationUnit(unsaved_files);
+
+      TranslationUnit::Data& data = m_translation_unit.data();
+      std::lock_guard<std::mutex> lock{ m_translation_unit.mutex() };
+      data.full_clang_translation_unit.reset();
+      data.generation.fetch_add(1);
+    }
+
+    m_translation_unit.setState(TranslationUnit::State::Loaded);
+
+    Q_EMIT m_translation_unit.reparsed();
+  }
+};
+
+/**
+ * \brief builds a new clang translation unit for a loaded translation unit
+ * 
+ * The users of a loaded translation unit may use its clang translation unit 
+ * at any time, so it cannot be reparsed in place.
+ * Instead, the clang translation unit replaced by the previous reparse is 
+ * reparsed (which reuses its precompiled preamble), or a new one is parsed; 
+ * the result is passed to TranslationUnit::setFullClangTranslationUnit() and 
+ * the ClangIndex swaps it in its own thread.
+ * 
+ * This is also used for the full parse of skeletons.
+ */
+class RebuildTranslationUnit : public QRunnable
+{
+private:
+  ClangIndex& m_index;
+  TranslationUnit& m_translation_unit;
+
+public:
+
+  explicit RebuildTranslationUnit(ClangIndex& index, TranslationUnit& tu) :
+    m_index(index),
+    m_translation_unit(tu)
+  {
+    setAutoDelete(true);
+  }
+
+  void run() override
+  {
+    const int generation = m_translation_unit.generation();
+
+    std::unique_ptr<libclang::TranslationUnit> clangtu = m_translation_unit.takeSpareClangTranslationUnit();
+
+    try
+    {
+      clark::telemetry::ScopedSpan span{ clark::telemetry::Category::Reparse, m_translation_unit.filePath().toStdString() };
+
+      // the strings must outlive the reparse
+      std::map<std::string, std::string> overlays = m_index.unsavedFiles();
+      std::vector<CXUnsavedFile> unsaved_files = make_unsaved_files(overlays);
+
+      if (clangtu)
+      {
+        clangtu->reparseTranslationUnit(unsaved_files);
+      }
+      else
+      {
+        int options = CXTranslationUnit_DetailedPreprocessingRecord;
+
+        if (m_index.precompiledPreamble())
+          options |= CXTranslationUnit_PrecompiledPreamble;
+
+        clangtu = parse_clang_translation_unit(m_index, m_translation_unit, options);
+
+        if (!unsaved_files.empty())
+          clangtu->reparseTranslationUnit(unsaved_files);
+      }
+    }
+    catch (const std::exception& ex)
+    {
+      qDebug() << "Could not reparse" << m_translation_unit.filePath() << ":" << ex.what();
+      clangtu.reset();
+    }
+
+    // the result is discarded if the translation unit was replaced meanwhile
+    if (!clangtu || !m_translation_unit.setFullClangTranslationUnit(std::move(clangtu), generation))
+    {
+      m_translation_unit.setFlag(TranslationUnit::Reparsing, false);
+      m_translation_unit.setFlag(TranslationUnit::FullParseScheduled, false);
+    }
+  }
+};
+
+/**
+ * \brief restores a suspended or hibernated translation unit from its AST file
+ * 
+ * If the AST file is missing or older than the source file, the translation 
+ * unit is parsed again.
+ */
+class RestoreTranslationUnit : public QRunnable
+{
+private:
+  ClangIndex& m_index;
+  TranslationUnit& m_translation_unit;
+
+public:
+
+  explicit RestoreTranslationUnit(ClangIndex& index, TranslationUnit& tu) :
+    m_index(index),
+    m_translation_unit(tu)
+  {
+    setAutoDelete(true);
+  }
+
+  void run() override
+  {
+    m_translation_unit.setState(TranslationUnit::State::Parsing);
+
+    QString ast = m_index.astFilePath(m_translation_unit);
+    QFileInfo ast_info{ ast };
+    QFileInfo source_info{ m_translation_unit.filePath() };
+
+    if (ast_info.exists() && (!source_info.exists() || source_info.lastModified() <= ast_info.lastModified()))
+    {
+      try
+      {
+        clark::telemetry::ScopedSpan span{ clark::telemetry::Category::Parse, m_translation_unit.filePath().toStdString() };
+        auto clangtu = std::make_unique<libclang::TranslationUnit>(m_index.libclangIndex().createTranslationUnit(ast.toStdString()));
+        m_translation_unit.setFlag(TranslationUnit::FromAstFile);
+        m_translation_unit.setClangTranslationUnit(std::move(clangtu));
+        return;
+      }
+      catch (const std::exception& ex)
+      {
+        qDebug() << "Could not restore" << m_translation_unit.filePath() << "from" << ast << ":" << ex.what();
+      }
+    }
+
+    ParseTranslationUnit parser{ m_index, m_translation_unit };
+    parser.run();
+  }
+};
+
+/**
+ * \brief saves the AST of an unused translation unit to disk and hibernates it
+ * 
+ * The translation unit is in the Parsing state while it is being saved; 
+ * if a handle requested it in the meantime, it goes back to the Loaded 
+ * state instead of being hibernated.
+ * The mutex of the translation unit is not held while the file is written, 
+ * so handles of other translation units are not blocked.
+ */
+class SaveTranslationUnit : public QRunnable
+{
+private:
+  ClangIndex& m_index;
+  TranslationUnit& m_translation_unit;
+
+public:
+
+  explicit SaveTranslationUnit(ClangIndex& index, TranslationUnit& tu) :
+    m_index(index),
+    m_translation_unit(tu)
+  {
+    setAutoDelete(true);
+  }
+
+  void run() override
+  {
+    TranslationUnit::Data& data = m_translation_unit.data();
+    QString path = m_index.astFilePath(m_translation_unit);
+    bool saved = false;
+
+    {
+      // the translation unit cannot be replaced while it is in the Parsing state, 
+      // background tasks may still read it
+      std::shared_lock<std::shared_mutex> access{ m_translation_unit.accessMutex() };
+
+      clark::telemetry::ScopedSpan span{ clark::telemetry::Category::Suspend, m_translation_unit.filePath().toStdString() };
+
+      try
+      {
+        QDir().mkpath(QFileInfo(path).path());
+        data.clang_translation_unit->saveTranslationUnit(path.toStdString());
+        saved = QFile::exists(path);
+      }
+      catch (const std::exception& ex)
+      {
+        qDebug() << "Could not save" << m_translation_unit.filePath() << ":" << ex.what();
+      }
+    }
+
+    std::unique_ptr<libclang::TranslationUnit> clangtu;
+
+    {
+      std::unique_lock<std::shared_mutex> access{ m_translation_unit.accessMutex() };
+      std::lock_guard<std::mutex> lock{ m_translation_unit.mutex() };
+
+      if (saved)
+        data.flags |= TranslationUnit::HasAstFile;
+
+      if (data.use_count != 0)
+      {
+        data.state = TranslationUnit::Loaded;
+      }
+      else if (saved)
+      {
+        clangtu = std::move(data.clang_translation_unit);
+        data.state = TranslationUnit::Hibernated;
+      }
+      else
+      {
+        data.clang_translation_unit->suspendTranslationUnit();
+        data.released_at = std::chrono::steady_clock::now();
+        data.state = TranslationUnit::Suspended;
+      }
+    }
+
+    m_translation_unit.loadedConditionVariable().notify_all();
+
+    Q_EMIT m_translation_unit.stateChanged();
+  }
+};
+
+/**
+ * \brief resumes a translation unit that is likely to be opened soon
+ * 
+ * The task does nothing if prefetching was cancelled after it was 
+ * created or if the translation unit was loaded in the meantime.
+ */
+class PrefetchTranslationUnit : public QRunnable
+{
+private:
+  ClangIndex& m_index;
+  TranslationUnit& m_translation_unit;
+  const std::atomic<int>& m_generation;
+  int m_expected_generation;
+
+public:
+
+  explicit PrefetchTranslationUnit(ClangIndex& index, TranslationUnit& tu, const std::atomic<int>& generation) :
+    m_index(index),
+    m_translation_unit(tu),
+    m_generation(generation),
+    m_expected_generation(generation.load())
+  {
+    setAutoDelete(true);
+  }
+
+  void run() override
+  {
+    TranslationUnit::State state = m_translation_unit.state();
+
+    if (m_generation.load() != m_expected_generation || (state != TranslationUnit::Suspended && state != TranslationUnit::Hibernated)
+      || m_translation_unit.used())
+    {
+      // the thread is available again for other work
+      QMetaObject::invokeMethod(&m_index, "checkParsing", Qt::QueuedConnection);
+      return;
+    }
+
+    std::unique_ptr<QRunnable> loader{ m_index.loaderFactory().createLoader(m_index, m_translation_unit) };
+    loader->run();
+  }
+};
+
+/**
+ * \brief the tasks started by a ClangIndex
+ * 
+ * The group outlives the index so that tasks that start after the index 
+ * was destroyed can see that they were cancelled.
+ */
+struct ClangIndex::TaskGroup
+{
+  std::mutex mutex;
+  std::condition_variable finished;
+  int running = 0;
+  bool cancelled = false;
+};
+
+class ClangIndexTask : public QRunnable
+{
+private:
+  std::shared_ptr<ClangIndex::TaskGroup> m_group;
+  std::unique_ptr<QRunnable> m_task;
+
+public:
+
+  ClangIndexTask(std::shared_ptr<ClangIndex::TaskGroup> group, QRunnable* task) :
+    m_group(std::move(group)),
+    m_task(task)
+  {
+    setAutoDelete(true);
+  }
+
+  void run() override
+  {
+    {
+      std::lock_guard<std::mutex> lock{ m_group->mutex };
+
+      if (m_group->cancelled)
+        return;
+
+      ++m_group->running;
+    }
+
+    m_task->run();
+
+    {
+      std::lock_guard<std::mutex> lock{ m_group->mutex };
+      --m_group->running;
+    }
+
+    m_group->finished.notify_all();
+  }
+};
+
+TranslationUnitLoaderFactory::~TranslationUnitLoaderFactory()
+{
+
+}
+
+QRunnable* TranslationUnitLoaderFactory::createLoader(ClangIndex& index, TranslationUnit& t)
+{
+  TranslationUnit::State s = t.state();
+
+  if (s == TranslationUnit::State::AwaitingParsing)
+    return new ParseTranslationUnit(index, t);
+
+  // a loaded translation unit may be in use, it is replaced rather than reparsed in place
+  if (s == TranslationUnit::State::Loaded)
+    return new RebuildTranslationUnit(index, t);
+
+  if ((s == TranslationUnit::State::Suspended || s == TranslationUnit::State::Hibernated) && (t.flags() & TranslationUnit::HasAstFile))
+    return new RestoreTranslationUnit(index, t);
+
+  // translation units restored from an AST file cannot be reparsed, 
+  // and reparsing a skeleton would skip the function bodies again
+  if (s == TranslationUnit::State::Hibernated || (t.flags() & (TranslationUnit::FromAstFile | TranslationUnit::Skeleton)))
+    return new ParseTranslationUnit(index, t);
+
+  return new ReparseTranslationUnit(index, t);
+}
+
+/**
+ * \brief creates a loader that only produces an outline of the translation unit
+ * 
+ * Function bodies are skipped, which makes parsing a lot faster.
+ * If the translation unit was already parsed, this behaves like createLoader().
+ */
+QRunnable* TranslationUnitLoaderFactory::createSkeletonLoader(ClangIndex& index, TranslationUnit& t)
+{
+  if (t.state() == TranslationUnit::State::AwaitingParsing)
+    return new ParseTranslationUnit(index, t, ParseTranslationUnit::Skeleton);
+  else
+    return createLoader(index, t);
+}
+
+/**
+ * \brief creates a loader that performs a full parse of a skeleton translation unit
+ * 
+ * The result is passed to TranslationUnit::setFullClangTranslationUnit(), 
+ * the skeleton stays usable meanwhile.
+ */
+QRunnable* TranslationUnitLoaderFactory::createFullParser(ClangIndex& index, TranslationUnit& t)
+{
+  return new RebuildTranslationUnit(index, t);
+}
+
+ClangIndex::ClangIndex(LibClang& lib, QObject* parent) : QObject(parent),
+  m_library(lib),
+  m_loader_factory(std::make_unique<TranslationUnitLoaderFactory>()),
+  m_prefetch_policy(std::make_unique<PrefetchPolicy>()),
+  m_check_parsing(this, "checkParsing"),
+  m_schedule_prefetching(this, "schedulePrefetching"),
+  m_unload_translation_units(this, "unloadTranslationUnits"),
+  m_reparse_timer(new QTimer(this)),
+  m_hibernation_timer(new QTimer(this)),
+  m_busy_timer(new QTimer(this)),
+  m_tasks(std::make_shared<TaskGroup>())
+{
+  if (!m_library.libclangAvailable())
+    throw std::runtime_error("ClangIndex: libclang is not available");
+
+  m_index = std::make_unique<libclang::Index>(m_library.libclang()->createIndex());
+
+  m_precompiled_headers = std::make_unique<PrecompiledHeaders>(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/pch");
+
+  m_executor = &Executor::get(Executor::Parse);
+
+  m_reparse_timer->setSingleShot(true);
+  m_busy_timer->setSingleShot(true);
+
+  connect(m_reparse_timer, &QTimer::timeout, this, &ClangIndex::reparseTranslationUnits);
+  connect(m_busy_timer, &QTimer::timeout, this, &ClangIndex::retryBusyTranslationUnits);
+  connect(m_hibernation_timer, &QTimer::timeout, this, &ClangIndex::hibernateTranslationUnits);
+}
+
+/**
+ * \brief destroys the index
+ * 
+ * The tasks of the index that have not started yet are cancelled, and 
+ * the destructor waits for the running ones to finish.
+ */
+ClangIndex::~ClangIndex()
+{
+  {
+    std::unique_lock<std::mutex> lock{ m_tasks->mutex };
+    m_tasks->cancelled = true;
+    m_tasks->finished.wait(lock, [this]() { return m_tasks->running == 0; });
+  }
+
+#ifdef CLARK_DEBUG_DESTRUCTORS
+  qDebug() << "~ClangIndex()";
+#endif
+
+  for (TranslationUnit* tu : m_translation_units)
+    discardAstFile(*tu);
+
+  for (TranslationUnit* tu : m_translation_units_to_hibernate)
+    discardAstFile(*tu);
+}
+
+libclang::Index& ClangIndex::libclangIndex() const
+{
+  return *m_index;
+}
+
+/**
+ * \brief adds translation units to the index
+ * \param list  the translation units
+ * 
+ * Translation units keep their own compile options.
+ * The index takes ownership of the translation units.
+ */
+void ClangIndex::addTranslationUnits(const std::vector<TranslationUnit*>& list)
+{
+  m_translation_units.reserve(m_translation_units.size() + list.size());
+
+  for (auto tu : list)
+    addToList(tu);
+
+  Q_EMIT translationUnitsAdded((int)list.size());
+}
+
+void ClangIndex::addTranslationUnits(const std::vector<TranslationUnit*>& list, const program::CompileOptions& options)
+{
+  auto opts = program::intern(options);
+
+  for (auto tu : list)
+  {
+    tu->setCompileOptions(opts);
+    addToList(tu);
+  }
+
+  Q_EMIT translationUnitsAdded((int)list.size());
+}
+
+const std::vector<TranslationUnit*>& ClangIndex::translationUnits() const
+{
+  return m_translation_units;
+}
+
+void ClangIndex::setTranslationUnits(std::vector<TranslationUnit*> list)
+{
+  m_translation_units = std::move(list);
+
+  for (TranslationUnit* tu : m_translation_units)
+    manage(tu);
+}
+
+void ClangIndex::load(TranslationUnit* tu)
+{
+  TranslationUnit::State s = tu->state();
+
+  if (s == TranslationUnit::State::Loaded || s == TranslationUnit::State::Parsing)
+    return;
+
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  // interactive work has priority over speculative work
+  cancelPendingPrefetches();
+
+  if (m_loaded_translation_units.insert(tu).second)
+  {
+    connect(tu, &TranslationUnit::aboutToBeDestroyed, this, [this, tu]() {
+      {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_loaded_translation_units.erase(tu);
+      }
+
+      m_translation_units_to_reparse.erase(std::remove(m_translation_units_to_reparse.begin(), m_translation_units_to_reparse.end(), tu), m_translation_units_to_reparse.end());
+      m_translation_units_to_install.erase(std::remove(m_translation_units_to_install.begin(), m_translation_units_to_install.end(), tu), m_translation_units_to_install.end());
+      }, Qt::DirectConnection);
+  }
+
+  auto it = std::find(m_translation_unit_parsing_queue.begin(), m_translation_unit_parsing_queue.end(), tu);
+
+  if (it != m_translation_unit_parsing_queue.end())
+    m_translation_unit_parsing_queue.erase(it);
+
+  // explicit loads always get a full parse
+  parse(tu);
+
+  m_prefetch_origin = tu;
+  m_schedule_prefetching.scheduleCall();
+}
+
+/**
+ * \brief returns whether translation units in the parsing queue are first parsed as skeletons
+ * 
+ * When enabled, queued translation units are first parsed without their function 
+ * bodies; a full parse is then scheduled in the background and replaces the 
+ * skeleton like a reparse (see installFullParse()).
+ * 
+ * Translation units that are explicitly loaded with load() are always fully parsed.
+ */
+bool ClangIndex::skeletonParsing() const
+{
+  return m_skeleton_parsing;
+}
+
+void ClangIndex::setSkeletonParsing(bool on)
+{
+  m_skeleton_parsing = on;
+}
+
+/**
+ * \brief returns whether translation units are parsed before they are loaded
+ * 
+ * When enabled (the default), every translation unit that is added to the index 
+ * is queued for parsing, so that it is ready when it is opened.
+ * When disabled, translation units are only parsed by load(); this is used 
+ * when another component, e.g. a pool of worker processes, indexes the 
+ * translation units that were not opened.
+ * 
+ * This only affects the translation units that are added afterwards.
+ */
+bool ClangIndex::backgroundParsing() const
+{
+  return m_background_parsing;
+}
+
+void ClangIndex::setBackgroundParsing(bool on)
+{
+  m_background_parsing = on;
+}
+
+/**
+ * \brief returns the cache of precompiled headers used while parsing
+ * 
+ * Translation units sharing the same compile options and the same first 
+ * included header are parsed using a common precompiled header.
+ * This returns nullptr if precompiled headers are disabled.
+ */
+PrecompiledHeaders* ClangIndex::precompiledHeaders() const
+{
+  return m_precompiled_headers.get();
+}
+
+/**
+ * \brief sets the cache of precompiled headers
+ * \param pchs  the cache, or nullptr to disable precompiled headers
+ */
+void ClangIndex::setPrecompiledHeaders(std::unique_ptr<PrecompiledHeaders> pchs)
+{
+  m_precompiled_headers = std::move(pchs);
+}
+
+/**
+ * \brief returns whether the number of concurrent parses depends on the available memory
+ * 
+ * When enabled, the index estimates how much memory parsing a translation 
+ * unit requires and limits the number of concurrent parses so that the 
+ * system does not run out of physical memory.
+ */
+bool ClangIndex::adaptiveConcurrency() const
+{
+  return m_adaptive_concurrency;
+}
+
+void ClangIndex::setAdaptiveConcurrency(bool on)
+{
+  m_adaptive_concurrency = on;
+}
+
+/**
+ * \brief returns the maximum number of translation units that can currently be parsed at once
+ * 
+ * This is at most one less than the number of threads of the parse executor, 
+ * and at least 1.
+ */
+int ClangIndex::parsingConcurrency() const
+{
+  int maxthread = std::max(m_executor->maxThreadCount() - 1, 1);
+
+  if (!adaptiveConcurrency())
+    return maxthread;
+
+  // the queued parses are skeletons as long as skeleton parsing is enabled
+  size_t estimate = parseMemoryEstimate(skeletonParsing());
+
+  if (estimate == 0)
+    estimate = parseMemoryEstimate(!skeletonParsing());
+
+  size_t available = clark::memory::available_physical_memory();
+
+  if (estimate == 0 || available == 0)
+    return maxthread;
+
+  // memory kept free for the rest of the system
+  constexpr size_t headroom = size_t(512) * 1024 * 1024;
+
+  // running parses have not reached their peak memory usage yet
+  size_t running = static_cast<size_t>(m_executor->threadPool()->activeThreadCount());
+  size_t committed = (running * estimate) / 2 + headroom;
+  size_t budget = available > committed ? available - committed : 0;
+
+  size_t n = running + budget / estimate;
+
+  return static_cast<int>(std::clamp<size_t>(n, 1, static_cast<size_t>(maxthread)));
+}
+
+/**
+ * \brief returns the estimated amount of memory required to parse a translation unit, in bytes
+ * \param skeleton  whether the estimate is for a skeleton parse
+ * 
+ * Skeletons skip function bodies and are much smaller than full parses, 
+ * so each kind of parse has its own estimate.
+ * Returns 0 if no parse of that kind has completed yet.
+ */
+size_t ClangIndex::parseMemoryEstimate(bool skeleton) const
+{
+  return skeleton ? m_skeleton_parse_memory_estimate.load() : m_parse_memory_estimate.load();
+}
+
+/**
+ * \brief returns the memory used by a clang translation unit, in bytes
+ * 
+ * This is the sum of the resource usage reported by libclang, which 
+ * includes the AST, the source manager buffers and the preprocessor.
+ */
+size_t ClangIndex::memoryUsage(const libclang::TranslationUnit& tu)
+{
+  CXTUResourceUsage usage = tu.api->clang_getCXTUResourceUsage(tu.translation_unit);
+  size_t bytes = 0;
+
+  for (unsigned i(0); i < usage.numEntries; ++i)
+    bytes += static_cast<size_t>(usage.entries[i].amount);
+
+  tu.api->clang_disposeCXTUResourceUsage(usage);
+
+  return bytes;
+}
+
+/**
+ * \brief updates the estimate of the memory required to parse a translation unit
+ * \param tu        the clang translation unit produced by the parse
+ * \param skeleton  whether it is a skeleton
+ * 
+ * Unlike the growth of the process memory, the resource usage of the 
+ * translation unit is not skewed by the parses that run concurrently.
+ * 
+ * This function is thread-safe.
+ */
+void ClangIndex::recordParseMemoryUsage(const libclang::TranslationUnit& tu, bool skeleton)
+{
+  std::atomic<size_t>& target = skeleton ? m_skeleton_parse_memory_estimate : m_parse_memory_estimate;
+  size_t bytes = memoryUsage(tu);
+
+  if (bytes > 0)
+  {
+    size_t estimate = target.load();
+    size_t updated;
+
+    do
+    {
+      // exponential moving average, biased toward large translation units
+      updated = estimate == 0 ? bytes : (bytes > estimate ? (estimate + bytes) / 2 : (7 * estimate + bytes) / 8);
+    } while (!target.compare_exchange_weak(estimate, updated));
+  }
+
+  // a parse completed: the number of parses that can run may have changed
+  QMetaObject::invokeMethod(this, "checkParsing", Qt::QueuedConnection);
+}
+
+/**
+ * \brief returns whether fully parsed translation units keep a precompiled preamble
+ * 
+ * The preamble (the includes at the top of the main file) is precompiled 
+ * during the first reparse and reused by the following ones, which makes 
+ * reparsing after an edit much faster.
+ * 
+ * As loaded translation units are not reparsed in place (see installFullParse()), 
+ * the clang translation unit replaced by a reparse is kept so that the next 
+ * reparse can reuse its preamble; this roughly doubles the memory used by 
+ * the translation units that are edited.
+ */
+bool ClangIndex::precompiledPreamble() const
+{
+  return m_precompiled_preamble;
+}
+
+void ClangIndex::setPrecompiledPreamble(bool on)
+{
+  m_precompiled_preamble = on;
+}
 
-  explicit ReparseTranslationUnit(ClangIndex& index, TranslationUnit& tu) :
-    m_index(index),
-    m_translation_unit(tu)
+/**
+ * \brief sets the content of a file that differs from the content on disk
+ * \param path     the path of the file
+ * \param content  the content of the file
+ * 
+ * The overlay is used by every following reparse, and the translation units 
+ * that may depend on the file are reparsed (see notifyFileChanged()).
+ * This function is thread-safe, but must be called from the thread of the index.
+ */
+void ClangIndex::setUnsavedFile(const QString& path, const QByteArray& content)
+{
   {
-    setAutoDelete(true);
+    std::lock_guard<std::mutex> lock{ m_unsaved_files_mutex };
+    m_unsaved_files[path.toStdString()] = content.toStdString();
   }
 
-  void run() override
-  {
-    m_translation_unit.setState(TranslationUnit::State::Parsing);
+  notifyFileChanged(path);
+}
 
-    libclang::TranslationUnit& tu = *m_translation_unit.clangTranslationUnit();
-    tu.reparseTranslationUnit();
+/**
+ * \brief removes the overlay of a file
+ * 
+ * The content on disk is used again by the following reparses.
+ */
+void ClangIndex::removeUnsavedFile(const QString& path)
+{
+  {
+    std::lock_guard<std::mutex> lock{ m_unsaved_files_mutex };
 
-    m_translation_unit.setState(TranslationUnit::State::Loaded);
+    if (m_unsaved_files.erase(path.toStdString()) == 0)
+      return;
   }
-};
 
-TranslationUnitLoaderFactory::~TranslationUnitLoaderFactory()
+  notifyFileChanged(path);
+}
+
+/**
+ * \brief returns a copy of the unsaved-file overlays, indexed by file path
+ */
+std::map<std::string, std::string> ClangIndex::unsavedFiles() const
 {
+  std::lock_guard<std::mutex> lock{ m_unsaved_files_mutex };
+  return m_unsaved_files;
+}
 
+/**
+ * \brief returns the delay used to coalesce change notifications, in milliseconds
+ * 
+ * A translation unit is reparsed once no change affecting it has been 
+ * notified for this amount of time.
+ */
+int ClangIndex::reparseDelay() const
+{
+  return m_reparse_delay;
 }
 
-QRunnable* TranslationUnitLoaderFactory::createLoader(ClangIndex& index, TranslationUnit& t)
+void ClangIndex::setReparseDelay(int msecs)
 {
-  if (t.state() == TranslationUnit::State::AwaitingParsing)
-    return new ParseTranslationUnit(index, t);
-  else
-    return new ReparseTranslationUnit(index, t);
+  m_reparse_delay = std::max(msecs, 0);
 }
 
-ClangIndex::ClangIndex(LibClang& lib, QObject* parent) : QObject(parent),
-  m_library(lib),
-  m_loader_factory(std::make_unique<TranslationUnitLoaderFactory>()),
-  m_check_parsing(this, "checkParsing"),
-  m_unload_translation_units(this, "unloadTranslationUnits")
+/**
+ * \brief notifies the index that a file was modified
+ * \param path  the path of the file
+ * 
+ * Loaded translation units that include the file are reparsed after a short delay; 
+ * the AST files of suspended and hibernated translation units are 
+ * discarded so that they are parsed again on their next load.
+ */
+void ClangIndex::notifyFileChanged(const QString& path)
 {
-  if (!m_library.libclangAvailable())
-    throw std::runtime_error("ClangIndex: libclang is not available");
+  std::set<TranslationUnit*> tus{ m_translation_units.begin(), m_translation_units.end() };
 
-  m_index = std::make_unique<libclang::Index>(m_library.libclang()->createIndex());
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    tus.insert(m_loaded_translation_units.begin(), m_loaded_translation_units.end());
+  }
 
-  m_thread_pool = new QThreadPool(this);
+  const std::string filepath = path.toStdString();
+
+  for (TranslationUnit* tu : tus)
+  {
+    switch (tu->state())
+    {
+    case TranslationUnit::Loaded:
+      // a loaded translation unit is only replaced in this thread (see installFullParse())
+      if (tu->filePath() == path || tu->clangTranslationUnit()->getFile(filepath).data)
+        scheduleReparse(tu);
+      break;
+    case TranslationUnit::Parsing:
+      // we cannot tell whether the file is part of the translation unit yet
+      scheduleReparse(tu);
+      break;
+    case TranslationUnit::Suspended:
+    case TranslationUnit::Hibernated:
+      discardAstFile(*tu);
+      break;
+    default:
+      break;
+    }
+  }
 }
 
-ClangIndex::~ClangIndex()
+/**
+ * \brief schedules the reparse of a translation unit
+ * 
+ * Successive calls within reparseDelay() result in a single reparse.
+ */
+void ClangIndex::scheduleReparse(TranslationUnit* tu)
 {
- //$todo: cancel parsing of translation units
-  // wait for the threadpool
-  
-#ifdef CLARK_DEBUG_DESTRUCTORS
-  qDebug() << "~ClangIndex()";
-#endif
+  if (std::find(m_translation_units_to_reparse.begin(), m_translation_units_to_reparse.end(), tu) == m_translation_units_to_reparse.end())
+    m_translation_units_to_reparse.push_back(tu);
+
+  m_reparse_timer->start(reparseDelay());
 }
 
-libclang::Index& ClangIndex::libclangIndex() const
+/**
+ * \brief returns the delay after which an unused translation unit is hibernated, in milliseconds
+ * 
+ * A translation unit that was used and is no longer used stays loaded for 
+ * this delay; its AST is then saved to disk (see astFilePath()) and the 
+ * clang translation unit is destroyed. Loading the translation unit again 
+ * restores it from the AST file, which is faster than parsing it.
+ * Suspended translation units that already have an AST file are destroyed 
+ * after the same delay.
+ * 
+ * A negative value disables hibernation.
+ */
+int ClangIndex::hibernationDelay() const
 {
-  return *m_index;
+  return m_hibernation_delay;
 }
 
-void ClangIndex::addTranslationUnits(const std::vector<TranslationUnit*>& list, const program::CompileOptions& options)
+void ClangIndex::setHibernationDelay(int msecs)
 {
-  auto opts = std::make_shared<program::CompileOptions>(options);
+  m_hibernation_delay = msecs;
 
-  for (auto tu : list)
+  if (m_hibernation_delay < 0)
   {
-    tu->setCompileOptions(opts);
-    addToList(tu);
+    m_translation_units_to_hibernate.clear();
+    m_hibernation_timer->stop();
   }
+}
 
-  Q_EMIT translationUnitsAdded((int)list.size());
+/**
+ * \brief returns the path of the file in which the AST of a translation unit is saved
+ */
+QString ClangIndex::astFilePath(const TranslationUnit& tu) const
+{
+  QCryptographicHash hash{ QCryptographicHash::Sha1 };
+  hash.addData(tu.filePath().toUtf8());
+  hash.addData(QByteArray::number(reinterpret_cast<quintptr>(&tu)));
+  return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/ast/" + QString::fromLatin1(hash.result().toHex()) + ".ast";
 }
 
-const std::vector<TranslationUnit*>& ClangIndex::translationUnits() const
+/**
+ * \brief removes the AST file of a translation unit, if any
+ * 
+ * This must be called when the translation unit is about to be parsed again.
+ */
+void ClangIndex::discardAstFile(TranslationUnit& tu)
 {
-  return m_translation_units;
+  if (!(tu.flags() & TranslationUnit::HasAstFile))
+    return;
+
+  tu.setFlag(TranslationUnit::HasAstFile, false);
+  QFile::remove(astFilePath(tu));
 }
 
-void ClangIndex::setTranslationUnits(std::vector<TranslationUnit*> list)
+/**
+ * \brief returns the policy used to select translation units to prefetch
+ * 
+ * When a translation unit is loaded with load(), the translation units that 
+ * are likely to be opened next are parsed or resumed in the background 
+ * with a low priority.
+ * This returns nullptr if prefetching is disabled.
+ */
+PrefetchPolicy* ClangIndex::prefetchPolicy() const
 {
-  m_translation_units = std::move(list);
+  return m_prefetch_policy.get();
+}
 
-  for (TranslationUnit* tu : m_translation_units)
-    manage(tu);
+/**
+ * \brief sets the prefetch policy
+ * \param policy  the policy, or nullptr to disable prefetching
+ */
+void ClangIndex::setPrefetchPolicy(std::unique_ptr<PrefetchPolicy> policy)
+{
+  m_prefetch_policy = std::move(policy);
 }
 
-void ClangIndex::load(TranslationUnit* tu)
+/**
+ * \brief returns the maximum number of translation units prefetched after a load
+ */
+int ClangIndex::prefetchCount() const
 {
-  TranslationUnit::State s = tu->state();
+  return m_prefetch_count;
+}
 
-  if (s == TranslationUnit::State::Loaded || s == TranslationUnit::State::Parsing)
-    return;
+void ClangIndex::setPrefetchCount(int n)
+{
+  m_prefetch_count = std::max(n, 0);
+}
 
-  std::lock_guard<std::mutex> lock{ m_mutex };
+/**
+ * \brief prefetches the translation units that are likely to be opened after a given one
+ * \param tu  the translation unit that was opened
+ * 
+ * Prefetching happens automatically when a translation unit is loaded with load().
+ */
+void ClangIndex::prefetch(TranslationUnit* tu)
+{
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    m_prefetch_origin = tu;
+  }
 
-  auto it = std::find(m_translation_unit_parsing_queue.begin(), m_translation_unit_parsing_queue.end(), tu);
+  schedulePrefetching();
+}
 
-  if (it != m_translation_unit_parsing_queue.end())
-    parse(it);
-  else
-    parse(tu);
+/**
+ * \brief cancels the prefetches that have not started yet
+ * 
+ * Prefetches that are already running cannot be interrupted.
+ */
+void ClangIndex::cancelPrefetching()
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  cancelPendingPrefetches();
 }
 
 TranslationUnitLoaderFactory& ClangIndex::loaderFactory() const
@@ -186,8 +1136,9 @@ void ClangIndex::manage(TranslationUnit* tu)
   tu->setParent(this);
   tu->setClangIndex(this);
   connect(tu, &TranslationUnit::usedChanged, this, &ClangIndex::onTranslationUnitUsedChanged);
+  connect(tu, &TranslationUnit::fullParseReady, this, &ClangIndex::onTranslationUnitFullParseReady);
 
-  if (tu->state() == TranslationUnit::AwaitingParsing)
+  if (tu->state() == TranslationUnit::AwaitingParsing && backgroundParsing())
   {
     // $todo: check if tu has data in db, otherwise parse
     // ...
@@ -211,33 +1162,165 @@ void ClangIndex::checkParsing()
 
   std::lock_guard<std::mutex> lock{ m_mutex };
 
-  if (m_translation_unit_parsing_queue.empty())
+  if (m_translation_unit_parsing_queue.empty() && m_translation_unit_full_parsing_queue.empty() 
+    && m_translation_unit_prefetch_queue.empty())
     return;
 
-  int maxthread = std::max(m_thread_pool->maxThreadCount() - 1, 1);
+  int maxthread = parsingConcurrency();
 
-  while (m_thread_pool->activeThreadCount() < maxthread && !m_translation_unit_parsing_queue.empty())
+  while (m_executor->threadPool()->activeThreadCount() < maxthread && !m_translation_unit_parsing_queue.empty())
     parse(m_translation_unit_parsing_queue.begin());
+
+  // prefetches only use threads that would otherwise be idle
+  while (m_executor->threadPool()->activeThreadCount() < maxthread && m_translation_unit_parsing_queue.empty()
+    && !m_translation_unit_prefetch_queue.empty())
+  {
+    TranslationUnit* tu = m_translation_unit_prefetch_queue.front();
+    m_translation_unit_prefetch_queue.pop_front();
+    connect(tu, &TranslationUnit::loaded, this, &ClangIndex::onTranslationUnitParsed, Qt::UniqueConnection);
+    startTask(new PrefetchTranslationUnit(*this, *tu, m_prefetch_generation), -1);
+  }
+
+  // full parses of skeletons only start once every queued translation unit has an outline
+  while (m_executor->threadPool()->activeThreadCount() < maxthread && m_translation_unit_parsing_queue.empty() 
+    && !m_translation_unit_full_parsing_queue.empty())
+  {
+    TranslationUnit* tu = m_translation_unit_full_parsing_queue.front();
+    m_translation_unit_full_parsing_queue.pop_front();
+
+    // a reparse is already building a full clang translation unit
+    if (tu->flags() & TranslationUnit::Reparsing)
+      continue;
+
+    tu->setFlag(TranslationUnit::Reparsing);
+    startTask(loaderFactory().createFullParser(*this, *tu));
+  }
+}
+
+/**
+ * \brief starts a task of the index in the parse executor
+ * \param task      the task, deleted once it has run or was cancelled
+ * \param priority  the priority of the task in the queue
+ * 
+ * The executors are shared by every index; the tasks started with this 
+ * function are tracked so that the destructor can wait for them.
+ */
+void ClangIndex::startTask(QRunnable* task, int priority)
+{
+  m_executor->start(new ClangIndexTask(m_tasks, task), priority);
 }
 
 void ClangIndex::parse(std::list<TranslationUnit*>::iterator it)
 {
   TranslationUnit* tu = *it;
   m_translation_unit_parsing_queue.erase(it);
-  parse(tu);
+
+  if (skeletonParsing())
+    parseSkeleton(tu);
+  else
+    parse(tu);
 }
 
 void ClangIndex::parse(TranslationUnit* tu)
 {
-  connect(tu, &TranslationUnit::loaded, this, &ClangIndex::onTranslationUnitParsed);
+  connect(tu, &TranslationUnit::loaded, this, &ClangIndex::onTranslationUnitParsed, Qt::UniqueConnection);
  
   QRunnable* task = loaderFactory().createLoader(*this, *tu);
 
-  m_thread_pool->start(task);
+  startTask(task);
+}
+
+void ClangIndex::parseSkeleton(TranslationUnit* tu)
+{
+  connect(tu, &TranslationUnit::loaded, this, &ClangIndex::onTranslationUnitParsed, Qt::UniqueConnection);
+
+  QRunnable* task = loaderFactory().createSkeletonLoader(*this, *tu);
+
+  startTask(task);
+}
+
+void ClangIndex::scheduleFullParsing(TranslationUnit* tu)
+{
+  if (tu->flags() & TranslationUnit::FullParseScheduled)
+    return;
+
+  tu->setFlag(TranslationUnit::FullParseScheduled);
+
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  m_translation_unit_full_parsing_queue.push_back(tu);
+  m_check_parsing.scheduleCall();
+}
+
+void ClangIndex::schedulePrefetching()
+{
+  m_schedule_prefetching.clearCallFlag();
+
+  TranslationUnit* origin = nullptr;
+
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    origin = m_prefetch_origin;
+    m_prefetch_origin = nullptr;
+  }
+
+  std::vector<TranslationUnit*> neighbours;
+
+  if (origin && prefetchPolicy())
+    neighbours = prefetchPolicy()->neighbours(*this, *origin, static_cast<size_t>(prefetchCount()));
+
+  std::vector<TranslationUnit*> released;
+
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+
+    for (TranslationUnit* tu : m_prefetched_translation_units)
+    {
+      if (std::find(neighbours.begin(), neighbours.end(), tu) == neighbours.end())
+        released.push_back(tu);
+    }
+
+    m_prefetched_translation_units = neighbours;
+
+    // never-parsed neighbours are moved to the front of the parsing queue, 
+    // in reverse order so that the most likely comes first
+    for (auto it = neighbours.rbegin(); it != neighbours.rend(); ++it)
+    {
+      TranslationUnit* tu = *it;
+
+      auto queued = std::find(m_translation_unit_parsing_queue.begin(), m_translation_unit_parsing_queue.end(), tu);
+
+      if (queued != m_translation_unit_parsing_queue.end())
+        m_translation_unit_parsing_queue.splice(m_translation_unit_parsing_queue.begin(), m_translation_unit_parsing_queue, queued);
+    }
+
+    for (TranslationUnit* tu : neighbours)
+    {
+      if (tu->state() == TranslationUnit::Suspended || tu->state() == TranslationUnit::Hibernated)
+        m_translation_unit_prefetch_queue.push_back(tu);
+    }
+
+    m_check_parsing.scheduleCall();
+  }
+
+  // translation units that are no longer likely to be opened can be suspended again
+  for (TranslationUnit* tu : released)
+    checkUsed(tu);
+}
+
+// m_mutex must be locked
+void ClangIndex::cancelPendingPrefetches()
+{
+  m_prefetch_generation.fetch_add(1);
+  m_prefetch_origin = nullptr;
+  m_translation_unit_prefetch_queue.clear();
 }
 
 void ClangIndex::checkUsed(TranslationUnit* tu)
 {
+  // prefetched translation units are kept warm until the user opens another one
+  if (std::find(m_prefetched_translation_units.begin(), m_prefetched_translation_units.end(), tu) != m_prefetched_translation_units.end())
+    return;
+
   if (!tu->used())
   {
     m_translation_units_to_unload.push_back(tu);
@@ -249,28 +1332,293 @@ void ClangIndex::unloadTranslationUnits()
 {
   m_unload_translation_units.clearCallFlag();
 
+  std::vector<TranslationUnit*> busy;
+
   for (TranslationUnit* tu : m_translation_units_to_unload)
   {
+    TranslationUnit::Data& data = tu->data();
+
+    if (data.use_count != 0)
+      continue;
+
+    // a background task may still be using the clang translation unit
+    std::unique_lock<std::shared_mutex> access{ tu->accessMutex(), std::try_to_lock };
+
+    if (!access.owns_lock())
+    {
+      busy.push_back(tu);
+      continue;
+    }
+
     std::unique_lock lock{ tu->mutex() };
 
-    bool unloaded = false;
+    // claim the translation unit by moving it out of the Loaded state, then 
+    // check the use count again: a handle increments the use count before 
+    // checking the state, so either it sees the claim and waits on the mutex 
+    // or we see its reference and give up.
+    TranslationUnit::State previous_state = TranslationUnit::Loaded;
 
-    if (tu->data().use_count == 0 && tu->data().state == TranslationUnit::Loaded)
+    if (!data.state.compare_exchange_strong(previous_state, TranslationUnit::Suspended)
+      && previous_state != TranslationUnit::Suspended)
+      continue;
+
+    if (data.use_count != 0)
     {
-      tu->data().clang_translation_unit->suspendTranslationUnit();
+      if (previous_state == TranslationUnit::Loaded)
+        data.state = TranslationUnit::Loaded;
+
+      continue;
+    }
 
-      tu->data().state = TranslationUnit::Suspended;
+    bool state_changed = false;
+    bool schedule_hibernation = false;
 
-      unloaded = true;
+    if (previous_state == TranslationUnit::Loaded)
+    {
+      data.spare_clang_translation_unit.reset();
+
+      data.released_at = std::chrono::steady_clock::now();
+
+      if (isHibernationCandidate(*tu))
+      {
+        // the translation unit stays loaded until it is saved and hibernated, 
+        // a suspended translation unit cannot be saved
+        data.state = TranslationUnit::Loaded;
+        schedule_hibernation = true;
+      }
+      else
+      {
+        clark::telemetry::ScopedSpan span{ clark::telemetry::Category::Suspend, tu->filePath().toStdString() };
+        data.clang_translation_unit->suspendTranslationUnit();
+        state_changed = true;
+      }
     }
 
     lock.unlock();
+    access.unlock();
 
-    if (unloaded)
+    if (state_changed)
       Q_EMIT tu->stateChanged();
+
+    if (state_changed || schedule_hibernation)
+      scheduleHibernation(tu);
+  }
+
+  m_translation_units_to_unload = std::move(busy);
+
+  if (!m_translation_units_to_unload.empty())
+    m_busy_timer->start(BusyRetryDelay);
+}
+
+void ClangIndex::reparseTranslationUnits()
+{
+  std::vector<TranslationUnit*> pending;
+
+  for (TranslationUnit* tu : m_translation_units_to_reparse)
+  {
+    TranslationUnit::State s = tu->state();
+
+    if (s == TranslationUnit::Parsing || (tu->flags() & TranslationUnit::Reparsing))
+    {
+      // retry once the current parse is over
+      pending.push_back(tu);
+    }
+    else if (s == TranslationUnit::Loaded)
+    {
+      connect(tu, &TranslationUnit::reparsed, this, &ClangIndex::onTranslationUnitReparsed, Qt::UniqueConnection);
+      tu->setFlag(TranslationUnit::Reparsing);
+      startTask(loaderFactory().createLoader(*this, *tu), 1);
+    }
+  }
+
+  m_translation_units_to_reparse = std::move(pending);
+
+  if (!m_translation_units_to_reparse.empty())
+    m_reparse_timer->start(reparseDelay());
+}
+
+/**
+ * \brief replaces the clang translation unit by the result of a full parse or reparse
+ * \param tu  the translation unit
+ * 
+ * Background tasks hold the access mutex of the translation unit while they 
+ * use its clang translation unit, handles only use it in this thread; so 
+ * the swap happens here, once no task is running on the translation unit.
+ * Returns false if the translation unit is busy, in which case the swap 
+ * must be retried later.
+ * 
+ * The replaced clang translation unit is kept as the spare of the next 
+ * reparse if it can be reparsed.
+ */
+bool ClangIndex::installFullParse(TranslationUnit* tu)
+{
+  std::unique_lock<std::shared_mutex> access{ tu->accessMutex(), std::try_to_lock };
+
+  if (!access.owns_lock())
+    return false;
+
+  TranslationUnit::Data& data = tu->data();
+  std::unique_ptr<libclang::TranslationUnit> previous;
+  TranslationUnit::State state;
+  bool installed = false;
+
+  {
+    std::lock_guard<std::mutex> lock{ tu->mutex() };
+
+    state = data.state;
+
+    // the translation unit is being saved, restored or reparsed in place
+    if (state == TranslationUnit::Parsing && data.full_clang_translation_unit)
+      return false;
+
+    if (data.full_clang_translation_unit && (state == TranslationUnit::Loaded || state == TranslationUnit::Suspended))
+    {
+      bool reparseable = !(data.flags & (TranslationUnit::Skeleton | TranslationUnit::FromAstFile));
+
+      previous = std::move(data.clang_translation_unit);
+      data.clang_translation_unit = std::move(data.full_clang_translation_unit);
+      data.flags &= ~(TranslationUnit::Skeleton | TranslationUnit::FullParseScheduled | TranslationUnit::FromAstFile);
+      data.generation.fetch_add(1);
+
+      if (state == TranslationUnit::Suspended)
+      {
+        data.clang_translation_unit->suspendTranslationUnit();
+        data.released_at = std::chrono::steady_clock::now();
+      }
+      else if (reparseable && precompiledPreamble())
+      {
+        data.spare_clang_translation_unit = std::move(previous);
+      }
+
+      installed = true;
+    }
+    else
+    {
+      data.full_clang_translation_unit.reset();
+    }
+
+    data.flags &= ~TranslationUnit::Reparsing;
+  }
+
+  access.unlock();
+
+  if (installed)
+  {
+    discardAstFile(*tu);
+
+    if (state == TranslationUnit::Loaded)
+      Q_EMIT tu->reparsed();
+  }
+
+  return true;
+}
+
+void ClangIndex::retryBusyTranslationUnits()
+{
+  std::vector<TranslationUnit*> list = std::move(m_translation_units_to_install);
+  m_translation_units_to_install.clear();
+
+  for (TranslationUnit* tu : list)
+  {
+    if (!installFullParse(tu))
+      m_translation_units_to_install.push_back(tu);
   }
 
-  m_translation_units_to_unload.clear();
+  if (!m_translation_units_to_unload.empty())
+    unloadTranslationUnits();
+
+  if (!m_translation_units_to_install.empty())
+    m_busy_timer->start(BusyRetryDelay);
+}
+
+/**
+ * \brief returns whether a translation unit is saved to disk when it is hibernated
+ * 
+ * Only translation units that were opened with a handle are saved; those 
+ * that were only parsed in the background are suspended and kept in memory, 
+ * saving them would cost more than parsing them again.
+ */
+bool ClangIndex::isHibernationCandidate(const TranslationUnit& tu) const
+{
+  if (hibernationDelay() < 0)
+    return false;
+
+  const int flags = tu.flags();
+  return (flags & TranslationUnit::WasUsed) && !(flags & (TranslationUnit::Skeleton | TranslationUnit::HasAstFile | TranslationUnit::FromAstFile));
+}
+
+void ClangIndex::scheduleHibernation(TranslationUnit* tu)
+{
+  if (hibernationDelay() < 0)
+    return;
+
+  if (std::find(m_translation_units_to_hibernate.begin(), m_translation_units_to_hibernate.end(), tu) == m_translation_units_to_hibernate.end())
+    m_translation_units_to_hibernate.push_back(tu);
+
+  if (!m_hibernation_timer->isActive())
+    m_hibernation_timer->start(std::max(hibernationDelay() / 4, 1000));
+}
+
+void ClangIndex::hibernateTranslationUnits()
+{
+  auto now = std::chrono::steady_clock::now();
+
+  auto it = std::remove_if(m_translation_units_to_hibernate.begin(), m_translation_units_to_hibernate.end(), [this, now](TranslationUnit* tu) -> bool {
+    TranslationUnit::Data& data = tu->data();
+
+    // a background task may still be using the clang translation unit
+    std::unique_lock<std::shared_mutex> access{ tu->accessMutex(), std::try_to_lock };
+
+    if (!access.owns_lock())
+      return false;
+
+    std::unique_lock lock{ tu->mutex() };
+
+    // the translation unit is used again, it is scheduled again when it is released
+    if (data.use_count != 0)
+      return true;
+
+    const bool suspended = data.state == TranslationUnit::Suspended && (data.flags & TranslationUnit::HasAstFile);
+    const bool released = data.state == TranslationUnit::Loaded && isHibernationCandidate(*tu);
+
+    if (!suspended && !released)
+      return true;
+
+    if (now - data.released_at < std::chrono::milliseconds(hibernationDelay()))
+      return false;
+
+    if (released)
+    {
+      // claimed like in unloadTranslationUnits(), the AST is saved in the background
+      TranslationUnit::State expected = TranslationUnit::Loaded;
+
+      if (!data.state.compare_exchange_strong(expected, TranslationUnit::Parsing))
+        return true;
+
+      if (data.use_count != 0)
+      {
+        data.state = TranslationUnit::Loaded;
+        return true;
+      }
+
+      startTask(new SaveTranslationUnit(*this, *tu), -1);
+      return true;
+    }
+
+    data.clang_translation_unit.reset();
+    data.state = TranslationUnit::Hibernated;
+
+    lock.unlock();
+
+    Q_EMIT tu->stateChanged();
+
+    return true;
+    });
+
+  m_translation_units_to_hibernate.erase(it, m_translation_units_to_hibernate.end());
+
+  if (m_translation_units_to_hibernate.empty())
+    m_hibernation_timer->stop();
 }
 
 void ClangIndex::onTranslationUnitParsed()
@@ -286,6 +1634,9 @@ void ClangIndex::onTranslationUnitParsed()
 
   Q_EMIT translationUnitLoaded(tu);
 
+  if (tu->flags() & TranslationUnit::Skeleton)
+    scheduleFullParsing(tu);
+
   checkUsed(tu);
 }
 
@@ -298,3 +1649,31 @@ void ClangIndex::onTranslationUnitUsedChanged()
 
   checkUsed(tu);
 }
+
+void ClangIndex::onTranslationUnitReparsed()
+{
+  auto* tu = qobject_cast<TranslationUnit*>(sender());
+
+  if (!tu)
+    return;
+
+  Q_EMIT translationUnitReparsed(tu);
+}
+
+void ClangIndex::onTranslationUnitFullParseReady()
+{
+  auto* tu = qobject_cast<TranslationUnit*>(sender());
+
+  if (!tu)
+    return;
+
+  m_check_parsing.scheduleCall();
+
+  if (!installFullParse(tu))
+  {
+    if (std::find(m_translation_units_to_install.begin(), m_translation_units_to_install.end(), tu) == m_translation_units_to_install.end())
+      m_translation_units_to_install.push_back(tu);
+
+    m_busy_timer->start(BusyRetryDelay);
+  }
+}
@@ -13,14 +13,22 @@
 
 #include <QObject>
 
+#include <atomic>
 #include <list>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <set>
+#include <string>
 
 class LibClang;
+class PrecompiledHeaders;
+class PrefetchPolicy;
 class Project;
 
+class Executor;
 class QRunnable;
-class QThreadPool;
+class QTimer;
 
 class ClangIndex;
 
@@ -30,6 +38,8 @@ public:
   virtual ~TranslationUnitLoaderFactory();
 
   virtual QRunnable* createLoader(ClangIndex& index, TranslationUnit& t);
+  virtual QRunnable* createSkeletonLoader(ClangIndex& index, TranslationUnit& t);
+  virtual QRunnable* createFullParser(ClangIndex& index, TranslationUnit& t);
 };
 
 class ClangIndex : public QObject
@@ -41,6 +51,7 @@ public:
 
   libclang::Index& libclangIndex() const;
 
+  void addTranslationUnits(const std::vector<TranslationUnit*>& list);
   void addTranslationUnits(const std::vector<TranslationUnit*>& list, const program::CompileOptions& options);
 
   const std::vector<TranslationUnit*>& translationUnits() const;
@@ -48,38 +59,123 @@ public:
 
   void load(TranslationUnit* tu);
 
+  bool skeletonParsing() const;
+  void setSkeletonParsing(bool on = true);
+
+  bool backgroundParsing() const;
+  void setBackgroundParsing(bool on = true);
+
+  PrecompiledHeaders* precompiledHeaders() const;
+  void setPrecompiledHeaders(std::unique_ptr<PrecompiledHeaders> pchs);
+
+  bool adaptiveConcurrency() const;
+  void setAdaptiveConcurrency(bool on = true);
+  int parsingConcurrency() const;
+  size_t parseMemoryEstimate(bool skeleton = false) const;
+  void recordParseMemoryUsage(const libclang::TranslationUnit& tu, bool skeleton);
+  static size_t memoryUsage(const libclang::TranslationUnit& tu);
+
+  bool precompiledPreamble() const;
+  void setPrecompiledPreamble(bool on = true);
+
+  void setUnsavedFile(const QString& path, const QByteArray& content);
+  void removeUnsavedFile(const QString& path);
+  std::map<std::string, std::string> unsavedFiles() const;
+
+  int reparseDelay() const;
+  void setReparseDelay(int msecs);
+  void notifyFileChanged(const QString& path);
+  void scheduleReparse(TranslationUnit* tu);
+
+  int hibernationDelay() const;
+  void setHibernationDelay(int msecs);
+  QString astFilePath(const TranslationUnit& tu) const;
+  void discardAstFile(TranslationUnit& tu);
+
+  PrefetchPolicy* prefetchPolicy() const;
+  void setPrefetchPolicy(std::unique_ptr<PrefetchPolicy> policy);
+  int prefetchCount() const;
+  void setPrefetchCount(int n);
+  void prefetch(TranslationUnit* tu);
+  void cancelPrefetching();
+
   TranslationUnitLoaderFactory& loaderFactory() const;
   void setLoaderFactory(std::unique_ptr<TranslationUnitLoaderFactory> factory);
 
 Q_SIGNALS:
   void translationUnitsAdded(int n);
   void translationUnitLoaded(TranslationUnit* tu);
+  void translationUnitReparsed(TranslationUnit* tu);
 
 protected:
   void addToList(TranslationUnit* tu);
   void manage(TranslationUnit* tu);
   void scheduleParsing(TranslationUnit* tu);
   Q_INVOKABLE void checkParsing();
+  void startTask(QRunnable* task, int priority = 0);
   void parse(std::list<TranslationUnit*>::iterator it);
   void parse(TranslationUnit* tu);
+  void parseSkeleton(TranslationUnit* tu);
+  void scheduleFullParsing(TranslationUnit* tu);
+  Q_INVOKABLE void schedulePrefetching();
+  void cancelPendingPrefetches();
   void checkUsed(TranslationUnit* tu);
   Q_INVOKABLE void unloadTranslationUnits();
+  Q_INVOKABLE void reparseTranslationUnits();
+  bool isHibernationCandidate(const TranslationUnit& tu) const;
+  void scheduleHibernation(TranslationUnit* tu);
+  Q_INVOKABLE void hibernateTranslationUnits();
+  bool installFullParse(TranslationUnit* tu);
+  Q_INVOKABLE void retryBusyTranslationUnits();
+
+public:
+  struct TaskGroup;
 
 private Q_SLOTS:
   void onTranslationUnitParsed();
   void onTranslationUnitUsedChanged();
+  void onTranslationUnitFullParseReady();
+  void onTranslationUnitReparsed();
 
 private:
   LibClang& m_library;
   std::unique_ptr<libclang::Index> m_index;
   std::unique_ptr<TranslationUnitLoaderFactory> m_loader_factory;
-  QThreadPool* m_thread_pool = nullptr;
+  std::unique_ptr<PrecompiledHeaders> m_precompiled_headers;
+  Executor* m_executor = nullptr;
   std::vector<TranslationUnit*> m_translation_units;
   std::mutex m_mutex;
   std::list<TranslationUnit*> m_translation_unit_parsing_queue;
+  std::list<TranslationUnit*> m_translation_unit_full_parsing_queue;
+  bool m_skeleton_parsing = true;
+  bool m_background_parsing = true;
+  bool m_adaptive_concurrency = true;
+  std::atomic<size_t> m_parse_memory_estimate{ 0 };
+  std::atomic<size_t> m_skeleton_parse_memory_estimate{ 0 };
+  std::unique_ptr<PrefetchPolicy> m_prefetch_policy;
+  int m_prefetch_count = 4;
+  TranslationUnit* m_prefetch_origin = nullptr;
+  std::list<TranslationUnit*> m_translation_unit_prefetch_queue;
+  std::vector<TranslationUnit*> m_prefetched_translation_units;
+  std::atomic<int> m_prefetch_generation{ 0 };
   QMethod m_check_parsing;
+  QMethod m_schedule_prefetching;
   std::vector<TranslationUnit*> m_translation_units_to_unload;
   QMethod m_unload_translation_units;
+  bool m_precompiled_preamble = true;
+  mutable std::mutex m_unsaved_files_mutex;
+  std::map<std::string, std::string> m_unsaved_files;
+  std::set<TranslationUnit*> m_loaded_translation_units;
+  int m_reparse_delay = 300;
+  QTimer* m_reparse_timer = nullptr;
+  std::vector<TranslationUnit*> m_translation_units_to_reparse;
+  int m_hibernation_delay = 5 * 60 * 1000;
+  QTimer* m_hibernation_timer = nullptr;
+  std::vector<TranslationUnit*> m_translation_units_to_hibernate;
+  static constexpr int BusyRetryDelay = 20;
+  QTimer* m_busy_timer = nullptr;
+  std::vector<TranslationUnit*> m_translation_units_to_install;
+  std::shared_ptr<TaskGroup> m_tasks;
 };
 
 #endif // CLARK_CLANGINDEX_H
@@ -0,0 +1,608 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "compilationdatabase.h"
+
+#include "translationunit.h"
+
+#include <QThread>
+
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_set>
+
+namespace program
+{
+
+namespace
+{
+
+/**
+ * \brief a minimal pull parser for JSON reading from a stream by chunks
+ */
+class JsonReader
+{
+public:
+  explicit JsonReader(std::istream& stream) :
+    m_stream(stream)
+  {
+    m_buffer.resize(64 * 1024);
+  }
+
+  int peek()
+  {
+    if (m_pos == m_end && !fill())
+      return EOF;
+
+    return static_cast<unsigned char>(m_buffer[m_pos]);
+  }
+
+  int get()
+  {
+    int c = peek();
+
+    if (c != EOF)
+      ++m_pos;
+
+    return c;
+  }
+
+  void skipSpaces()
+  {
+    for (;;)
+    {
+      int c = peek();
+
+      if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+        ++m_pos;
+      else
+        break;
+    }
+  }
+
+  void expect(char c)
+  {
+    skipSpaces();
+
+    if (get() != c)
+      throw std::runtime_error(std::string("invalid compilation database: expected '") + c + "'");
+  }
+
+  bool tryConsume(char c)
+  {
+    skipSpaces();
+
+    if (peek() != c)
+      return false;
+
+    ++m_pos;
+    return true;
+  }
+
+  void readString(std::string& out)
+  {
+    expect('"');
+    out.clear();
+
+    for (;;)
+    {
+      if (m_pos == m_end && !fill())
+        throw std::runtime_error("invalid compilation database: unterminated string");
+
+      // copy runs of regular characters at once
+      size_t start = m_pos;
+
+      while (m_pos < m_end && m_buffer[m_pos] != '"' && m_buffer[m_pos] != '\\')
+        ++m_pos;
+
+      out.append(m_buffer.data() + start, m_pos - start);
+
+      if (m_pos == m_end)
+        continue;
+
+      if (m_buffer[m_pos++] == '"')
+        return;
+
+      readEscapeSequence(out);
+    }
+  }
+
+  void skipValue()
+  {
+    skipSpaces();
+
+    int c = peek();
+
+    if (c == '"')
+    {
+      readString(m_scratch);
+    }
+    else if (c == '{')
+    {
+      ++m_pos;
+
+      if (tryConsume('}'))
+        return;
+
+      do
+      {
+        readString(m_scratch);
+        expect(':');
+        skipValue();
+      } while (tryConsume(','));
+
+      expect('}');
+    }
+    else if (c == '[')
+    {
+      ++m_pos;
+
+      if (tryConsume(']'))
+        return;
+
+      do
+      {
+        skipValue();
+      } while (tryConsume(','));
+
+      expect(']');
+    }
+    else
+    {
+      // numbers, true, false, null
+      while ((c = peek()) != EOF && (std::isalnum(c) || c == '-' || c == '+' || c == '.'))
+        ++m_pos;
+    }
+  }
+
+private:
+  bool fill()
+  {
+    m_stream.read(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+    m_pos = 0;
+    m_end = static_cast<size_t>(m_stream.gcount());
+    return m_end > 0;
+  }
+
+  unsigned readHex4()
+  {
+    unsigned value = 0;
+
+    for (int i(0); i < 4; ++i)
+    {
+      int c = get();
+      value <<= 4;
+
+      if (c >= '0' && c <= '9')
+        value |= c - '0';
+      else if (c >= 'a' && c <= 'f')
+        value |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+        value |= c - 'A' + 10;
+      else
+        throw std::runtime_error("invalid compilation database: bad unicode escape");
+    }
+
+    return value;
+  }
+
+  void readEscapeSequence(std::string& out)
+  {
+    int c = get();
+
+    switch (c)
+    {
+    case '"':
+    case '\\':
+    case '/':
+      out.push_back(static_cast<char>(c));
+      break;
+    case 'b':
+      out.push_back('\b');
+      break;
+    case 'f':
+      out.push_back('\f');
+      break;
+    case 'n':
+      out.push_back('\n');
+      break;
+    case 'r':
+      out.push_back('\r');
+      break;
+    case 't':
+      out.push_back('\t');
+      break;
+    case 'u':
+    {
+      unsigned cp = readHex4();
+
+      if (cp >= 0xD800 && cp <= 0xDBFF && get() == '\\' && get() == 'u')
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (readHex4() - 0xDC00);
+
+      appendUtf8(out, cp);
+    }
+    break;
+    default:
+      throw std::runtime_error("invalid compilation database: bad escape sequence");
+    }
+  }
+
+  static void appendUtf8(std::string& out, unsigned cp)
+  {
+    if (cp < 0x80)
+    {
+      out.push_back(static_cast<char>(cp));
+    }
+    else if (cp < 0x800)
+    {
+      out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+      out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+    else if (cp < 0x10000)
+    {
+      out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+    else
+    {
+      out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+      out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+  }
+
+private:
+  std::istream& m_stream;
+  std::vector<char> m_buffer;
+  size_t m_pos = 0;
+  size_t m_end = 0;
+  std::string m_scratch;
+};
+
+bool starts_with(const std::string& str, const char* prefix)
+{
+  return str.rfind(prefix, 0) == 0;
+}
+
+bool is_msvc_driver(const std::vector<std::string>& args)
+{
+  if (args.empty())
+    return false;
+
+  std::string name = std::filesystem::u8path(args.front()).stem().u8string();
+  return name == "cl" || name == "clang-cl";
+}
+
+std::string make_absolute(const std::string& directory, const std::string& path)
+{
+  std::filesystem::path p = std::filesystem::u8path(path);
+
+  if (p.is_absolute() || directory.empty())
+    return p.lexically_normal().generic_u8string();
+
+  return (std::filesystem::u8path(directory) / p).lexically_normal().generic_u8string();
+}
+
+} // namespace
+
+/**
+ * \brief reads a JSON compilation database
+ * \param stream    the input stream
+ * \param callback  a function called for each entry of the database
+ * 
+ * Throws std::runtime_error if the input is not a valid compilation database.
+ * The CompileCommand passed to the callback is reused between calls.
+ */
+void read_compilation_database(std::istream& stream, const std::function<void(CompileCommand&)>& callback)
+{
+  JsonReader reader{ stream };
+
+  reader.expect('[');
+
+  if (reader.tryConsume(']'))
+    return;
+
+  CompileCommand cmd;
+  std::string key;
+  std::string command;
+
+  do
+  {
+    cmd.directory.clear();
+    cmd.file.clear();
+    cmd.arguments.clear();
+    command.clear();
+
+    reader.expect('{');
+
+    if (!reader.tryConsume('}'))
+    {
+      do
+      {
+        reader.readString(key);
+        reader.expect(':');
+
+        if (key == "directory")
+        {
+          reader.readString(cmd.directory);
+        }
+        else if (key == "file")
+        {
+          reader.readString(cmd.file);
+        }
+        else if (key == "command")
+        {
+          reader.readString(command);
+        }
+        else if (key == "arguments")
+        {
+          reader.expect('[');
+
+          if (!reader.tryConsume(']'))
+          {
+            do
+            {
+              cmd.arguments.emplace_back();
+              reader.readString(cmd.arguments.back());
+            } while (reader.tryConsume(','));
+
+            reader.expect(']');
+          }
+        }
+        else
+        {
+          reader.skipValue();
+        }
+      } while (reader.tryConsume(','));
+
+      reader.expect('}');
+    }
+
+    if (cmd.arguments.empty() && !command.empty())
+      cmd.arguments = split_command_line(command);
+
+    callback(cmd);
+
+  } while (reader.tryConsume(','));
+
+  reader.expect(']');
+}
+
+/**
+ * \brief splits a command line into arguments
+ * 
+ * Follows the rules of a POSIX shell for quotes and backslashes.
+ */
+std::vector<std::string> split_command_line(const std::string& command)
+{
+  std::vector<std::string> result;
+  std::string current;
+  bool in_arg = false;
+
+  for (size_t i(0); i < command.size(); ++i)
+  {
+    char c = command[i];
+
+    if (c == ' ' || c == '\t' || c == '\n')
+    {
+      if (in_arg)
+      {
+        result.push_back(std::move(current));
+        current.clear();
+        in_arg = false;
+      }
+    }
+    else if (c == '\'')
+    {
+      in_arg = true;
+      size_t end = command.find('\'', i + 1);
+      end = end == std::string::npos ? command.size() : end;
+      current.append(command, i + 1, end - i - 1);
+      i = end;
+    }
+    else if (c == '"')
+    {
+      in_arg = true;
+
+      for (++i; i < command.size() && command[i] != '"'; ++i)
+      {
+        if (command[i] == '\\' && i + 1 < command.size() && (command[i + 1] == '"' || command[i + 1] == '\\'))
+          ++i;
+
+        current.push_back(command[i]);
+      }
+    }
+    else if (c == '\\' && i + 1 < command.size())
+    {
+      in_arg = true;
+      current.push_back(command[++i]);
+    }
+    else
+    {
+      in_arg = true;
+      current.push_back(c);
+    }
+  }
+
+  if (in_arg)
+    result.push_back(std::move(current));
+
+  return result;
+}
+
+CompilationDatabaseLoader::CompilationDatabaseLoader()
+{
+
+}
+
+CompilationDatabaseLoader::~CompilationDatabaseLoader()
+{
+
+}
+
+/**
+ * \brief sets the thread the created translation units are moved to
+ * 
+ * This must be set when loading from a worker thread, as translation units 
+ * are QObjects.
+ */
+void CompilationDatabaseLoader::setTargetThread(QThread* thread)
+{
+  m_target_thread = thread;
+}
+
+/**
+ * \brief loads the translation units of a compilation database
+ * \param path  the path of the compile_commands.json file
+ * 
+ * The caller takes ownership of the translation units.
+ * Files that appear several times in the database only produce one 
+ * translation unit, using the first command.
+ */
+std::vector<TranslationUnit*> CompilationDatabaseLoader::load(const std::string& path)
+{
+  std::ifstream file{ std::filesystem::u8path(path), std::ios::binary };
+
+  if (!file.is_open())
+    throw std::runtime_error("could not open compilation database");
+
+  return load(file);
+}
+
+std::vector<TranslationUnit*> CompilationDatabaseLoader::load(std::istream& stream)
+{
+  std::vector<TranslationUnit*> result;
+  std::unordered_set<std::string> files;
+
+  try
+  {
+    read_compilation_database(stream, [&](CompileCommand& cmd) {
+      std::string filepath = make_absolute(cmd.directory, cmd.file);
+
+      if (cmd.file.empty() || !files.insert(filepath).second)
+        return;
+
+      auto* tu = new TranslationUnit(QString::fromStdString(filepath));
+      tu->setCompileOptions(compileOptions(cmd));
+
+      if (m_target_thread)
+        tu->moveToThread(m_target_thread);
+
+      result.push_back(tu);
+      });
+  }
+  catch (...)
+  {
+    for (TranslationUnit* tu : result)
+      delete tu;
+
+    throw;
+  }
+
+  return result;
+}
+
+/**
+ * \brief returns the interned compile options of a command
+ * 
+ * Only the flags relevant to clark (include directories and macro 
+ * definitions) are considered; commands that only differ by other 
+ * flags or by their input and output files share the same options.
+ */
+std::shared_ptr<const CompileOptions> CompilationDatabaseLoader::compileOptions(const CompileCommand& command)
+{
+  struct Flag
+  {
+    char kind; // 'I', 'D' or 'U'
+    std::string_view value;
+  };
+
+  std::vector<Flag> flags;
+  const std::vector<std::string>& args = command.arguments;
+  const bool msvc = is_msvc_driver(args);
+  bool relative_paths = false;
+
+  for (size_t i(1); i < args.size(); ++i)
+  {
+    const std::string& a = args.at(i);
+
+    auto take = [&](size_t prefixlen, char kind) {
+      if (a.size() > prefixlen)
+        flags.push_back(Flag{ kind, std::string_view(a).substr(prefixlen) });
+      else if (i + 1 < args.size())
+        flags.push_back(Flag{ kind, std::string_view(args.at(++i)) });
+      else
+        return;
+
+      if (kind == 'I' && !std::filesystem::u8path(flags.back().value).is_absolute())
+        relative_paths = true;
+    };
+
+    if (a.size() < 2 || (a.front() != '-' && !(msvc && a.front() == '/')))
+      continue;
+
+    if (starts_with(a, "-isystem"))
+      take(8, 'I');
+    else if (starts_with(a, "-iquote"))
+      take(7, 'I');
+    else if (starts_with(a, "-idirafter"))
+      take(10, 'I');
+    else if (a[1] == 'I')
+      take(2, 'I');
+    else if (a[1] == 'D')
+      take(2, 'D');
+    else if (a[1] == 'U')
+      take(2, 'U');
+  }
+
+  // relative include directories depend on the working directory
+  std::string key = relative_paths ? command.directory : std::string();
+
+  for (const Flag& f : flags)
+  {
+    key.push_back('\n');
+    key.push_back(f.kind);
+    key.append(f.value);
+  }
+
+  auto it = m_options_cache.find(key);
+
+  if (it != m_options_cache.end())
+    return it->second;
+
+  CompileOptions opts;
+
+  for (const Flag& f : flags)
+  {
+    if (f.kind == 'I')
+    {
+      opts.includedirs.insert(make_absolute(command.directory, std::string(f.value)));
+    }
+    else if (f.kind == 'D')
+    {
+      size_t p = f.value.find('=');
+
+      if (p != std::string_view::npos)
+        opts.defines[std::string(f.value.substr(0, p))] = std::string(f.value.substr(p + 1));
+      else
+        opts.defines[std::string(f.value)] = "";
+    }
+    else
+    {
+      opts.defines.erase(std::string(f.value));
+    }
+  }
+
+  auto result = intern(std::move(opts));
+  m_options_cache.emplace(std::move(key), result);
+  return result;
+}
+
+} // namespace program
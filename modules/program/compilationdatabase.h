@@ -0,0 +1,67 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_COMPILATIONDATABASE_H
+#define CLARK_COMPILATIONDATABASE_H
+
+#include "compileoptions.h"
+
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class QThread;
+
+class TranslationUnit;
+
+namespace program
+{
+
+/**
+ * \brief an entry of a JSON compilation database (compile_commands.json)
+ */
+struct CompileCommand
+{
+  std::string directory;
+  std::string file;
+  std::vector<std::string> arguments; // from either "arguments" or "command"
+};
+
+void read_compilation_database(std::istream& stream, const std::function<void(CompileCommand&)>& callback);
+
+std::vector<std::string> split_command_line(const std::string& command);
+
+/**
+ * \brief creates translation units from a JSON compilation database
+ * 
+ * Entries are processed as they are read, without building a document 
+ * of the whole file in memory.
+ * Compile options are interned so that translation units compiled with 
+ * the same flags share one options object; the flags relevant to clark 
+ * are extracted once per distinct command line.
+ */
+class CompilationDatabaseLoader
+{
+public:
+  CompilationDatabaseLoader();
+  ~CompilationDatabaseLoader();
+
+  void setTargetThread(QThread* thread);
+
+  std::vector<TranslationUnit*> load(const std::string& path);
+  std::vector<TranslationUnit*> load(std::istream& stream);
+
+  std::shared_ptr<const CompileOptions> compileOptions(const CompileCommand& command);
+
+private:
+  QThread* m_target_thread = nullptr;
+  std::unordered_map<std::string, std::shared_ptr<const CompileOptions>> m_options_cache;
+};
+
+} // namespace program
+
+#endif // CLARK_COMPILATIONDATABASE_H
@@ -0,0 +1,167 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "compileoptions.h"
+
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace program
+{
+
+bool operator==(const CompileOptions& lhs, const CompileOptions& rhs)
+{
+  return lhs.includedirs == rhs.includedirs && lhs.defines == rhs.defines;
+}
+
+bool operator!=(const CompileOptions& lhs, const CompileOptions& rhs)
+{
+  return !(lhs == rhs);
+}
+
+static void hash_combine(size_t& seed, const std::string& str)
+{
+  seed ^= std::hash<std::string>()(str) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+/**
+ * \brief computes a hash of the content of compile options
+ * 
+ * This function is linear in the size of the options; interned options 
+ * can instead be hashed and compared by address.
+ */
+size_t hash(const CompileOptions& opts)
+{
+  size_t seed = opts.includedirs.size() * 31 + opts.defines.size();
+
+  for (const std::string& dir : opts.includedirs)
+    hash_combine(seed, dir);
+
+  for (const auto& def : opts.defines)
+  {
+    hash_combine(seed, def.first);
+    hash_combine(seed, def.second);
+  }
+
+  return seed;
+}
+
+namespace
+{
+
+struct InternTable
+{
+  std::mutex mutex;
+  std::unordered_multimap<size_t, const CompileOptions*> by_hash;
+  std::unordered_map<const CompileOptions*, std::pair<size_t, std::weak_ptr<const CompileOptions>>> by_address;
+};
+
+InternTable& intern_table()
+{
+  // never destroyed: interned options may outlive static storage
+  static InternTable* table = new InternTable;
+  return *table;
+}
+
+void release(const CompileOptions* opts)
+{
+  InternTable& table = intern_table();
+
+  {
+    std::lock_guard<std::mutex> lock{ table.mutex };
+
+    auto it = table.by_address.find(opts);
+
+    if (it != table.by_address.end())
+    {
+      auto range = table.by_hash.equal_range(it->second.first);
+
+      for (auto hit = range.first; hit != range.second; ++hit)
+      {
+        if (hit->second == opts)
+        {
+          table.by_hash.erase(hit);
+          break;
+        }
+      }
+
+      table.by_address.erase(it);
+    }
+  }
+
+  delete opts;
+}
+
+} // namespace
+
+/**
+ * \brief returns a shared compile options object equal to the given options
+ * \param opts  the options
+ * 
+ * Equal options share the same object for as long as one of them is 
+ * alive, so that interned options can be compared and used as cache keys 
+ * by address (e.g., by PrecompiledHeaders).
+ */
+std::shared_ptr<const CompileOptions> intern(CompileOptions opts)
+{
+  const size_t h = hash(opts);
+
+  // candidates may become the last owner of their options, they must 
+  // be released after the mutex is unlocked
+  std::vector<std::shared_ptr<const CompileOptions>> candidates;
+
+  InternTable& table = intern_table();
+  std::lock_guard<std::mutex> lock{ table.mutex };
+
+  auto range = table.by_hash.equal_range(h);
+
+  for (auto it = range.first; it != range.second; ++it)
+  {
+    candidates.push_back(table.by_address[it->second].second.lock());
+
+    if (candidates.back() && *candidates.back() == opts)
+      return candidates.back();
+  }
+
+  std::shared_ptr<const CompileOptions> result{ new CompileOptions(std::move(opts)), &release };
+  table.by_hash.emplace(h, result.get());
+  table.by_address[result.get()] = std::make_pair(h, std::weak_ptr<const CompileOptions>(result));
+
+  return result;
+}
+
+/**
+ * \brief interns shared compile options
+ * 
+ * This is a constant-time operation if the options are already interned.
+ */
+std::shared_ptr<const CompileOptions> intern(const std::shared_ptr<const CompileOptions>& opts)
+{
+  if (!opts)
+    return intern(CompileOptions());
+
+  {
+    InternTable& table = intern_table();
+    std::lock_guard<std::mutex> lock{ table.mutex };
+
+    if (table.by_address.find(opts.get()) != table.by_address.end())
+      return opts;
+  }
+
+  return intern(*opts);
+}
+
+/**
+ * \brief returns the number of distinct compile options currently interned
+ */
+size_t interned_count()
+{
+  InternTable& table = intern_table();
+  std::lock_guard<std::mutex> lock{ table.mutex };
+  return table.by_address.size();
+}
+
+} // namespace program
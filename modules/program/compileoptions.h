@@ -0,0 +1,47 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_COMPILEOPTIONS_H
+#define CLARK_COMPILEOPTIONS_H
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+namespace program
+{
+
+/**
+ * \brief stores various information about the compiler flags required to compile a translation unit
+ */
+struct CompileOptions
+{
+  /**
+   * \brief lists the include directories used when compiling the translation unit
+   */
+  std::set<std::string> includedirs;
+
+  /**
+   * \brief lists the preprocessor defines used when compiling
+   * 
+   * The key is the name of the define/macro.
+   * The value is the define's value and can be an empty string.
+   */
+  std::map<std::string, std::string> defines;
+};
+
+bool operator==(const CompileOptions& lhs, const CompileOptions& rhs);
+bool operator!=(const CompileOptions& lhs, const CompileOptions& rhs);
+
+size_t hash(const CompileOptions& opts);
+
+std::shared_ptr<const CompileOptions> intern(CompileOptions opts);
+std::shared_ptr<const CompileOptions> intern(const std::shared_ptr<const CompileOptions>& opts);
+size_t interned_count();
+
+} // namespace program
+
+#endif // CLARK_COMPILEOPTIONS_H
@@ -0,0 +1,353 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "precompiledheaders.h"
+
+#include <libclang-utils/clang-index.h>
+#include <libclang-utils/clang-translation-unit.h>
+#include <libclang-utils/index-action.h>
+
+#include <QCryptographicHash>
+#include <QDir>
+
+#include <QDebug>
+
+#include <filesystem>
+#include <fstream>
+
+/**
+ * \brief constructs a cache of precompiled headers
+ * \param directory  the directory in which the precompiled headers are written
+ */
+PrecompiledHeaders::PrecompiledHeaders(const QString& directory) :
+  m_directory(directory)
+{
+
+}
+
+/**
+ * \brief destroys the cache and removes the files of its precompiled headers
+ * 
+ * No translation unit may be parsed while the cache is destroyed.
+ */
+PrecompiledHeaders::~PrecompiledHeaders()
+{
+  for (const auto& p : m_entries)
+    remove(p.second.pch);
+}
+
+const QString& PrecompiledHeaders::directory() const
+{
+  return m_directory;
+}
+
+/**
+ * \brief returns the path of a precompiled header that can be used to parse a translation unit
+ * \param index  the libclang index used to build the precompiled header
+ * \param tu     the translation unit
+ * 
+ * Returns an empty string if no precompiled header should be used.
+ * If another thread is building the precompiled header, this function 
+ * waits for it to complete.
+ * An outdated precompiled header is built again (see isOutdated()).
+ */
+std::string PrecompiledHeaders::get(libclang::Index& index, const TranslationUnit& tu)
+{
+  if (!tu.sharedCompileOptions())
+    return {};
+
+  std::string header = findPrefixHeader(tu.filePath().toStdString(), tu.compileOptions());
+
+  if (header.empty())
+    return {};
+
+  const std::string name = key(header, tu.compileOptions());
+
+  std::unique_lock<std::mutex> lock{ m_mutex };
+
+  Entry& entry = m_entries[name];
+
+  if (!entry.options)
+    entry.options = tu.sharedCompileOptions();
+
+  entry.sources.insert(tu.filePath().toStdString());
+
+  // the header is not shared (yet)
+  if (entry.sources.size() < 2)
+    return {};
+
+  // a precompiled header that is being built is not checked, it may 
+  // already be outdated but is built from the latest files
+  if (entry.pch.valid() && entry.pch.wait_for(std::chrono::seconds(0)) == std::future_status::ready && isOutdated(entry))
+  {
+    // translation units parsed with the previous file keep it open
+    remove(entry.pch);
+    entry.pch = {};
+    entry.dependencies.clear();
+  }
+
+  if (entry.pch.valid())
+  {
+    std::shared_future<std::string> pch = entry.pch;
+    lock.unlock();
+    return pch.get();
+  }
+
+  std::promise<std::string> promise;
+  entry.pch = promise.get_future().share();
+  entry.builds += 1;
+
+  lock.unlock();
+
+  std::string result;
+  std::vector<Dependency> dependencies;
+
+  try
+  {
+    // the entry is not erased, and its options and builds count 
+    // only change while the promise is pending, i.e. in this thread
+    result = build(index, header, name, entry, dependencies);
+  }
+  catch (const std::exception& ex)
+  {
+    qDebug() << "Could not build precompiled header for" << header.c_str() << ":" << ex.what();
+  }
+
+  lock.lock();
+  entry.dependencies = std::move(dependencies);
+  lock.unlock();
+
+  promise.set_value(result);
+
+  return result;
+}
+
+/**
+ * \brief returns whether a file used to build a precompiled header was modified
+ * 
+ * A precompiled header whose build failed is never outdated, it is not 
+ * retried until one of its translation units is parsed in another session.
+ */
+bool PrecompiledHeaders::isOutdated(const Entry& entry)
+{
+  for (const Dependency& dep : entry.dependencies)
+  {
+    std::error_code ec;
+    std::filesystem::file_time_type time = std::filesystem::last_write_time(std::filesystem::u8path(dep.path), ec);
+
+    if (ec || time != dep.last_write_time)
+      return true;
+  }
+
+  return false;
+}
+
+/**
+ * \brief removes the file of a precompiled header that was built
+ */
+void PrecompiledHeaders::remove(const std::shared_future<std::string>& pch)
+{
+  if (!pch.valid() || pch.wait_for(std::chrono::seconds(0)) != std::future_status::ready || pch.get().empty())
+    return;
+
+  // may fail on Windows while a translation unit uses the file
+  std::error_code ec;
+  std::filesystem::remove(std::filesystem::u8path(pch.get()), ec);
+}
+
+/**
+ * \brief returns the name of the precompiled header of a prefix header
+ * 
+ * The name is a hash of the path of the header and of the contents 
+ * of the compile options, so that it is the same in every session and 
+ * for every options object with the same contents.
+ */
+std::string PrecompiledHeaders::key(const std::string& header, const program::CompileOptions& opts)
+{
+  QCryptographicHash hash{ QCryptographicHash::Sha1 };
+  hash.addData(header.data(), (int)header.size());
+
+  for (const std::string& dir : opts.includedirs)
+  {
+    hash.addData("\n-I", 3);
+    hash.addData(dir.data(), (int)dir.size());
+  }
+
+  for (const auto& def : opts.defines)
+  {
+    hash.addData("\n-D", 3);
+    hash.addData(def.first.data(), (int)def.first.size());
+    hash.addData("=", 1);
+    hash.addData(def.second.data(), (int)def.second.size());
+  }
+
+  return hash.result().toHex().toStdString();
+}
+
+static bool starts_with(const std::string& str, const char* prefix)
+{
+  return str.rfind(prefix, 0) == 0;
+}
+
+/**
+ * \brief returns the header included by the first directive of a source file
+ * \param source  the path of the source file
+ * \param opts    the compile options used to resolve the path of the header
+ * 
+ * Only comments and blank lines may precede the include directive.
+ * Returns an empty string if there is no such header.
+ */
+std::string PrecompiledHeaders::findPrefixHeader(const std::string& source, const program::CompileOptions& opts)
+{
+  std::ifstream file{ std::filesystem::u8path(source) };
+
+  if (!file.is_open())
+    return {};
+
+  std::string line;
+  bool in_comment = false;
+  std::string included;
+
+  while (std::getline(file, line))
+  {
+    size_t start = line.find_first_not_of(" \t\r");
+
+    if (start == std::string::npos)
+      continue;
+
+    line.erase(0, start);
+
+    if (in_comment)
+    {
+      size_t end = line.find("*/");
+
+      if (end == std::string::npos)
+        continue;
+
+      in_comment = false;
+      line.erase(0, end + 2);
+      start = line.find_first_not_of(" \t\r");
+
+      if (start == std::string::npos)
+        continue;
+
+      line.erase(0, start);
+    }
+
+    if (starts_with(line, "//"))
+      continue;
+
+    if (starts_with(line, "/*"))
+    {
+      in_comment = line.find("*/", 2) == std::string::npos;
+      continue;
+    }
+
+    if (line.front() != '#')
+      return {};
+
+    line.erase(0, line.find_first_not_of(" \t", 1));
+
+    if (!starts_with(line, "include"))
+      return {};
+
+    size_t begin = line.find('"');
+    size_t end = begin != std::string::npos ? line.find('"', begin + 1) : std::string::npos;
+
+    if (end == std::string::npos)
+      return {};
+
+    included = line.substr(begin + 1, end - begin - 1);
+    break;
+  }
+
+  if (included.empty())
+    return {};
+
+  std::filesystem::path candidate = std::filesystem::u8path(source).parent_path() / std::filesystem::u8path(included);
+
+  if (std::filesystem::exists(candidate))
+    return candidate.generic_u8string();
+
+  for (const std::string& dir : opts.includedirs)
+  {
+    candidate = std::filesystem::u8path(dir) / std::filesystem::u8path(included);
+
+    if (std::filesystem::exists(candidate))
+      return candidate.generic_u8string();
+  }
+
+  return {};
+}
+
+/**
+ * \brief lists the files included while building a precompiled header
+ */
+class PrecompiledHeaderIndexer : public libclang::BasicIndexer
+{
+public:
+  std::set<std::string> files;
+
+public:
+  PrecompiledHeaderIndexer(libclang::LibClang& api) : libclang::BasicIndexer(api)
+  {
+
+  }
+
+  void* ppIncludedFile(const CXIdxIncludedFileInfo* inclFile)
+  {
+    files.insert(libclangAPI().file(inclFile->file).getFileName());
+    return nullptr;
+  }
+};
+
+/**
+ * \brief builds a precompiled header
+ * \param index         the libclang index
+ * \param header        the path of the prefix header
+ * \param name          the name of the precompiled header (see key())
+ * \param entry         the entry of the precompiled header
+ * \param dependencies  receives the files used to build the precompiled header
+ * 
+ * Every build of an entry is written to a new file: translation units 
+ * parsed with the previous build may still read it.
+ */
+std::string PrecompiledHeaders::build(libclang::Index& index, const std::string& header, const std::string& name, const Entry& entry, std::vector<Dependency>& dependencies)
+{
+  const program::CompileOptions& opts = *entry.options;
+
+  std::vector<std::string> args = { "-x", "c++-header" };
+
+  for (const std::string& dir : opts.includedirs)
+    args.push_back("-I" + dir);
+
+  // the translation units are parsed with a detailed preprocessing record 
+  // (see ClangIndex), the precompiled header must have been built with it
+  const int options = CXTranslationUnit_Incomplete | CXTranslationUnit_ForSerialization | CXTranslationUnit_DetailedPreprocessingRecord;
+
+  libclang::IndexAction action{ index };
+  PrecompiledHeaderIndexer indexer{ index.api };
+  libclang::TranslationUnit tu = action.indexSourceFile(indexer, header, args, options);
+
+  QDir().mkpath(m_directory);
+  std::string path = (m_directory + "/" + QString::fromStdString(name) + "-" + QString::number(entry.builds) + ".pch").toStdString();
+
+  tu.saveTranslationUnit(path);
+
+  if (!std::filesystem::exists(std::filesystem::u8path(path)))
+    return {};
+
+  indexer.files.insert(header);
+
+  for (const std::string& file : indexer.files)
+  {
+    std::error_code ec;
+    std::filesystem::file_time_type time = std::filesystem::last_write_time(std::filesystem::u8path(file), ec);
+
+    if (!ec)
+      dependencies.push_back(Dependency{ file, time });
+  }
+
+  return path;
+}
@@ -0,0 +1,78 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_PRECOMPILEDHEADERS_H
+#define CLARK_PRECOMPILEDHEADERS_H
+
+#include "translationunit.h"
+
+#include <QString>
+
+#include <filesystem>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace libclang
+{
+class Index;
+} // namespace libclang
+
+/**
+ * \brief builds and shares precompiled headers between translation units
+ * 
+ * Translation units that share the same compile options (i.e., the same 
+ * include directories and defines) and start by including the same header 
+ * (typically "stdafx.h" or "pch.h") can reuse a single precompiled header.
+ * 
+ * A precompiled header is only built once a second translation unit 
+ * with the same prefix header is parsed.
+ * It is built again if the prefix header or one of the files it includes 
+ * has been modified since.
+ * The files of the precompiled headers are removed when they are replaced 
+ * and when the cache is destroyed.
+ */
+class PrecompiledHeaders
+{
+public:
+  explicit PrecompiledHeaders(const QString& directory);
+  ~PrecompiledHeaders();
+
+  const QString& directory() const;
+
+  std::string get(libclang::Index& index, const TranslationUnit& tu);
+
+  static std::string findPrefixHeader(const std::string& source, const program::CompileOptions& opts);
+
+private:
+  struct Dependency
+  {
+    std::string path;
+    std::filesystem::file_time_type last_write_time;
+  };
+
+  struct Entry
+  {
+    std::shared_ptr<const program::CompileOptions> options;
+    std::set<std::string> sources; // the translation units that include the header
+    int builds = 0;
+    std::shared_future<std::string> pch;
+    std::vector<Dependency> dependencies;
+  };
+
+  static std::string key(const std::string& header, const program::CompileOptions& opts);
+  std::string build(libclang::Index& index, const std::string& header, const std::string& name, const Entry& entry, std::vector<Dependency>& dependencies);
+  static bool isOutdated(const Entry& entry);
+  static void remove(const std::shared_future<std::string>& pch);
+
+  QString m_directory;
+  std::mutex m_mutex;
+  std::map<std::string, Entry> m_entries; // keyed by key()
+};
+
+#endif // CLARK_PRECOMPILEDHEADERS_H
@@ -0,0 +1,59 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "prefetchpolicy.h"
+
+#include "clangindex.h"
+
+#include <QFileInfo>
+
+#include <algorithm>
+
+PrefetchPolicy::~PrefetchPolicy()
+{
+
+}
+
+/**
+ * \brief returns the translation units that are likely to be opened after a given one
+ * \param index  the index owning the translation units
+ * \param tu     the translation unit that was opened
+ * \param max    the maximum number of translation units to return
+ * 
+ * Translation units are returned from the most to the least likely.
+ */
+std::vector<TranslationUnit*> PrefetchPolicy::neighbours(const ClangIndex& index, const TranslationUnit& tu, size_t max)
+{
+  const QString dir = QFileInfo(tu.filePath()).path();
+
+  std::vector<std::pair<int, TranslationUnit*>> candidates;
+
+  for (TranslationUnit* other : index.translationUnits())
+  {
+    if (other == &tu)
+      continue;
+
+    int score = 0;
+
+    if (QFileInfo(other->filePath()).path() == dir)
+      score += 2;
+
+    if (other->sharedCompileOptions() && other->sharedCompileOptions() == tu.sharedCompileOptions())
+      score += 1;
+
+    if (score > 0)
+      candidates.emplace_back(score, other);
+  }
+
+  std::stable_sort(candidates.begin(), candidates.end(), [](const std::pair<int, TranslationUnit*>& a, const std::pair<int, TranslationUnit*>& b) {
+    return a.first > b.first;
+    });
+
+  std::vector<TranslationUnit*> result;
+
+  for (size_t i(0); i < candidates.size() && result.size() < max; ++i)
+    result.push_back(candidates.at(i).second);
+
+  return result;
+}
@@ -0,0 +1,29 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_PREFETCHPOLICY_H
+#define CLARK_PREFETCHPOLICY_H
+
+#include <cstddef>
+#include <vector>
+
+class ClangIndex;
+class TranslationUnit;
+
+/**
+ * \brief selects the translation units that are likely to be opened next
+ * 
+ * The default policy uses the structure of the project: translation units 
+ * in the same directory come first, followed by translation units sharing 
+ * the same compile options (i.e., belonging to the same project).
+ */
+class PrefetchPolicy
+{
+public:
+  virtual ~PrefetchPolicy();
+
+  virtual std::vector<TranslationUnit*> neighbours(const ClangIndex& index, const TranslationUnit& tu, size_t max);
+};
+
+#endif // CLARK_PREFETCHPOLICY_H
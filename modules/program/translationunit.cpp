@@ -12,8 +12,6 @@
 
 #include <QDebug>
 
-static const std::shared_ptr<const program::CompileOptions> gEmptyCompileOptions = {};
-
 //TranslationUnit::Data::Data()
 //{
 //
@@ -26,7 +24,8 @@ TranslationUnit::Data::~Data()
 
 TranslationUnit::TranslationUnit(const QString& filePath, QObject* parent) :
   QObject(parent),
-  m_file_path(filePath)
+  m_file_path(filePath),
+  m_compile_options(program::intern(program::CompileOptions()))
 {
 
 }
@@ -58,38 +57,48 @@ const program::CompileOptions& TranslationUnit::compileOptions() const
   return *m_compile_options;
 }
 
+/**
+ * \brief returns the compile options as a shared pointer
+ * 
+ * Compile options are interned: translation units with equal compile options 
+ * share the same object.
+ */
+const std::shared_ptr<const program::CompileOptions>& TranslationUnit::sharedCompileOptions() const
+{
+  return m_compile_options;
+}
+
 void TranslationUnit::setCompileOptions(const program::CompileOptions& opts)
 {
-  setCompileOptions(std::make_shared<program::CompileOptions>(opts));
+  setCompileOptions(program::intern(opts));
 }
 
 void TranslationUnit::setCompileOptions(std::shared_ptr<const program::CompileOptions> opts)
 {
-  if (!opts)
-    m_compile_options = gEmptyCompileOptions;
-  else
-    m_compile_options = std::move(opts);
+  m_compile_options = program::intern(opts);
 }
 
 TranslationUnit::State TranslationUnit::state() const
 {
-  std::lock_guard<std::mutex> lock{ m_mutex };
-  return m_data.state;
+  return m_data.state.load();
 }
 
 void TranslationUnit::setState(State s)
 {
-  std::unique_lock lock{ m_mutex };
+  if (m_data.state.exchange(s) == s)
+    return;
 
-  if (m_data.state != s)
+  if (s == State::Loaded)
   {
-    m_data.state = s;
-    lock.unlock();
-    Q_EMIT stateChanged();
-
-    if (s == State::Loaded)
-      Q_EMIT loaded();
+    // threads waiting for the translation unit check the state while holding the mutex
+    { std::lock_guard<std::mutex> lock{ m_mutex }; }
+    loadedConditionVariable().notify_all();
   }
+
+  Q_EMIT stateChanged();
+
+  if (s == State::Loaded)
+    Q_EMIT loaded();
 }
 
 void TranslationUnit::notifyStateChange()
@@ -114,24 +123,39 @@ void TranslationUnit::load()
 
 int TranslationUnit::flags() const
 {
-  return m_data.flags;
+  return m_data.flags.load();
 }
 
 void TranslationUnit::setFlag(Flag f, bool on)
 {
-  std::lock_guard<std::mutex> lock{ m_mutex };
- 
   if (on)
-    m_data.flags |= static_cast<int>(f);
+    m_data.flags.fetch_or(static_cast<int>(f));
   else
-    m_data.flags &= ~static_cast<int>(f);
+    m_data.flags.fetch_and(~static_cast<int>(f));
+}
+
+/**
+ * \brief returns the generation of the clang translation unit
+ * 
+ * The generation is incremented every time the clang translation unit 
+ * is replaced or reparsed; it can be used to detect that a result 
+ * computed from the translation unit is out-of-date.
+ */
+int TranslationUnit::generation() const
+{
+  return m_data.generation.load();
 }
 
 void TranslationUnit::setClangTranslationUnit(std::unique_ptr<libclang::TranslationUnit> tu)
 {
   {
+    std::unique_lock<std::shared_mutex> access{ m_access_mutex };
     std::lock_guard<std::mutex> lock{ m_mutex };
     m_data.clang_translation_unit = std::move(tu);
+    // a full parse that started before is out-of-date
+    m_data.full_clang_translation_unit.reset();
+    m_data.spare_clang_translation_unit.reset();
+    m_data.generation.fetch_add(1);
     m_data.state = State::Loaded;
   }
 
@@ -146,6 +170,49 @@ libclang::TranslationUnit* TranslationUnit::clangTranslationUnit() const
   return m_data.clang_translation_unit.get();
 }
 
+/**
+ * \brief stores a clang translation unit that must replace the current one
+ * \param tu          the result of the full parse or reparse
+ * \param generation  the generation of the translation unit when the parse started
+ * 
+ * This is used for the full parse of a skeleton and for the reparse of a 
+ * loaded translation unit.
+ * The translation unit returned by clangTranslationUnit() is not replaced 
+ * immediately as it may still be in use; the ClangIndex performs the swap 
+ * in its own thread when the fullParseReady() signal is received.
+ * 
+ * The result is discarded, and false is returned, if the clang translation 
+ * unit was replaced or reparsed since the parse started.
+ */
+bool TranslationUnit::setFullClangTranslationUnit(std::unique_ptr<libclang::TranslationUnit> tu, int generation)
+{
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+
+    if (m_data.generation.load() != generation)
+      return false;
+
+    m_data.full_clang_translation_unit = std::move(tu);
+  }
+
+  emit fullParseReady();
+
+  return true;
+}
+
+/**
+ * \brief removes and returns the clang translation unit that was replaced by the last reparse
+ * 
+ * The previous clang translation unit is kept after a reparse so that the 
+ * next reparse can update it in place and reuse its precompiled preamble.
+ * This returns nullptr if there is no such translation unit.
+ */
+std::unique_ptr<libclang::TranslationUnit> TranslationUnit::takeSpareClangTranslationUnit()
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  return std::move(m_data.spare_clang_translation_unit);
+}
+
 bool TranslationUnit::used() const
 {
   return useCount() > 0;
@@ -153,21 +220,12 @@ bool TranslationUnit::used() const
 
 int TranslationUnit::useCount() const
 {
-  std::lock_guard<std::mutex> lock{ m_mutex };
-  return m_data.use_count;
+  return m_data.use_count.load();
 }
 
 void TranslationUnit::decrementUseCount()
 {
-  bool used_changed = false;
-
-  {
-    std::lock_guard<std::mutex> lock{ m_mutex };
-    m_data.use_count--;
-    used_changed = m_data.use_count == 0;
-  }
-
-  if (used_changed)
+  if (m_data.use_count.fetch_sub(1) == 1)
     emit usedChanged();
 }
 
@@ -186,6 +244,21 @@ std::mutex& TranslationUnit::mutex() const
   return m_mutex;
 }
 
+/**
+ * \brief returns the mutex that protects the clang translation unit from being replaced
+ * 
+ * Tasks that use the clang translation unit outside of the thread of the 
+ * translation unit must hold this mutex in shared mode, and check that 
+ * generation() did not change since they captured data from the clang 
+ * translation unit (e.g. a libclang::File).
+ * The clang translation unit is replaced, suspended or destroyed while 
+ * holding the mutex exclusively.
+ */
+std::shared_mutex& TranslationUnit::accessMutex() const
+{
+  return m_access_mutex;
+}
+
 std::condition_variable& TranslationUnit::loadedConditionVariable()
 {
   return m_loaded_condition_variable;
@@ -222,10 +295,7 @@ TranslationUnitHandle::TranslationUnitHandle(const TranslationUnitHandle& other)
   m_translation_unit(other.m_translation_unit)
 {
   if (m_translation_unit)
-  {
-    std::unique_lock lock{ m_translation_unit->mutex() };
-    m_translation_unit->data().use_count += 1;
-  }
+    m_translation_unit->data().use_count.fetch_add(1);
 }
 
 TranslationUnitHandle::TranslationUnitHandle(TranslationUnitHandle&& other) :
@@ -332,20 +402,25 @@ TranslationUnitHandle& TranslationUnitHandle::operator=(TranslationUnitHandle&&
 
 void TranslationUnitHandle::load(TranslationUnit& tu)
 {
-  std::unique_lock lock{ tu.mutex() };
+  // the use count is incremented before the state is checked so that
+  // the ClangIndex cannot suspend the translation unit behind our back
+  // (see ClangIndex::unloadTranslationUnits())
+  bool now_used = tu.data().use_count.fetch_add(1) == 0;
+
+  if (now_used)
+    tu.data().flags |= TranslationUnit::WasUsed;
 
   if (!is_tu_loaded(tu))
   {
-    LoadProc proc = getLoadProc();
-    proc(tu, lock);
-  }
-
-  tu.data().use_count += 1;
+    std::unique_lock lock{ tu.mutex() };
 
-  bool now_used = tu.data().use_count == 1;
-
-  lock.unlock();
+    if (!is_tu_loaded(tu))
+    {
+      LoadProc proc = getLoadProc();
+      proc(tu, lock);
+    }
+  }
 
   if (now_used)
     Q_EMIT tu.usedChanged();
-}
\ No newline at end of file
+}
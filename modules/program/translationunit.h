@@ -5,14 +5,18 @@
 #ifndef CLARK_TRANSLATIONUNIT_H
 #define CLARK_TRANSLATIONUNIT_H
 
+#include "compileoptions.h"
+
 #include <QObject>
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <set>
+#include <shared_mutex>
 #include <vector>
 
 namespace libclang
@@ -20,30 +24,6 @@ namespace libclang
 class TranslationUnit;
 } // namespace libclang
 
-namespace program
-{
-
-/**
- * \brief stores various information about the compiler flags required to compile a translation unit
- */
-struct CompileOptions
-{
-  /**
-   * \brief lists the include directories used when compiling the translation unit
-   */
-  std::set<std::string> includedirs;
-
-  /**
-   * \brief lists the preprocessor defines used when compiling
-   * 
-   * The key is the name of the define/macro.
-   * The value is the define's value and can be an empty string.
-   */
-  std::map<std::string, std::string> defines;
-};
-
-} // namespace program
-
 class ClangIndex;
 
 /**
@@ -60,6 +40,7 @@ public:
   const QString& filePath() const;
 
   const program::CompileOptions& compileOptions() const;
+  const std::shared_ptr<const program::CompileOptions>& sharedCompileOptions() const;
   void setCompileOptions(const program::CompileOptions& opts);
   void setCompileOptions(std::shared_ptr<const program::CompileOptions> opts);
 
@@ -69,6 +50,7 @@ public:
     Parsing,
     Loaded,
     Suspended,
+    Hibernated, // the clang translation unit was saved to disk and destroyed
     // $todo: maybe just NotLoaded, Loading, Loaded
   };
 
@@ -82,13 +64,23 @@ public:
   enum Flag
   {
     // $todo: maybe Suspended, NerverParsed, ScheduleForParsing
+    Skeleton = 0x0001, // the clang translation unit was parsed without function bodies
+    FullParseScheduled = 0x0002, // a full parse is running or queued to replace the skeleton
+    HasAstFile = 0x0004, // the AST was saved to ClangIndex::astFilePath()
+    FromAstFile = 0x0008, // the clang translation unit was restored from the AST file
+    Reparsing = 0x0010, // a new clang translation unit is being built to replace the current one
+    WasUsed = 0x0020, // a handle used the translation unit, it is saved to disk when it is hibernated
   };
 
   int flags() const;
   void setFlag(Flag f, bool on = true);
 
+  int generation() const;
+
   void setClangTranslationUnit(std::unique_ptr<libclang::TranslationUnit> tu);
   libclang::TranslationUnit* clangTranslationUnit() const;
+  bool setFullClangTranslationUnit(std::unique_ptr<libclang::TranslationUnit> tu, int generation);
+  std::unique_ptr<libclang::TranslationUnit> takeSpareClangTranslationUnit();
 
   bool used() const;
   int useCount() const;
@@ -97,13 +89,29 @@ public:
   ClangIndex* clangIndex() const;
   void setClangIndex(ClangIndex* index);
 
+  /**
+   * \brief the mutable state of a translation unit
+   * 
+   * The state, flags and use count can be read and updated without 
+   * holding the mutex; the mutex protects the clang translation units 
+   * and is used together with the condition variable to wait for a 
+   * translation unit to be loaded.
+   * 
+   * The clang translation unit of a loaded translation unit is only 
+   * replaced or modified by the thread of the translation unit, while 
+   * holding the access mutex (see accessMutex()).
+   */
   class Data
   {
   public:
-    State state = AwaitingParsing;
-    int flags = 0;
-    int use_count = 0;
+    std::atomic<State> state{ AwaitingParsing };
+    std::atomic<int> flags{ 0 };
+    std::atomic<int> use_count{ 0 };
+    std::atomic<int> generation{ 0 }; // incremented every time the clang translation unit is replaced or reparsed
     std::unique_ptr<libclang::TranslationUnit> clang_translation_unit;
+    std::unique_ptr<libclang::TranslationUnit> full_clang_translation_unit;
+    std::unique_ptr<libclang::TranslationUnit> spare_clang_translation_unit; // reparsed in place by the next reparse
+    std::chrono::steady_clock::time_point released_at; // when the translation unit was suspended or stopped being used
 
   public:
     //Data();
@@ -117,6 +125,7 @@ public:
   };
 
   std::mutex& mutex() const;
+  std::shared_mutex& accessMutex() const;
   std::condition_variable& loadedConditionVariable();
   Data& data();
   const Data& data() const;
@@ -126,12 +135,15 @@ Q_SIGNALS:
   void stateChanged();
   void loaded();
   void usedChanged();
+  void fullParseReady();
+  void reparsed();
 
 private:
   QString m_file_path;
   std::shared_ptr<const program::CompileOptions> m_compile_options;
   ClangIndex* m_index = nullptr;
   mutable std::mutex m_mutex;
+  mutable std::shared_mutex m_access_mutex;
   std::condition_variable m_loaded_condition_variable;
   Data m_data;
 };
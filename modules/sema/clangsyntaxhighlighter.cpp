@@ -3,27 +3,56 @@
 // For conditions of distribution and use, see copyright notice in LICENSE.
 
 #include "clangsyntaxhighlighter.h"
- 
+
+#include "cursorformatcache.h"
+
+#include "utils/executor.h"
+#include "utils/telemetry.h"
+
 #include <libclang-utils/annotatetokens.h>
 #include <libclang-utils/clang-cursor.h>
 #include <libclang-utils/clang-source-location.h>
 #include <libclang-utils/clang-translation-unit.h>
 
+#include <QFutureWatcher>
 #include <QTextDocument>
 
 #include <QDebug>
 
-#include <cstring>
+#include <algorithm>
+#include <shared_mutex>
 
 ClangSyntaxHighlighter::ClangSyntaxHighlighter(TranslationUnitHandle thandle, const libclang::File& file, QTextDocument* document) 
   : CppSyntaxHighlighter(document),
   m_thandle(thandle),
-  m_file(file)
+  m_file(file),
+  m_format_cache(CursorFormatCache::get(*thandle.translationUnit()))
+{
+  connect(m_thandle.translationUnit(), &TranslationUnit::reparsed, this, &ClangSyntaxHighlighter::onTranslationUnitReparsed);
+
+  startAnnotating();
+}
+
+ClangSyntaxHighlighter::~ClangSyntaxHighlighter()
+{
+
+}
+
+/**
+ * \brief updates the highlighting after the translation unit was reparsed
+ * 
+ * The file handle is invalidated by the reparse and must be retrieved again.
+ * The file is annotated again in the background.
+ */
+void ClangSyntaxHighlighter::onTranslationUnitReparsed()
 {
+  m_file = m_thandle.clangTranslationunit().getFile(m_file.getFileName());
 
+  // the previous annotations are used until the new ones are ready
+  startAnnotating();
 }
 
-CppSyntaxHighlighter::Format format4DeclRefExpr(const libclang::Cursor& cursor)
+static CppSyntaxHighlighter::Format format4definition(const libclang::Cursor& cursor)
 {
   libclang::Cursor c = cursor;
 
@@ -56,7 +85,38 @@ CppSyntaxHighlighter::Format format4DeclRefExpr(const libclang::Cursor& cursor)
   }
 }
 
+static CppSyntaxHighlighter::Format format4DeclRefExpr(const libclang::Cursor& cursor, CursorFormatCache* cache, int generation)
+{
+  if (!cache)
+    return format4definition(cursor);
+
+  libclang::Cursor decl = cursor.getReference();
+
+  if (decl.isNull())
+    return format4definition(cursor);
+
+  CppSyntaxHighlighter::Format format;
+
+  if (cache->find(decl, format))
+    return format;
+
+  format = format4definition(cursor);
+  cache->insert(decl, format, generation);
+  return format;
+}
+
 CppSyntaxHighlighter::Format ClangSyntaxHighlighter::format4cursor(const libclang::Cursor& cursor)
+{
+  return format4cursor(cursor, nullptr, 0);
+}
+
+/**
+ * \brief returns the format of an identifier
+ * \param cursor      the cursor of the identifier
+ * \param cache       an optional cache for the format of referenced declarations
+ * \param generation  the generation of the cache when the computation started
+ */
+CppSyntaxHighlighter::Format ClangSyntaxHighlighter::format4cursor(const libclang::Cursor& cursor, CursorFormatCache* cache, int generation)
 {
   if (cursor.isNull())
     return CppSyntaxHighlighter::Default;
@@ -94,7 +154,7 @@ CppSyntaxHighlighter::Format ClangSyntaxHighlighter::format4cursor(const libclan
   case CXCursor_MemberRefExpr:
     return CppSyntaxHighlighter::Format::Function;
   case CXCursor_DeclRefExpr:
-    return format4DeclRefExpr(cursor);
+    return format4DeclRefExpr(cursor, cache, generation);
   default:
     //qDebug() << c.getCursorKindSpelling().c_str() << ": " << c.getDisplayName().c_str();
     return CppSyntaxHighlighter::Format::Default;
@@ -127,60 +187,71 @@ CppSyntaxHighlighter::Format ClangSyntaxHighlighter::format4token(const libclang
   }
 }
 
-void ClangSyntaxHighlighter::highlightBlock(const QString& text)
+/**
+ * \brief tokenizes and annotates a whole file
+ * \param tu     the translation unit
+ * \param file   a file of the translation unit
+ * \param cache  an optional cache for the format of referenced declarations
+ * 
+ * This function can be called from any thread.
+ */
+std::shared_ptr<const ClangSyntaxHighlighter::Annotations> ClangSyntaxHighlighter::annotate(libclang::TranslationUnit& tu, const libclang::File& file, CursorFormatCache* cache)
 {
-  int prevstate = previousBlockState();
+  clark::telemetry::ScopedSpan span{ clark::telemetry::Category::Highlight };
 
-  int col = 1;
+  const int generation = cache ? cache->generation() : 0;
 
-  if (prevstate == ST_Comment)
-  {
-    int i = text.indexOf("*/");
+  auto result = std::make_shared<Annotations>();
 
-    if (i == -1)
-    {
-      setFormat(0, text.size(), Format::Comment);
-      setCurrentBlockState(ST_Comment);
-      return;
-    }
-    else
+  const std::string contents = tu.getFileContents(file);
+
+  // lines are 1-based in libclang
+  int line_count = 1 + static_cast<int>(std::count(contents.begin(), contents.end(), '\n'));
+  size_t last_line_start = contents.rfind('\n');
+  last_line_start = last_line_start == std::string::npos ? 0 : last_line_start + 1;
+  int last_col = static_cast<int>(contents.size() - last_line_start) + 1;
+
+  std::vector<std::vector<Annotations::Run>> lines;
+  lines.resize(line_count);
+  result->line_states.assign(line_count, ST_Default);
+
+  auto add_token = [&](const libclang::Token& tok, Format fmt) {
+    libclang::SpellingLocation loc = tok.getLocation().getSpellingLocation();
+    std::string spelling = tok.getSpelling();
+
+    int line = loc.line - 1;
+    int col = loc.col - 1;
+    size_t pos = 0;
+
+    // tokens spanning several lines (i.e., multiline comments) produce one run per line
+    for (;;)
     {
-      setFormat(0, i+2, Format::Comment);
-      col = i + 2 + 1;
-
-      if (col >= text.size())
-      {
-        setCurrentBlockState(ST_Default);
-        return;
-      }
-    }
-  }
+      size_t newline = spelling.find('\n', pos);
+      size_t end = newline == std::string::npos ? spelling.size() : newline;
+
+      if (line >= 0 && line < line_count && end > pos)
+        lines[line].push_back(Annotations::Run{ col, static_cast<int>(end - pos), fmt });
 
-  int line = currentBlock().blockNumber() + 1;
+      if (newline == std::string::npos)
+        break;
 
-  auto& tu = m_thandle.clangTranslationunit();
-  libclang::SourceLocation start = tu.getLocation(m_file, line, col);
-  libclang::SourceLocation end = tu.getLocation(m_file, line, text.size());
-  libclang::SourceRange range = libclang::getRange(start, end);
-  libclang::TokenSet tokens = tu.tokenize(range);
+      if (line >= 0 && line < line_count)
+        result->line_states[line] = ST_Comment;
+
+      pos = newline + 1;
+      col = 0;
+      ++line;
+    }
+  };
 
-  bool has_identifier = has_any_identifier(tokens);
+  libclang::SourceLocation start = tu.getLocation(file, 1, 1);
+  libclang::SourceLocation end = tu.getLocation(file, line_count, last_col);
+  libclang::TokenSet tokens = tu.tokenize(libclang::getRange(start, end));
 
-  if (has_identifier)
+  if (has_any_identifier(tokens))
   {
     libclang::annotateTokens(tu, tokens, [&](const libclang::Token& tok, const libclang::Cursor& c) {
-      int col = tok.getLocation().getSpellingLocation().col - 1;
-      std::string spelling = tok.getSpelling();
-      int len = spelling.size();
-
-      if (tok.getKind() == CXToken_Identifier)
-      {
-        setFormat(col, len, format4cursor(c));
-      }
-      else
-      {
-        setFormat(col, len, format4token(tok));
-      }
+      add_token(tok, tok.getKind() == CXToken_Identifier ? format4cursor(c, cache, generation) : format4token(tok));
       });
   }
   else
@@ -188,49 +259,156 @@ void ClangSyntaxHighlighter::highlightBlock(const QString& text)
     for (size_t i(0); i < tokens.size(); ++i)
     {
       libclang::Token tok = tokens.at(i);
-      setFormat(tok.getLocation().getSpellingLocation().col - 1, tok.getSpelling().size(), format4token(tok));
+      add_token(tok, format4token(tok));
     }
   }
 
-  if (!tokens.empty())
+  result->line_offsets.reserve(line_count + 1);
+
+  for (const std::vector<Annotations::Run>& runs : lines)
   {
-    setCurrentBlockStateFromToken(tokens.at(tokens.size() - 1));
+    result->line_offsets.push_back(result->runs.size());
+    result->runs.insert(result->runs.end(), runs.begin(), runs.end());
   }
+
+  result->line_offsets.push_back(result->runs.size());
+  result->runs.shrink_to_fit();
+
+  return result;
+}
+
+size_t ClangSyntaxHighlighter::Annotations::lineCount() const
+{
+  return line_states.size();
+}
+
+/**
+ * \brief returns whether the annotations of the file have been computed
+ */
+bool ClangSyntaxHighlighter::hasAnnotations() const
+{
+  return m_annotations != nullptr;
 }
 
-void ClangSyntaxHighlighter::setCurrentBlockStateFromToken(const libclang::Token& t)
+void ClangSyntaxHighlighter::startAnnotating()
 {
-  if (t.getKind() == CXToken_Comment)
+  using Watcher = QFutureWatcher<std::shared_ptr<const Annotations>>;
+
+  // results of a previous request are discarded
+  delete m_annotations_watcher;
+
+  m_annotations_watcher = new Watcher(this);
+  connect(m_annotations_watcher, &Watcher::finished, this, &ClangSyntaxHighlighter::onAnnotationsReady);
+
+  TranslationUnitHandle thandle = m_thandle;
+  libclang::File file = m_file;
+  std::shared_ptr<CursorFormatCache> cache = m_format_cache;
+  const int generation = thandle.translationUnit()->generation();
+
+  // annotating a whole file can take a while, it must not hold one of the few 
+  // threads of the interactive executor; like the reparse of a loaded 
+  // translation unit, it goes before the queued parses
+  m_annotations_watcher->setFuture(Executor::get(Executor::Parse).run([thandle, file, cache, generation]() {
+    TranslationUnit& tu = *thandle.translationUnit();
+
+    // the file belongs to the clang translation unit that was current when the task was created
+    std::shared_lock<std::shared_mutex> access{ tu.accessMutex() };
+
+    if (tu.generation() != generation)
+      return std::shared_ptr<const Annotations>();
+
+    cache->setTranslationUnitGeneration(generation);
+
+    return annotate(thandle.clangTranslationunit(), file, cache.get());
+    }, 1));
+}
+
+/**
+ * \brief returns the lines whose formats differ between two annotations
+ * 
+ * A null pointer is treated as a file without annotations.
+ */
+static std::vector<int> changed_lines(const ClangSyntaxHighlighter::Annotations* before, const ClangSyntaxHighlighter::Annotations& after)
+{
+  using Run = ClangSyntaxHighlighter::Annotations::Run;
+
+  auto same_run = [](const Run& a, const Run& b) {
+    return a.col == b.col && a.len == b.len && a.format == b.format;
+  };
+
+  std::vector<int> result;
+
+  for (size_t line(0); line < after.lineCount(); ++line)
   {
-    std::string spelling = t.getSpelling();
-    bool is_multiline = std::strncmp(spelling.c_str(), "/*", 2) == 0;
+    auto begin = after.runs.begin() + after.line_offsets[line];
+    auto end = after.runs.begin() + after.line_offsets[line + 1];
 
-    if (is_multiline)
+    if (!before || line >= before->lineCount())
     {
-      bool ends_in_this_line = spelling.find("\n") == std::string::npos 
-        && std::strcmp(spelling.c_str() + (spelling.size() - 2), "*/") == 0;
-
-      if (ends_in_this_line)
-      {
-        /* multiline comment is in fact on a single line */
-        setCurrentBlockState(ST_Default);
-      }
-      else
-      {
-        /* we are in a multiline comment that does not end 
-           at this line, we leave the line in the ST_Comment state */
-        setCurrentBlockState(ST_Comment);
-      }
+      if (begin != end || after.line_states[line] != CppSyntaxHighlighter::ST_Default)
+        result.push_back(static_cast<int>(line));
+
+      continue;
     }
-    else
+
+    auto other_begin = before->runs.begin() + before->line_offsets[line];
+    auto other_end = before->runs.begin() + before->line_offsets[line + 1];
+
+    if (after.line_states[line] != before->line_states[line] || !std::equal(begin, end, other_begin, other_end, same_run))
+      result.push_back(static_cast<int>(line));
+  }
+
+  // lines that are no longer annotated must lose their previous formats
+  if (before)
+  {
+    for (size_t line(after.lineCount()); line < before->lineCount(); ++line)
     {
-      // the comment ends at the end of the line, 
-      // so we do not leave the line in the ST_Comment state
-      setCurrentBlockState(ST_Default);
+      if (before->line_offsets[line] != before->line_offsets[line + 1])
+        result.push_back(static_cast<int>(line));
     }
   }
-  else
+
+  return result;
+}
+
+void ClangSyntaxHighlighter::onAnnotationsReady()
+{
+  // the task may have been dropped from the queue without running
+  std::shared_ptr<const Annotations> result = m_annotations_watcher->future().resultCount() > 0 ? m_annotations_watcher->result() : nullptr;
+  m_annotations_watcher->deleteLater();
+  m_annotations_watcher = nullptr;
+
+  // the translation unit was reparsed before the task started, 
+  // another request was made with the new file handle
+  if (!result)
+    return;
+
+  std::shared_ptr<const Annotations> previous = std::move(m_annotations);
+  m_annotations = std::move(result);
+
+  // only the lines whose formats changed are highlighted again, 
+  // this keeps the lazy mode of the base class effective
+  rehighlightBlocks(changed_lines(previous.get(), *m_annotations));
+
+  Q_EMIT annotationsReady();
+}
+
+void ClangSyntaxHighlighter::highlightBlock(const QString& text)
+{
+  const size_t line = static_cast<size_t>(currentBlock().blockNumber());
+
+  if (!m_annotations || line >= m_annotations->lineCount())
+    return;
+
+  // the state does not depend on the formatting, so it is always set
+  setCurrentBlockState(m_annotations->line_states[line]);
+
+  if (!shouldFormatCurrentBlock())
+    return;
+
+  for (size_t i = m_annotations->line_offsets[line]; i < m_annotations->line_offsets[line + 1]; ++i)
   {
-    setCurrentBlockState(ST_Default);
+    const Annotations::Run& run = m_annotations->runs[i];
+    setFormat(run.col, run.len, run.format);
   }
 }
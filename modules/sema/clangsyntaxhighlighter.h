@@ -12,11 +12,23 @@
 #include <libclang-utils/clang-file.h>
 #include <libclang-utils/clang-token.h>
 
+#include <memory>
+#include <vector>
+
+template<typename T>
+class QFutureWatcher;
+
+class CursorFormatCache;
+
 /**
  * \brief C++ syntax highlighter powered by libclang
  * 
  * This syntax highlighter uses clang_tokenize() and clang_annotateTokens() to highlight 
  * source code in a QTextDocument.
+ * 
+ * The whole file is tokenized and annotated once in a background thread; 
+ * highlightBlock() then only copies the precomputed formats of the line.
+ * The document is displayed without highlighting until the annotations are ready.
  */
 class ClangSyntaxHighlighter : public CppSyntaxHighlighter
 {
@@ -24,18 +36,52 @@ class ClangSyntaxHighlighter : public CppSyntaxHighlighter
 public:
   ClangSyntaxHighlighter(TranslationUnitHandle thandle, const libclang::File& file, QTextDocument* document);
 
+  ~ClangSyntaxHighlighter();
+
   static Format format4cursor(const libclang::Cursor& c);
+  static Format format4cursor(const libclang::Cursor& c, CursorFormatCache* cache, int generation);
   static Format format4token(const libclang::Token& t);
 
+  /**
+   * \brief the formats of a file, computed from its tokens
+   */
+  struct Annotations
+  {
+    struct Run
+    {
+      int col; // 0-based
+      int len;
+      Format format;
+    };
+
+    std::vector<Run> runs;
+    std::vector<size_t> line_offsets; // runs of line i are in [line_offsets[i], line_offsets[i+1])
+    std::vector<State> line_states; // state at the end of each line
+
+    size_t lineCount() const;
+  };
+
+  static std::shared_ptr<const Annotations> annotate(libclang::TranslationUnit& tu, const libclang::File& file, CursorFormatCache* cache = nullptr);
+
+  bool hasAnnotations() const;
+
+Q_SIGNALS:
+  void annotationsReady();
+
+protected Q_SLOTS:
+  void onTranslationUnitReparsed();
+  void onAnnotationsReady();
+
 protected:
   void highlightBlock(const QString& text) override;
-
-private:
-  void setCurrentBlockStateFromToken(const libclang::Token& t);
+  void startAnnotating();
 
 private:
   TranslationUnitHandle m_thandle;
   libclang::File m_file;
+  std::shared_ptr<CursorFormatCache> m_format_cache;
+  std::shared_ptr<const Annotations> m_annotations;
+  QFutureWatcher<std::shared_ptr<const Annotations>>* m_annotations_watcher = nullptr;
 };
 
 #endif // CLARK_CLANGSYNTAXHIGHLIGHTER_H
@@ -0,0 +1,111 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "cursorformatcache.h"
+
+#include <program/translationunit.h>
+
+#include <map>
+
+/**
+ * \brief returns the cache associated with a translation unit
+ * 
+ * The cache is created on first use.
+ * This function must be called from the thread of the translation unit.
+ */
+std::shared_ptr<CursorFormatCache> CursorFormatCache::get(TranslationUnit& tu)
+{
+  static std::map<TranslationUnit*, std::shared_ptr<CursorFormatCache>> caches;
+
+  std::shared_ptr<CursorFormatCache>& cache = caches[&tu];
+
+  if (!cache)
+  {
+    cache = std::make_shared<CursorFormatCache>();
+
+    TranslationUnit* key = &tu;
+
+    QObject::connect(&tu, &TranslationUnit::aboutToBeDestroyed, [key]() {
+      caches.erase(key);
+      });
+  }
+
+  return cache;
+}
+
+/**
+ * \brief returns the current generation of the cache
+ * 
+ * The generation is incremented every time the cache is cleared, 
+ * it is used to discard formats computed before the cache was cleared.
+ */
+int CursorFormatCache::generation() const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  return m_generation;
+}
+
+/**
+ * \brief sets the generation of the translation unit the cursors are looked up in
+ * \param generation  the value of TranslationUnit::generation()
+ * 
+ * The cache is cleared if \a generation differs from the generation of its 
+ * entries. This must be called before each use of the cache, while holding 
+ * the access mutex of the translation unit (see TranslationUnit::accessMutex()).
+ */
+void CursorFormatCache::setTranslationUnitGeneration(int generation)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  if (m_translation_unit_generation == generation)
+    return;
+
+  m_formats.clear();
+  ++m_generation;
+  m_translation_unit_generation = generation;
+}
+
+bool CursorFormatCache::find(const libclang::Cursor& decl, CppSyntaxHighlighter::Format& format) const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  auto it = m_formats.find(decl);
+
+  if (it == m_formats.end())
+    return false;
+
+  format = it->second;
+  return true;
+}
+
+void CursorFormatCache::insert(const libclang::Cursor& decl, CppSyntaxHighlighter::Format format, int generation)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  if (generation == m_generation)
+    m_formats.insert_or_assign(decl, format);
+}
+
+void CursorFormatCache::clear()
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  m_formats.clear();
+  ++m_generation;
+}
+
+size_t CursorFormatCache::size() const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  return m_formats.size();
+}
+
+size_t CursorFormatCache::CursorHash::operator()(const libclang::Cursor& c) const
+{
+  return c.api->clang_hashCursor(c.cursor);
+}
+
+bool CursorFormatCache::CursorEqual::operator()(const libclang::Cursor& a, const libclang::Cursor& b) const
+{
+  return a.api->clang_equalCursors(a.cursor, b.cursor) != 0;
+}
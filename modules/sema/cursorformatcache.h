@@ -0,0 +1,70 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_CURSORFORMATCACHE_H
+#define CLARK_CURSORFORMATCACHE_H
+
+#include <codeviewer/syntaxhighlighter.h>
+
+#include <libclang-utils/clang-cursor.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+class TranslationUnit;
+
+/**
+ * \brief caches the highlighting format of referenced declarations
+ * 
+ * Resolving the declaration referenced by an identifier requires a call to 
+ * clang_getCursorDefinition(), which is expensive and usually repeated for 
+ * every use of the same declaration in a file.
+ * This cache maps the cursor of the referenced declaration to its format; 
+ * cursors are hashed with clang_hashCursor() and compared with clang_equalCursors() 
+ * so that a lookup does not need to compute anything but the reference.
+ * 
+ * There is one cache per translation unit, shared by all the highlighters 
+ * of the translation unit.
+ * Cursors point into the AST of a clang translation unit, so the cache 
+ * records the generation of the translation unit (see TranslationUnit::generation()) 
+ * its entries belong to, and is cleared whenever the clang translation unit 
+ * changes, whether it was reparsed, restored from disk or replaced by a full parse.
+ * The cache can be used from any thread.
+ */
+class CursorFormatCache
+{
+public:
+  CursorFormatCache() = default;
+
+  static std::shared_ptr<CursorFormatCache> get(TranslationUnit& tu);
+
+  int generation() const;
+  void setTranslationUnitGeneration(int generation);
+
+  bool find(const libclang::Cursor& decl, CppSyntaxHighlighter::Format& format) const;
+  void insert(const libclang::Cursor& decl, CppSyntaxHighlighter::Format format, int generation);
+
+  void clear();
+  size_t size() const;
+
+private:
+  struct CursorHash
+  {
+    size_t operator()(const libclang::Cursor& c) const;
+  };
+
+  struct CursorEqual
+  {
+    bool operator()(const libclang::Cursor& a, const libclang::Cursor& b) const;
+  };
+
+private:
+  mutable std::mutex m_mutex;
+  int m_generation = 0;
+  int m_translation_unit_generation = -1;
+  std::unordered_map<libclang::Cursor, CppSyntaxHighlighter::Format, CursorHash, CursorEqual> m_formats;
+};
+
+#endif // CLARK_CURSORFORMATCACHE_H
@@ -0,0 +1,38 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "indexedfileinfoprovider.h"
+
+#include "indexedincludesinfile.h"
+
+#include <indexing/indexer.h>
+
+IndexedFileInfoProvider::IndexedFileInfoProvider(TranslationUnitIndexing* indexing, QObject* parent) : SymbolInfoProvider(parent),
+  m_indexing(indexing)
+{
+
+}
+
+IndexedFileInfoProvider::~IndexedFileInfoProvider()
+{
+
+}
+
+TranslationUnitIndexing* IndexedFileInfoProvider::indexing() const
+{
+  return m_indexing;
+}
+
+IndexedFileInfoProvider::Features IndexedFileInfoProvider::features() const
+{
+  return { Feature::IncludesInFile };
+}
+
+::IncludesInFile* IndexedFileInfoProvider::getIncludesInFile(const QString& filePath)
+{
+  if (!m_indexing)
+    return nullptr;
+
+  return new IndexedIncludesInFile(*m_indexing, filePath);
+}
@@ -0,0 +1,39 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_INDEXEDFILEINFOPROVIDER_H
+#define CLARK_INDEXEDFILEINFOPROVIDER_H
+
+#include <codeviewer/symbolinfoprovider.h>
+
+#include <QPointer>
+
+class TranslationUnitIndexing;
+
+/**
+ * \brief provides information about a file from an index
+ * 
+ * Unlike TranslationUnitSymbolInfoProvider, this does not require the 
+ * translation unit to be loaded; it is used for the files that are not 
+ * part of the loaded translation unit, and before or without loading it.
+ * The includes it returns are completed once the indexing is ready.
+ */
+class IndexedFileInfoProvider : public SymbolInfoProvider
+{
+  Q_OBJECT
+public:
+  explicit IndexedFileInfoProvider(TranslationUnitIndexing* indexing, QObject* parent = nullptr);
+  ~IndexedFileInfoProvider();
+
+  TranslationUnitIndexing* indexing() const;
+
+  Features features() const override;
+
+  ::IncludesInFile* getIncludesInFile(const QString& filePath) override;
+
+private:
+  QPointer<TranslationUnitIndexing> m_indexing;
+};
+
+#endif // CLARK_INDEXEDFILEINFOPROVIDER_H
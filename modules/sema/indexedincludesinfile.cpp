@@ -0,0 +1,71 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "indexedincludesinfile.h"
+
+#include <indexing/indexer.h>
+
+IndexedIncludesInFile::IndexedIncludesInFile(const std::vector<clark::FileIncludes::Entry>& includes, const QString& filePath, QObject* parent)
+  : IncludesInFile(filePath, parent)
+{
+  setIncludes(includes);
+}
+
+/**
+ * \brief constructs the includes of a file from the indexing of a translation unit
+ * \param indexing  the indexing, which need not be ready
+ * \param filePath  the path of the file
+ * \param parent    optional parent object
+ * 
+ * A file that the index does not know has no includes.
+ */
+IndexedIncludesInFile::IndexedIncludesInFile(TranslationUnitIndexing& indexing, const QString& filePath, QObject* parent)
+  : IncludesInFile(filePath, parent),
+    m_indexing(&indexing)
+{
+  connect(&indexing, &TranslationUnitIndexing::ready, this, &IndexedIncludesInFile::onIndexingReady);
+
+  if (indexing.isReady())
+    onIndexingReady();
+}
+
+IndexedIncludesInFile::~IndexedIncludesInFile()
+{
+
+}
+
+/**
+ * \brief creates the includes of a file from an include table
+ * 
+ * Returns nullptr if the table has no include directive in the file; 
+ * the includes must then be searched in the translation unit.
+ */
+IndexedIncludesInFile* IndexedIncludesInFile::create(const clark::FileIncludes& table, const QString& filePath)
+{
+  const std::vector<clark::FileIncludes::Entry>* includes = table.find(filePath.toStdString());
+  return includes ? new IndexedIncludesInFile(*includes, filePath) : nullptr;
+}
+
+void IndexedIncludesInFile::setIncludes(const std::vector<clark::FileIncludes::Entry>& includes)
+{
+  std::vector<Include> list;
+  list.reserve(includes.size());
+
+  for (const clark::FileIncludes::Entry& e : includes)
+  {
+    Include incl;
+    incl.line = e.line;
+    incl.included_file = QString::fromStdString(e.included_file->path);
+    list.push_back(incl);
+  }
+
+  setIncludesInFile(std::move(list));
+  setComplete();
+}
+
+void IndexedIncludesInFile::onIndexingReady()
+{
+  const std::vector<clark::FileIncludes::Entry>* includes = m_indexing->fileIncludes().find(filePath().toStdString());
+  setIncludes(includes ? *includes : std::vector<clark::FileIncludes::Entry>());
+}
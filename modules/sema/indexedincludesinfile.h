@@ -0,0 +1,43 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_INDEXEDINCLUDESINFILE_H
+#define CLARK_INDEXEDINCLUDESINFILE_H
+
+#include "codeviewer/includes.h"
+
+#include <indexing/fileincludes.h>
+
+class TranslationUnitIndexing;
+
+/**
+ * \brief the includes of a file, as recorded in an index
+ * 
+ * When constructed from an include table, the object is complete as soon 
+ * as it is constructed.
+ * When constructed from a TranslationUnitIndexing, it does not require the 
+ * translation unit to be loaded: it is completed when the indexing is 
+ * ready and follows the results of later indexings.
+ */
+class IndexedIncludesInFile : public IncludesInFile
+{
+  Q_OBJECT
+public:
+  explicit IndexedIncludesInFile(const std::vector<clark::FileIncludes::Entry>& includes, const QString& filePath, QObject* parent = nullptr);
+  IndexedIncludesInFile(TranslationUnitIndexing& indexing, const QString& filePath, QObject* parent = nullptr);
+  ~IndexedIncludesInFile();
+
+  static IndexedIncludesInFile* create(const clark::FileIncludes& table, const QString& filePath);
+
+protected:
+  void setIncludes(const std::vector<clark::FileIncludes::Entry>& includes);
+
+protected Q_SLOTS:
+  void onIndexingReady();
+
+private:
+  TranslationUnitIndexing* m_indexing = nullptr;
+};
+
+#endif // CLARK_INDEXEDINCLUDESINFILE_H
@@ -0,0 +1,90 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "indexedsymbolinfoprovider.h"
+
+#include "indexedincludesinfile.h"
+
+#include "utils/telemetry.h"
+
+#include <indexing/indexer.h>
+
+IndexedSymbolInfoProvider::IndexedSymbolInfoProvider(TranslationUnitHandle handle, const QTextDocument& document, TranslationUnitIndexing* indexing) :
+  TranslationUnitSymbolInfoProvider(handle, document),
+  m_indexing(indexing)
+{
+
+}
+
+IndexedSymbolInfoProvider::~IndexedSymbolInfoProvider()
+{
+
+}
+
+TranslationUnitIndexing* IndexedSymbolInfoProvider::indexing() const
+{
+  return m_indexing;
+}
+
+void IndexedSymbolInfoProvider::setIndexing(TranslationUnitIndexing* indexing)
+{
+  m_indexing = indexing;
+}
+
+/**
+ * \brief returns whether the index matches the current clang translation unit
+ * 
+ * After a reparse, the index describes the previous version of the 
+ * translation unit until it has been indexed again.
+ */
+bool IndexedSymbolInfoProvider::isIndexingUpToDate() const
+{
+  return m_indexing && m_indexing->isReady()
+    && m_indexing->translationUnitGeneration() == m_indexing->translationUnit().generation();
+}
+
+SymbolReferencesInDocument* IndexedSymbolInfoProvider::getReferencesInDocument(SymbolObject* symbol, const QString& filePath)
+{
+  if (!symbol || !isIndexingUpToDate() || symbol->usr().isEmpty())
+    return TranslationUnitSymbolInfoProvider::getReferencesInDocument(symbol, filePath);
+
+  clark::telemetry::ScopedSpan span{ clark::telemetry::Category::Query, "indexed references in document" };
+
+  const clark::Entity* entity = clark::find_entity(m_indexing->indexingResult(), symbol->usr().toStdString());
+  const clark::FileReferences& table = m_indexing->fileReferences();
+  const clark::File* file = table.findFile(filePath.toStdString());
+
+  // local symbols are not indexed
+  if (!entity || !file)
+    return TranslationUnitSymbolInfoProvider::getReferencesInDocument(symbol, filePath);
+
+  clark::FileReferences::Range refs = table.references(*file, *entity);
+
+  std::vector<SymbolReferencesInDocument::Position> positions;
+  positions.reserve(refs.size());
+
+  for (const clark::EntityReference* ref : refs)
+  {
+    SymbolReferencesInDocument::Position pos;
+    pos.line = ref->line;
+    pos.col = ref->col;
+    positions.push_back(pos);
+  }
+
+  auto* result = new SymbolReferencesInDocument(*symbol, filePath);
+  result->setReferencesInFile(std::move(positions));
+  result->setComplete();
+  return result;
+}
+
+::IncludesInFile* IndexedSymbolInfoProvider::getIncludesInFile(const QString& filePath)
+{
+  if (isIndexingUpToDate())
+  {
+    if (IndexedIncludesInFile* includes = IndexedIncludesInFile::create(m_indexing->fileIncludes(), filePath))
+      return includes;
+  }
+
+  return TranslationUnitSymbolInfoProvider::getIncludesInFile(filePath);
+}
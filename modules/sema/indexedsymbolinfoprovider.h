@@ -0,0 +1,41 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_INDEXEDSYMBOLINFOPROVIDER_H
+#define CLARK_INDEXEDSYMBOLINFOPROVIDER_H
+
+#include "tusymbolinfoprovider.h"
+
+#include <QPointer>
+
+class TranslationUnitIndexing;
+
+/**
+ * \brief a symbol info provider that uses the index of the translation unit
+ * 
+ * References and includes in a document are read from the index when the 
+ * index is up to date with the translation unit; otherwise they are searched 
+ * with libclang as in TranslationUnitSymbolInfoProvider.
+ */
+class IndexedSymbolInfoProvider : public TranslationUnitSymbolInfoProvider
+{
+  Q_OBJECT
+public:
+  IndexedSymbolInfoProvider(TranslationUnitHandle handle, const QTextDocument& document, TranslationUnitIndexing* indexing = nullptr);
+  ~IndexedSymbolInfoProvider();
+
+  TranslationUnitIndexing* indexing() const;
+  void setIndexing(TranslationUnitIndexing* indexing);
+
+  SymbolReferencesInDocument* getReferencesInDocument(SymbolObject* symbol, const QString& filePath) override;
+  ::IncludesInFile* getIncludesInFile(const QString& filePath) override;
+
+private:
+  bool isIndexingUpToDate() const;
+
+private:
+  QPointer<TranslationUnitIndexing> m_indexing;
+};
+
+#endif // CLARK_INDEXEDSYMBOLINFOPROVIDER_H
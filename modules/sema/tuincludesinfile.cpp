@@ -4,15 +4,21 @@
 
 #include "tuincludesinfile.h"
 
+#include "utils/executor.h"
+#include "utils/telemetry.h"
+
 #include <libclang-utils/findincludesinfile.h>
 
-#include <QtConcurrent> 
 #include <QFutureWatcher>
 
 #include <QDebug>
 
-std::vector<IncludesInFile::Include> find_includes_in_file(TranslationUnitIncludesInFile* includes)
+#include <shared_mutex>
+
+std::vector<IncludesInFile::Include> find_includes_in_file(const libclang::TranslationUnit& tu, const libclang::File& file)
 {
+  clark::telemetry::ScopedSpan span{ clark::telemetry::Category::Query, "includes in file" };
+
   std::vector<IncludesInFile::Include> list;
 
   auto func = [&list](const libclang::Cursor& c, const libclang::SourceRange& source_range) {
@@ -23,17 +29,32 @@ std::vector<IncludesInFile::Include> find_includes_in_file(TranslationUnitInclud
     list.push_back(incl);
   };
 
-  libclang::findIncludesInFile(includes->translationUnit(), includes->file(), func);
+  libclang::findIncludesInFile(tu, file, func);
 
   return list;
 }
  
-TranslationUnitIncludesInFile::TranslationUnitIncludesInFile(const libclang::TranslationUnit& tu, const QString& filePath, const libclang::File& file, QObject* parent)
+/**
+ * \brief lists the include directives of a file in the background
+ * 
+ * The list is empty if the translation unit is reparsed before the task 
+ * starts, as \a file is then no longer valid.
+ */
+TranslationUnitIncludesInFile::TranslationUnitIncludesInFile(TranslationUnitHandle tu, const QString& filePath, const libclang::File& file, QObject* parent)
   : IncludesInFile(filePath, parent),
     m_translation_unit(tu),
     m_file(file)
 {
-  m_find_includes_future = QtConcurrent::run(&find_includes_in_file, this);
+  const int generation = tu.translationUnit()->generation();
+
+  m_find_includes_future = Executor::get(Executor::Interactive).run([tu, file, generation]() {
+    std::shared_lock<std::shared_mutex> access{ tu.translationUnit()->accessMutex() };
+
+    if (tu.translationUnit()->generation() != generation)
+      return std::vector<Include>();
+
+    return find_includes_in_file(tu.clangTranslationunit(), file);
+    });
 
   auto* watcher = new QFutureWatcher<std::vector<Include>>(this);
   connect(watcher, &QFutureWatcher<std::vector<Include>>::finished, this, &TranslationUnitIncludesInFile::onFutureFinished);
@@ -47,7 +68,7 @@ TranslationUnitIncludesInFile::~TranslationUnitIncludesInFile()
 
 const libclang::TranslationUnit& TranslationUnitIncludesInFile::translationUnit() const
 {
-  return m_translation_unit;
+  return m_translation_unit.clangTranslationunit();
 }
 
 const libclang::File& TranslationUnitIncludesInFile::file() const
@@ -7,6 +7,8 @@
 
 #include "codeviewer/includes.h"
 
+#include <program/translationunit.h>
+
 #include <libclang-utils/clang-file.h>
 #include <libclang-utils/clang-translation-unit.h>
 
@@ -16,7 +18,7 @@ class TranslationUnitIncludesInFile : public IncludesInFile
 {
   Q_OBJECT
 public:
-  explicit TranslationUnitIncludesInFile(const libclang::TranslationUnit& tu, const QString& filePath, const libclang::File& file, QObject* parent = nullptr);
+  explicit TranslationUnitIncludesInFile(TranslationUnitHandle tu, const QString& filePath, const libclang::File& file, QObject* parent = nullptr);
   ~TranslationUnitIncludesInFile();
 
   const libclang::TranslationUnit& translationUnit() const;
@@ -26,7 +28,7 @@ protected Q_SLOTS:
   void onFutureFinished();
 
 private:
-  const libclang::TranslationUnit& m_translation_unit;
+  TranslationUnitHandle m_translation_unit;
   libclang::File m_file;
   QFuture<std::vector<Include>> m_find_includes_future;
 };
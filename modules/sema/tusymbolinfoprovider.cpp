@@ -8,25 +8,67 @@
 #include "tuincludesinfile.h"
 #include "tusymbolreferencesindocument.h"
 
+#include "utils/executor.h"
+#include "utils/telemetry.h"
+
 #include <libclang-utils/clang-cursor.h>
 #include <libclang-utils/clang-source-location.h>
 #include <libclang-utils/clang-translation-unit.h>
 
+#include <QFutureWatcher>
 #include <QTextDocument>
 
 #include <QDebug>
 
+#include <shared_mutex>
+
+static std::optional<libclang::Cursor> find_symbol_at_location(const libclang::TranslationUnit& tu, const libclang::File& file, int line, int col)
+{
+  clark::telemetry::ScopedSpan span{ clark::telemetry::Category::Query, "symbol at location" };
+
+  libclang::SourceLocation loc = tu.getLocation(file, line, col);
+  libclang::Cursor c = tu.getCursor(loc);
+
+  if (c.isNull() || c.kind() == CXCursor_FirstInvalid)
+    return std::nullopt;
+
+  if (c.isReference())
+    c = c.getReference();
+
+  return c.getCanonical();
+}
+
+static SymbolObject* create_symbol(const std::optional<libclang::Cursor>& c)
+{
+  if (!c.has_value())
+    return nullptr;
+
+  try
+  {
+    return new TranslationUnitSymbolObject(*c);
+  }
+  catch (...) {
+    return nullptr;
+  }
+}
+
 TranslationUnitSymbolInfoProvider::TranslationUnitSymbolInfoProvider(TranslationUnitHandle handle, const QTextDocument& document) :
-  m_handle(handle)
+  m_handle(handle),
+  m_latest_lookup_id(std::make_shared<std::atomic<int>>(0))
 {
-  QString filepath = document.metaInformation(QTextDocument::DocumentUrl);
+  m_clock.start();
+
+  m_file_path = document.metaInformation(QTextDocument::DocumentUrl);
   const libclang::TranslationUnit& tu = m_handle.clangTranslationunit();
-  m_file = std::make_unique<libclang::File>(tu.getFile(filepath.toStdString()));
+  m_file = std::make_unique<libclang::File>(tu.getFile(m_file_path.toStdString()));
+
+  connect(m_handle.translationUnit(), &TranslationUnit::reparsed, this, &TranslationUnitSymbolInfoProvider::onTranslationUnitReparsed);
 }
 
 TranslationUnitSymbolInfoProvider::~TranslationUnitSymbolInfoProvider()
 {
-
+  // a lookup that has not started yet is skipped
+  ++(*m_latest_lookup_id);
 }
 
 TranslationUnitSymbolInfoProvider::Features TranslationUnitSymbolInfoProvider::features() const
@@ -34,27 +76,201 @@ TranslationUnitSymbolInfoProvider::Features TranslationUnitSymbolInfoProvider::f
   return { Feature::SymbolAtLocation, Feature::ReferencesInDocument };
 }
 
-SymbolObject* TranslationUnitSymbolInfoProvider::getSymbol(const TokenInfo& tokinfo)
+void TranslationUnitSymbolInfoProvider::onTranslationUnitReparsed()
 {
   const libclang::TranslationUnit& tu = m_handle.clangTranslationunit();
-  libclang::SourceLocation loc = tu.getLocation(*m_file, tokinfo.line, tokinfo.column);
-  libclang::Cursor c = m_handle.clangTranslationunit().getCursor(loc);
+  m_file = std::make_unique<libclang::File>(tu.getFile(m_file_path.toStdString()));
 
-  if (c.isNull() || c.kind() == CXCursor_FirstInvalid)
-    return nullptr;
+  // cursors of the previous parse are no longer valid
+  ++m_parse_generation;
+  m_symbol_cache.clear();
 
-  if (c.isReference())
-    c = c.getReference();
+  if (m_symbol_watcher && m_running_lookup_id == m_latest_lookup_id->load())
+  {
+    ++(*m_latest_lookup_id);
+
+    if (!m_pending_lookup.has_value())
+      m_pending_lookup = m_running_lookup;
+  }
 
-  c = c.getCanonical();
+  Q_EMIT invalidated();
+}
+
+/**
+ * \brief returns the number of milliseconds during which the result of a symbol lookup is reused
+ */
+int TranslationUnitSymbolInfoProvider::symbolCacheTimeToLive()
+{
+  return 2000;
+}
+
+SymbolObject* TranslationUnitSymbolInfoProvider::getSymbol(const TokenInfo& tokinfo)
+{
+  Location loc{ tokinfo.line, tokinfo.column };
+
+  if (const SymbolLookup* cached = findCachedSymbol(loc))
+    return create_symbol(cached->cursor);
+
+  SymbolLookup lookup;
+  lookup.cursor = find_symbol_at_location(m_handle.clangTranslationunit(), *m_file, tokinfo.line, tokinfo.column);
+  lookup.done = true;
+
+  cacheSymbol(loc, lookup);
+
+  return create_symbol(lookup.cursor);
+}
+
+/**
+ * \brief requests the symbol at a given location
+ * 
+ * The lookup is done in the interactive executor; at most one lookup 
+ * runs at a time and only the latest request is kept while it runs, 
+ * so that requests made while the mouse moves are coalesced.
+ * Recent results are reused for symbolCacheTimeToLive() milliseconds.
+ */
+void TranslationUnitSymbolInfoProvider::requestSymbol(const TokenInfo& tokinfo)
+{
+  Location loc{ tokinfo.line, tokinfo.column };
 
-  try 
+  if (const SymbolLookup* cached = findCachedSymbol(loc))
   {
-    return new TranslationUnitSymbolObject(c);
+    cancelSymbolRequest();
+    Q_EMIT symbolAvailable(loc.first, loc.second, create_symbol(cached->cursor));
+    return;
   }
-  catch (...) {
+
+  if (m_symbol_watcher)
+  {
+    if (loc == m_running_lookup && m_running_lookup_id == m_latest_lookup_id->load())
+    {
+      m_pending_lookup.reset();
+    }
+    else
+    {
+      // the running lookup is no longer needed; it is skipped if it has not started yet
+      ++(*m_latest_lookup_id);
+      m_pending_lookup = loc;
+    }
+  }
+  else
+  {
+    m_pending_lookup = loc;
+    startSymbolLookup();
+  }
+}
+
+void TranslationUnitSymbolInfoProvider::cancelSymbolRequest()
+{
+  m_pending_lookup.reset();
+
+  if (m_symbol_watcher)
+    ++(*m_latest_lookup_id);
+}
+
+void TranslationUnitSymbolInfoProvider::startSymbolLookup()
+{
+  using Watcher = QFutureWatcher<SymbolLookup>;
+
+  m_running_lookup = *m_pending_lookup;
+  m_pending_lookup.reset();
+  m_running_lookup_id = ++(*m_latest_lookup_id);
+  m_running_lookup_generation = m_parse_generation;
+
+  m_symbol_watcher = new Watcher(this);
+  connect(m_symbol_watcher, &Watcher::finished, this, &TranslationUnitSymbolInfoProvider::onSymbolLookupFinished);
+
+  TranslationUnitHandle thandle = m_handle;
+  libclang::File file = *m_file;
+  std::shared_ptr<std::atomic<int>> latest = m_latest_lookup_id;
+  int id = m_running_lookup_id;
+  Location loc = m_running_lookup;
+  const int generation = thandle.translationUnit()->generation();
+
+  m_symbol_watcher->setFuture(Executor::get(Executor::Interactive).run([thandle, file, latest, id, loc, generation]() {
+    SymbolLookup result;
+
+    if (latest->load() != id)
+      return result;
+
+    TranslationUnit& tu = *thandle.translationUnit();
+
+    // the file belongs to the clang translation unit that was current when the lookup was requested
+    std::shared_lock<std::shared_mutex> access{ tu.accessMutex() };
+
+    if (tu.generation() != generation)
+      return result;
+
+    result.cursor = find_symbol_at_location(thandle.clangTranslationunit(), file, loc.first, loc.second);
+    result.done = true;
+    return result;
+    }));
+}
+
+void TranslationUnitSymbolInfoProvider::onSymbolLookupFinished()
+{
+  SymbolLookup result = m_symbol_watcher->result();
+  bool wanted = m_running_lookup_id == m_latest_lookup_id->load();
+
+  m_symbol_watcher->deleteLater();
+  m_symbol_watcher = nullptr;
+
+  // the result of a lookup started before a reparse is discarded
+  bool up_to_date = result.done && m_running_lookup_generation == m_parse_generation;
+
+  if (up_to_date)
+    cacheSymbol(m_running_lookup, result);
+
+  if (m_pending_lookup.has_value())
+  {
+    if (up_to_date && *m_pending_lookup == m_running_lookup)
+    {
+      m_pending_lookup.reset();
+      Q_EMIT symbolAvailable(m_running_lookup.first, m_running_lookup.second, create_symbol(result.cursor));
+    }
+    else
+    {
+      startSymbolLookup();
+    }
+  }
+  else if (wanted && up_to_date)
+  {
+    Q_EMIT symbolAvailable(m_running_lookup.first, m_running_lookup.second, create_symbol(result.cursor));
+  }
+}
+
+const TranslationUnitSymbolInfoProvider::SymbolLookup* TranslationUnitSymbolInfoProvider::findCachedSymbol(const Location& loc) const
+{
+  auto it = m_symbol_cache.find(loc);
+
+  if (it == m_symbol_cache.end() || m_clock.elapsed() - it->second.time > symbolCacheTimeToLive())
     return nullptr;
+
+  return &(it->second.lookup);
+}
+
+void TranslationUnitSymbolInfoProvider::cacheSymbol(const Location& loc, const SymbolLookup& lookup)
+{
+  constexpr size_t max_cache_size = 256;
+
+  qint64 now = m_clock.elapsed();
+
+  if (m_symbol_cache.size() >= max_cache_size)
+  {
+    for (auto it = m_symbol_cache.begin(); it != m_symbol_cache.end(); )
+    {
+      if (now - it->second.time > symbolCacheTimeToLive())
+        it = m_symbol_cache.erase(it);
+      else
+        ++it;
+    }
+
+    if (m_symbol_cache.size() >= max_cache_size)
+      m_symbol_cache.clear();
   }
+
+  CachedSymbol& entry = m_symbol_cache[loc];
+  entry.lookup = lookup;
+  entry.time = now;
 }
 
 SymbolReferencesInDocument* TranslationUnitSymbolInfoProvider::getReferencesInDocument(SymbolObject* symbol, const QString& filePath)
@@ -64,10 +280,10 @@ SymbolReferencesInDocument* TranslationUnitSymbolInfoProvider::getReferencesInDo
   if (!tusymbol)
     return nullptr;
 
-  return new TranslationUnitSymbolReferencesInDocument(*tusymbol, filePath, *m_file);
+  return new TranslationUnitSymbolReferencesInDocument(m_handle, *tusymbol, filePath, *m_file);
 }
 
 ::IncludesInFile* TranslationUnitSymbolInfoProvider::getIncludesInFile(const QString& filePath)
 {
-  return new TranslationUnitIncludesInFile(m_handle.clangTranslationunit(), filePath , *m_file);
+  return new TranslationUnitIncludesInFile(m_handle, filePath , *m_file);
 }
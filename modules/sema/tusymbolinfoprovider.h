@@ -9,10 +9,22 @@
 
 #include <program/translationunit.h>
 
+#include <libclang-utils/clang-cursor.h>
 #include <libclang-utils/clang-file.h>
 
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <optional>
+#include <utility>
+
 class QTextDocument;
 
+template<typename T>
+class QFutureWatcher;
+
 class TranslationUnitSymbolInfoProvider : public SymbolInfoProvider
 {
   Q_OBJECT
@@ -24,12 +36,51 @@ public:
   Features features() const override;
 
   SymbolObject* getSymbol(const TokenInfo& tokinfo) override;
+  void requestSymbol(const TokenInfo& tokinfo) override;
+  void cancelSymbolRequest() override;
   SymbolReferencesInDocument* getReferencesInDocument(SymbolObject* symbol, const QString& filePath) override;
   ::IncludesInFile* getIncludesInFile(const QString& filePath) override;
 
+protected Q_SLOTS:
+  void onTranslationUnitReparsed();
+  void onSymbolLookupFinished();
+
+public:
+  typedef std::pair<int, int> Location;
+
+  struct SymbolLookup
+  {
+    bool done = false;
+    std::optional<libclang::Cursor> cursor;
+  };
+
+  static int symbolCacheTimeToLive();
+
+protected:
+  void startSymbolLookup();
+  const SymbolLookup* findCachedSymbol(const Location& loc) const;
+  void cacheSymbol(const Location& loc, const SymbolLookup& lookup);
+
+private:
+  struct CachedSymbol
+  {
+    SymbolLookup lookup;
+    qint64 time = 0;
+  };
+
 private:
   TranslationUnitHandle m_handle;
   std::unique_ptr<libclang::File> m_file;
+  QString m_file_path;
+  QFutureWatcher<SymbolLookup>* m_symbol_watcher = nullptr;
+  Location m_running_lookup;
+  int m_running_lookup_id = 0;
+  int m_running_lookup_generation = 0;
+  int m_parse_generation = 0;
+  std::optional<Location> m_pending_lookup;
+  std::shared_ptr<std::atomic<int>> m_latest_lookup_id;
+  std::map<Location, CachedSymbol> m_symbol_cache;
+  QElapsedTimer m_clock;
 };
 
 #endif // CLARK_TUSYMBOLINFOPROVIDER_H
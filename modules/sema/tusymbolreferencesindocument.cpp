@@ -4,13 +4,19 @@
 
 #include "tusymbolreferencesindocument.h"
 
+#include "utils/executor.h"
+#include "utils/telemetry.h"
+
 #include <libclang-utils/findreferencesinfile.h>
 
-#include <QtConcurrent> 
 #include <QFutureWatcher>
 
-std::vector<SymbolReferencesInDocument::Position> find_references_in_file(TranslationUnitSymbolReferencesInDocument* references)
+#include <shared_mutex>
+
+std::vector<SymbolReferencesInDocument::Position> find_references_in_file(const libclang::Cursor& cursor, const libclang::File& file)
 {
+  clark::telemetry::ScopedSpan span{ clark::telemetry::Category::Query, "references in document" };
+
   std::vector<SymbolReferencesInDocument::Position> positions;
 
   auto func = [&positions](const libclang::Cursor& c, const libclang::SourceRange& source_range) {
@@ -21,16 +27,32 @@ std::vector<SymbolReferencesInDocument::Position> find_references_in_file(Transl
     positions.push_back(pos);
   };
 
-  libclang::findReferencesInFile(references->symbol()->cursor(), references->file(), func);
+  libclang::findReferencesInFile(cursor, file, func);
 
   return positions;
 }
  
-TranslationUnitSymbolReferencesInDocument::TranslationUnitSymbolReferencesInDocument(TranslationUnitSymbolObject& sym, const QString& filePath, const libclang::File& file, QObject* parent)
+/**
+ * \brief finds the references to a symbol in a file in the background
+ * 
+ * The list is empty if the translation unit is reparsed before the task 
+ * starts, as the cursor of the symbol and \a file are then no longer valid.
+ */
+TranslationUnitSymbolReferencesInDocument::TranslationUnitSymbolReferencesInDocument(TranslationUnitHandle tu, TranslationUnitSymbolObject& sym, const QString& filePath, const libclang::File& file, QObject* parent)
   : SymbolReferencesInDocument(sym, filePath, parent),
     m_file(file)
 {
-  m_find_references_future = QtConcurrent::run(&find_references_in_file, this);
+  const int generation = tu.translationUnit()->generation();
+  libclang::Cursor cursor = sym.cursor();
+
+  m_find_references_future = Executor::get(Executor::Interactive).run([tu, cursor, file, generation]() {
+    std::shared_lock<std::shared_mutex> access{ tu.translationUnit()->accessMutex() };
+
+    if (tu.translationUnit()->generation() != generation)
+      return std::vector<Position>();
+
+    return find_references_in_file(cursor, file);
+    });
 
   auto* watcher = new QFutureWatcher<std::vector<Position>>(this);
   connect(watcher, &QFutureWatcher<std::vector<Position>>::finished, this, &TranslationUnitSymbolReferencesInDocument::onFutureFinished);
@@ -7,6 +7,8 @@
 
 #include "tusymbol.h"
 
+#include <program/translationunit.h>
+
 #include <libclang-utils/clang-file.h>
 
 #include <QFuture>
@@ -15,7 +17,7 @@ class TranslationUnitSymbolReferencesInDocument : public SymbolReferencesInDocum
 {
   Q_OBJECT
 public:
-  explicit TranslationUnitSymbolReferencesInDocument(TranslationUnitSymbolObject& sym, const QString& filePath, const libclang::File& file, QObject* parent = nullptr);
+  explicit TranslationUnitSymbolReferencesInDocument(TranslationUnitHandle tu, TranslationUnitSymbolObject& sym, const QString& filePath, const libclang::File& file, QObject* parent = nullptr);
   ~TranslationUnitSymbolReferencesInDocument();
 
   TranslationUnitSymbolObject* symbol() const;
@@ -0,0 +1,185 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "executor.h"
+
+#include <algorithm>
+
+class TrackedRunnable : public QRunnable
+{
+private:
+  Executor& m_executor;
+  QRunnable* m_task;
+
+public:
+  TrackedRunnable(Executor& executor, QRunnable* task) :
+    m_executor(executor),
+    m_task(task)
+  {
+    setAutoDelete(true);
+  }
+
+  ~TrackedRunnable()
+  {
+    if (m_task->autoDelete())
+      delete m_task;
+  }
+
+  void run() override
+  {
+    Executor::Tracker tracker{ m_executor };
+    m_task->run();
+  }
+};
+
+/**
+ * \brief constructs an executor
+ * \param name            a name for the executor
+ * \param maxThreadCount  the maximum number of threads
+ * \param priority        the priority of the threads while running tasks
+ */
+Executor::Executor(const QString& name, int maxThreadCount, QThread::Priority priority) :
+  m_name(name),
+  m_thread_pool(new QThreadPool),
+  m_priority(priority)
+{
+  m_thread_pool->setObjectName(name);
+  setMaxThreadCount(maxThreadCount);
+}
+
+Executor::~Executor()
+{
+  m_thread_pool->clear();
+  m_thread_pool->waitForDone();
+  delete m_thread_pool;
+}
+
+/**
+ * \brief returns one of the executors of the application
+ * \param k  the kind of executor
+ */
+Executor& Executor::get(Kind k)
+{
+  static Executor parse{ "parse", QThread::idealThreadCount() };
+  static Executor index{ "index", std::max(QThread::idealThreadCount() / 2, 1), QThread::LowPriority };
+  static Executor interactive{ "interactive", 2, QThread::HighPriority };
+
+  switch (k)
+  {
+  case Parse:
+    return parse;
+  case Index:
+    return index;
+  case Interactive:
+  default:
+    return interactive;
+  }
+}
+
+const QString& Executor::name() const
+{
+  return m_name;
+}
+
+QThreadPool* Executor::threadPool() const
+{
+  return m_thread_pool;
+}
+
+int Executor::maxThreadCount() const
+{
+  return m_thread_pool->maxThreadCount();
+}
+
+void Executor::setMaxThreadCount(int n)
+{
+  m_thread_pool->setMaxThreadCount(std::max(n, 1));
+}
+
+QThread::Priority Executor::threadPriority() const
+{
+  return m_priority;
+}
+
+/**
+ * \brief starts a task in the executor
+ * \param task      the task
+ * \param priority  the priority of the task in the queue
+ */
+void Executor::start(QRunnable* task, int priority)
+{
+  notifySubmitted();
+  m_thread_pool->start(new TrackedRunnable(*this, task), priority);
+}
+
+/**
+ * \brief returns the number of tasks that were submitted to the executor
+ */
+int Executor::submittedCount() const
+{
+  return m_submitted.load();
+}
+
+/**
+ * \brief returns the number of tasks that ran to completion
+ */
+int Executor::completedCount() const
+{
+  return m_completed.load();
+}
+
+/**
+ * \brief returns the number of tasks that are currently running
+ */
+int Executor::activeCount() const
+{
+  return m_started.load() - m_completed.load();
+}
+
+/**
+ * \brief returns the number of tasks waiting for a thread
+ */
+int Executor::queueDepth() const
+{
+  return m_submitted.load() - m_started.load();
+}
+
+/**
+ * \brief returns the maximum value reached by queueDepth()
+ */
+int Executor::peakQueueDepth() const
+{
+  return m_peak_queue_depth.load();
+}
+
+void Executor::notifySubmitted()
+{
+  m_submitted.fetch_add(1);
+
+  int depth = queueDepth();
+  int peak = m_peak_queue_depth.load();
+
+  while (depth > peak && !m_peak_queue_depth.compare_exchange_weak(peak, depth));
+}
+
+Executor::Tracker::Tracker(Executor& e) :
+  m_executor(e),
+  m_previous_priority(QThread::currentThread()->priority())
+{
+  m_executor.m_started.fetch_add(1);
+
+  if (m_executor.threadPriority() != QThread::InheritPriority)
+    QThread::currentThread()->setPriority(m_executor.threadPriority());
+}
+
+Executor::Tracker::~Tracker()
+{
+  if (m_executor.threadPriority() != QThread::InheritPriority)
+  {
+    QThread::Priority p = m_previous_priority == QThread::InheritPriority ? QThread::NormalPriority : m_previous_priority;
+    QThread::currentThread()->setPriority(p);
+  }
+
+  m_executor.m_completed.fetch_add(1);
+}
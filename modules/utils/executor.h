@@ -0,0 +1,171 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_EXECUTOR_H
+#define CLARK_EXECUTOR_H
+
+#include <QFuture>
+#include <QString>
+#include <QThread>
+#include <QThreadPool>
+
+#include <QtConcurrent>
+
+#include <atomic>
+#include <type_traits>
+#include <utility>
+
+/**
+ * \brief a named thread pool that keeps track of its queue
+ * 
+ * The application uses a few executors so that long-running background 
+ * work does not starve interactive queries:
+ * - the parse executor runs the parsing of translation units;
+ * - the index executor runs the indexing of translation units;
+ * - the interactive executor runs short queries made on behalf of the user 
+ *   (e.g., finding references, symbol lookups); longer tasks, even if the 
+ *   user waits for them, go to the other executors.
+ */
+class Executor
+{
+public:
+
+  enum Kind
+  {
+    Parse,
+    Index,
+    Interactive,
+  };
+
+  Executor(const QString& name, int maxThreadCount, QThread::Priority priority = QThread::InheritPriority);
+  Executor(const Executor&) = delete;
+  ~Executor();
+
+  static Executor& get(Kind k);
+
+  const QString& name() const;
+  QThreadPool* threadPool() const;
+
+  int maxThreadCount() const;
+  void setMaxThreadCount(int n);
+
+  QThread::Priority threadPriority() const;
+
+  void start(QRunnable* task, int priority = 0);
+
+  template<typename F>
+  auto run(F&& f) -> QFuture<decltype(f())>;
+  template<typename F>
+  auto run(F&& f, int priority) -> QFuture<decltype(f())>;
+
+  int submittedCount() const;
+  int completedCount() const;
+  int activeCount() const;
+  int queueDepth() const;
+  int peakQueueDepth() const;
+
+  class Tracker
+  {
+  public:
+    explicit Tracker(Executor& e);
+    ~Tracker();
+
+  private:
+    Executor& m_executor;
+    QThread::Priority m_previous_priority;
+  };
+
+protected:
+  void notifySubmitted();
+
+private:
+  QString m_name;
+  QThreadPool* m_thread_pool = nullptr;
+  QThread::Priority m_priority;
+  std::atomic<int> m_submitted{ 0 };
+  std::atomic<int> m_started{ 0 };
+  std::atomic<int> m_completed{ 0 };
+  std::atomic<int> m_peak_queue_depth{ 0 };
+};
+
+/**
+ * \brief runs a function in the executor
+ * \param f  the function
+ * 
+ * Works like QtConcurrent::run() and returns a future for the result 
+ * of the function.
+ */
+template<typename F>
+inline auto Executor::run(F&& f) -> QFuture<decltype(f())>
+{
+  notifySubmitted();
+
+  return QtConcurrent::run(m_thread_pool, [this, f = std::forward<F>(f)]() mutable {
+    Tracker tracker{ *this };
+    return f();
+    });
+}
+
+namespace executor_details
+{
+
+template<typename F, typename R>
+class FunctionTask : public QRunnable
+{
+public:
+  FunctionTask(F f, QFutureInterface<R> promise) :
+    m_function(std::move(f)),
+    m_promise(std::move(promise))
+  {
+    setAutoDelete(true);
+  }
+
+  ~FunctionTask()
+  {
+    // the task was removed from the queue without running
+    if (!m_promise.isFinished())
+    {
+      m_promise.reportCanceled();
+      m_promise.reportFinished();
+    }
+  }
+
+  void run() override
+  {
+    m_promise.reportResult(m_function());
+    m_promise.reportFinished();
+  }
+
+private:
+  F m_function;
+  QFutureInterface<R> m_promise;
+};
+
+} // namespace executor_details
+
+/**
+ * \brief runs a function in the executor with a given priority
+ * \param f         the function
+ * \param priority  the priority of the task in the queue
+ * 
+ * Contrary to run(F&&), the task can be queued before the tasks 
+ * already waiting for a thread (see start()).
+ * The function must return a value.
+ */
+template<typename F>
+inline auto Executor::run(F&& f, int priority) -> QFuture<decltype(f())>
+{
+  using R = decltype(f());
+  static_assert(!std::is_void<R>::value, "the function must return a value");
+
+  QFutureInterface<R> promise;
+  promise.reportStarted();
+  QFuture<R> future = promise.future();
+
+  start(new executor_details::FunctionTask<std::decay_t<F>, R>(std::forward<F>(f), std::move(promise)), priority);
+
+  return future;
+}
+
+#endif // CLARK_EXECUTOR_H
@@ -0,0 +1,86 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "memory.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <Windows.h>
+#include <Psapi.h>
+#elif defined(__linux__)
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#endif
+
+namespace clark
+{
+
+namespace memory
+{
+
+/**
+ * \brief returns the amount of physical memory available for new allocations, in bytes
+ * 
+ * Returns 0 if this information is not available on the current platform.
+ */
+size_t available_physical_memory()
+{
+#if defined(_WIN32)
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+
+  if (!GlobalMemoryStatusEx(&status))
+    return 0;
+
+  return static_cast<size_t>(status.ullAvailPhys);
+#elif defined(__linux__)
+  std::ifstream meminfo{ "/proc/meminfo" };
+  std::string key;
+  size_t value = 0;
+  std::string unit;
+
+  while (meminfo >> key >> value >> unit)
+  {
+    if (key == "MemAvailable:")
+      return value * 1024;
+  }
+
+  return 0;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * \brief returns the amount of physical memory used by the current process, in bytes
+ * 
+ * Returns 0 if this information is not available on the current platform.
+ */
+size_t process_resident_memory()
+{
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters;
+
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+
+  return static_cast<size_t>(counters.WorkingSetSize);
+#elif defined(__linux__)
+  std::ifstream statm{ "/proc/self/statm" };
+  size_t size = 0;
+  size_t resident = 0;
+
+  if (!(statm >> size >> resident))
+    return 0;
+
+  return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+  return 0;
+#endif
+}
+
+} // namespace memory
+
+} // namespace clark
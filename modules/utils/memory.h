@@ -0,0 +1,23 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_UTILS_MEMORY_H
+#define CLARK_UTILS_MEMORY_H
+
+#include <cstddef>
+
+namespace clark
+{
+
+namespace memory
+{
+
+size_t available_physical_memory();
+size_t process_resident_memory();
+
+} // namespace memory
+
+} // namespace clark
+
+#endif // CLARK_UTILS_MEMORY_H
@@ -0,0 +1,265 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include "telemetry.h"
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <atomic>
+
+namespace clark
+{
+
+namespace telemetry
+{
+
+const char* category_name(Category c)
+{
+  switch (c)
+  {
+  case Category::Parse:
+    return "parse";
+  case Category::Reparse:
+    return "reparse";
+  case Category::Suspend:
+    return "suspend";
+  case Category::Index:
+    return "index";
+  case Category::Highlight:
+    return "highlight";
+  case Category::Query:
+    return "query";
+  default:
+    return "";
+  }
+}
+
+static size_t bucket_index(int64_t duration)
+{
+  size_t i = 0;
+
+  while (duration > 1 && i + 1 < Histogram::BucketCount)
+  {
+    duration >>= 1;
+    ++i;
+  }
+
+  return i;
+}
+
+void Histogram::add(int64_t duration)
+{
+  duration = std::max<int64_t>(duration, 0);
+
+  m_buckets[bucket_index(duration)] += 1;
+
+  m_min = m_count == 0 ? duration : std::min(m_min, duration);
+  m_max = m_count == 0 ? duration : std::max(m_max, duration);
+  m_count += 1;
+  m_total += duration;
+}
+
+int64_t Histogram::count() const
+{
+  return m_count;
+}
+
+int64_t Histogram::total() const
+{
+  return m_total;
+}
+
+int64_t Histogram::min() const
+{
+  return m_min;
+}
+
+int64_t Histogram::max() const
+{
+  return m_max;
+}
+
+int64_t Histogram::mean() const
+{
+  return m_count ? m_total / m_count : 0;
+}
+
+/**
+ * \brief returns an approximation of a percentile
+ * \param p  the percentile, between 0 and 1
+ * 
+ * The returned value is the upper bound of the bucket containing the 
+ * percentile, clamped to the maximum duration.
+ */
+int64_t Histogram::percentile(double p) const
+{
+  if (m_count == 0)
+    return 0;
+
+  int64_t rank = static_cast<int64_t>(p * static_cast<double>(m_count));
+  int64_t n = 0;
+
+  for (size_t i(0); i < BucketCount; ++i)
+  {
+    n += m_buckets[i];
+
+    if (n > rank)
+      return std::min<int64_t>(int64_t(1) << (i + 1), m_max);
+  }
+
+  return m_max;
+}
+
+const std::array<int64_t, Histogram::BucketCount>& Histogram::buckets() const
+{
+  return m_buckets;
+}
+
+Recorder::Recorder() :
+  m_session_start(std::chrono::steady_clock::now())
+{
+
+}
+
+Recorder& Recorder::instance()
+{
+  static Recorder recorder;
+  return recorder;
+}
+
+bool Recorder::enabled() const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  return m_enabled;
+}
+
+void Recorder::setEnabled(bool on)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  m_enabled = on;
+}
+
+/**
+ * \brief returns the number of microseconds elapsed since the start of the session
+ */
+int64_t Recorder::now() const
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_session_start).count();
+}
+
+void Recorder::record(Span span)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  if (!m_enabled)
+    return;
+
+  m_histograms[static_cast<size_t>(span.category)].add(span.duration);
+
+  m_spans.push_back(std::move(span));
+
+  if (m_spans.size() > m_max_spans)
+    m_spans.pop_front();
+}
+
+std::vector<Span> Recorder::spans() const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  return std::vector<Span>(m_spans.begin(), m_spans.end());
+}
+
+Histogram Recorder::histogram(Category c) const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  return m_histograms[static_cast<size_t>(c)];
+}
+
+void Recorder::clear()
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  m_spans.clear();
+  m_histograms = {};
+}
+
+/**
+ * \brief returns the recorded spans in the Chrome trace-event format
+ * 
+ * The result can be loaded in chrome://tracing or in Perfetto.
+ */
+QByteArray Recorder::toChromeTrace() const
+{
+  QJsonArray events;
+
+  for (const Span& span : spans())
+  {
+    QJsonObject event;
+    event["name"] = category_name(span.category);
+    event["cat"] = category_name(span.category);
+    event["ph"] = "X";
+    event["ts"] = static_cast<double>(span.start);
+    event["dur"] = static_cast<double>(span.duration);
+    event["pid"] = static_cast<double>(QCoreApplication::applicationPid());
+    event["tid"] = span.thread;
+
+    if (!span.detail.empty())
+    {
+      QJsonObject args;
+      args["detail"] = QString::fromStdString(span.detail);
+      event["args"] = args;
+    }
+
+    events.append(event);
+  }
+
+  QJsonObject trace;
+  trace["traceEvents"] = events;
+  trace["displayTimeUnit"] = "ms";
+
+  return QJsonDocument(trace).toJson(QJsonDocument::Compact);
+}
+
+ScopedSpan::ScopedSpan(Category c, std::string detail) :
+  m_category(c),
+  m_detail(std::move(detail)),
+  m_start(Recorder::instance().now())
+{
+
+}
+
+ScopedSpan::~ScopedSpan()
+{
+  Span span;
+  span.category = m_category;
+  span.detail = std::move(m_detail);
+  span.thread = current_thread_id();
+  span.start = m_start;
+  span.duration = Recorder::instance().now() - m_start;
+  Recorder::instance().record(std::move(span));
+}
+
+/**
+ * \brief returns the number of microseconds elapsed since the span started
+ */
+int64_t ScopedSpan::elapsed() const
+{
+  return Recorder::instance().now() - m_start;
+}
+
+/**
+ * \brief returns a small integer identifying the current thread
+ */
+int current_thread_id()
+{
+  static std::atomic<int> next_id{ 1 };
+  thread_local int id = next_id.fetch_add(1);
+  return id;
+}
+
+} // namespace telemetry
+
+} // namespace clark
@@ -0,0 +1,139 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#ifndef CLARK_UTILS_TELEMETRY_H
+#define CLARK_UTILS_TELEMETRY_H
+
+#include <QByteArray>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace clark
+{
+
+namespace telemetry
+{
+
+enum class Category
+{
+  Parse,
+  Reparse,
+  Suspend,
+  Index,
+  Highlight,
+  Query,
+};
+
+constexpr size_t CategoryCount = static_cast<size_t>(Category::Query) + 1;
+
+const char* category_name(Category c);
+
+/**
+ * \brief a completed operation
+ */
+struct Span
+{
+  Category category;
+  std::string detail; // e.g., the path of the translation unit
+  int thread = 0;
+  int64_t start = 0; // in microseconds since the start of the session
+  int64_t duration = 0; // in microseconds
+};
+
+/**
+ * \brief a latency histogram with power-of-two buckets
+ * 
+ * Bucket \c i counts the durations in [2^i, 2^(i+1)) microseconds.
+ */
+class Histogram
+{
+public:
+  static constexpr size_t BucketCount = 40;
+
+  void add(int64_t duration);
+
+  int64_t count() const;
+  int64_t total() const;
+  int64_t min() const;
+  int64_t max() const;
+  int64_t mean() const;
+  int64_t percentile(double p) const;
+
+  const std::array<int64_t, BucketCount>& buckets() const;
+
+private:
+  std::array<int64_t, BucketCount> m_buckets = {};
+  int64_t m_count = 0;
+  int64_t m_total = 0;
+  int64_t m_min = 0;
+  int64_t m_max = 0;
+};
+
+/**
+ * \brief collects the spans recorded during a session
+ * 
+ * Only the most recent spans are kept, but every span contributes 
+ * to the histogram of its category.
+ */
+class Recorder
+{
+public:
+  static Recorder& instance();
+
+  bool enabled() const;
+  void setEnabled(bool on = true);
+
+  int64_t now() const;
+
+  void record(Span span);
+
+  std::vector<Span> spans() const;
+  Histogram histogram(Category c) const;
+  void clear();
+
+  QByteArray toChromeTrace() const;
+
+protected:
+  Recorder();
+
+private:
+  mutable std::mutex m_mutex;
+  bool m_enabled = true;
+  std::chrono::steady_clock::time_point m_session_start;
+  size_t m_max_spans = 100000;
+  std::deque<Span> m_spans;
+  std::array<Histogram, CategoryCount> m_histograms;
+};
+
+/**
+ * \brief records the duration of the enclosing scope
+ */
+class ScopedSpan
+{
+public:
+  explicit ScopedSpan(Category c, std::string detail = {});
+  ScopedSpan(const ScopedSpan&) = delete;
+  ~ScopedSpan();
+
+  int64_t elapsed() const;
+
+private:
+  Category m_category;
+  std::string m_detail;
+  int64_t m_start;
+};
+
+int current_thread_id();
+
+} // namespace telemetry
+
+} // namespace clark
+
+#endif // CLARK_UTILS_TELEMETRY_H
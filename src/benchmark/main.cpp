@@ -0,0 +1,238 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include <codeviewer/syntaxhighlighter.h>
+
+#include <program/compilationdatabase.h>
+#include <program/translationunit.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/*
+ * clark-benchmark measures code paths that are hot in large projects
+ * without parsing any C++.
+ *
+ * Usage:
+ *   clark-benchmark handles [threads] [iterations]
+ *     copies and resets handles to a loaded translation unit from
+ *     several threads at once, and compares with a mutex-protected 
+ *     use count
+ *   clark-benchmark compdb [entries]
+ *     loads a generated compile_commands.json
+ *   clark-benchmark names [iterations]
+ *     classifies identifiers with the table of built-in names
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_ms(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void no_load(TranslationUnit& /* tu */, std::unique_lock<std::mutex>& /* lock */)
+{
+  std::cerr << "clark-benchmark: the translation unit was unloaded" << std::endl;
+  std::abort();
+}
+
+/**
+ * \brief reference counting under a mutex, as handles did before the use 
+ * count and state of a translation unit became atomics
+ */
+struct LockedUseCount
+{
+  std::mutex mutex;
+  int use_count = 1;
+  TranslationUnit::State state = TranslationUnit::Loaded;
+
+  void acquire()
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+
+    if (use_count++ == 0 || state != TranslationUnit::Loaded)
+      std::abort();
+  }
+
+  void release()
+  {
+    std::lock_guard<std::mutex> lock{ mutex };
+    --use_count;
+  }
+};
+
+template<typename F>
+static double run_threads(int nthreads, F&& func)
+{
+  std::vector<std::thread> threads;
+  Clock::time_point start = Clock::now();
+
+  for (int t(0); t < nthreads; ++t)
+    threads.emplace_back(func);
+
+  for (std::thread& th : threads)
+    th.join();
+
+  return elapsed_ms(start);
+}
+
+static int bench_handles(int nthreads, int iterations)
+{
+  TranslationUnit tu{ "benchmark.cpp" };
+  tu.setState(TranslationUnit::Loaded);
+
+  // keeps the use count above zero, so that no thread emits usedChanged()
+  TranslationUnitHandle base{ tu };
+
+  const double ms = run_threads(nthreads, [&base, iterations]() {
+    TranslationUnitHandle::setLoadProcForCurrentThread(&no_load);
+
+    for (int i(0); i < iterations; ++i)
+    {
+      TranslationUnitHandle copy{ base };
+      copy.reset();
+    }
+    });
+
+  // the same work with a mutex-protected use count, for comparison
+  LockedUseCount locked;
+
+  const double locked_ms = run_threads(nthreads, [&locked, iterations]() {
+    for (int i(0); i < iterations; ++i)
+    {
+      locked.acquire();
+      locked.release();
+    }
+    });
+
+  const double ops = double(nthreads) * iterations;
+
+  std::cout << "handles: " << nthreads << " threads x " << iterations << " copy+reset" << std::endl;
+  std::cout << "  atomics: " << ms << " ms, " << (ms * 1e6 / ops) << " ns per copy+reset (wall clock / total)" << std::endl;
+  std::cout << "  mutex:   " << locked_ms << " ms, " << (locked_ms * 1e6 / ops) << " ns per copy+reset (wall clock / total)" << std::endl;
+
+  return tu.useCount() == 1 ? 0 : 1;
+}
+
+static std::string generate_compilation_database(int entries)
+{
+  // a few hundred targets, each compiled with its own flags
+  const int ntargets = 200;
+
+  std::ostringstream out;
+  out << "[\n";
+
+  for (int i(0); i < entries; ++i)
+  {
+    const int target = i % ntargets;
+
+    out << "  {\n"
+      << "    \"directory\": \"/home/user/project/build\",\n"
+      << "    \"command\": \"/usr/bin/c++ -DNDEBUG -DTARGET_" << target << "=1 -D_GNU_SOURCE"
+      << " -I/home/user/project/src -I/home/user/project/src/target" << target
+      << " -I/home/user/project/build/generated -isystem /usr/include/qt5 -isystem /usr/include/qt5/QtCore"
+      << " -O2 -g -fPIC -std=gnu++17 -o CMakeFiles/target" << target << ".dir/file" << i << ".cpp.o"
+      << " -c /home/user/project/src/target" << target << "/file" << i << ".cpp\",\n"
+      << "    \"file\": \"/home/user/project/src/target" << target << "/file" << i << ".cpp\"\n"
+      << "  }" << (i + 1 < entries ? "," : "") << "\n";
+  }
+
+  out << "]\n";
+  return out.str();
+}
+
+static int bench_compilation_database(int entries)
+{
+  const std::string json = generate_compilation_database(entries);
+
+  {
+    std::istringstream stream{ json };
+    Clock::time_point start = Clock::now();
+    int count = 0;
+
+    program::read_compilation_database(stream, [&count](program::CompileCommand&) { ++count; });
+
+    std::cout << "compdb: read " << count << " entries (" << json.size() / 1024 << " KiB) in " << elapsed_ms(start) << " ms" << std::endl;
+  }
+
+  {
+    std::istringstream stream{ json };
+    Clock::time_point start = Clock::now();
+
+    program::CompilationDatabaseLoader loader;
+    std::vector<TranslationUnit*> tus = loader.load(stream);
+
+    std::cout << "compdb: loaded " << tus.size() << " translation units in " << elapsed_ms(start) << " ms" << std::endl;
+
+    for (TranslationUnit* tu : tus)
+      delete tu;
+  }
+
+  return 0;
+}
+
+static int bench_builtin_names(int iterations)
+{
+  // mostly identifiers that are not built-in names, as in real code
+  const std::string_view identifiers[] = {
+    "std", "vector", "size_t", "i", "result", "count", "uint32_t", "value",
+    "Qt", "data", "begin", "end", "it", "QString", "int64_t", "m_translation_unit",
+  };
+
+  int found = 0;
+  Clock::time_point start = Clock::now();
+
+  for (int i(0); i < iterations; ++i)
+  {
+    for (std::string_view name : identifiers)
+    {
+      if (SyntaxHighlighterNameHighlighter::builtinFormat(name) != CppSyntaxHighlighter::Format::Default)
+        ++found;
+    }
+  }
+
+  const double ms = elapsed_ms(start);
+  const double lookups = double(iterations) * (sizeof(identifiers) / sizeof(identifiers[0]));
+
+  std::cout << "names: " << lookups << " lookups (" << found << " built-in) in " << ms << " ms, "
+    << (ms * 1e6 / lookups) << " ns per lookup" << std::endl;
+
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  const std::string what = argc > 1 ? argv[1] : "";
+
+  if (what == "handles")
+  {
+    int nthreads = argc > 2 ? std::atoi(argv[2]) : int(std::thread::hardware_concurrency());
+    int iterations = argc > 3 ? std::atoi(argv[3]) : 1000000;
+    return bench_handles(std::max(nthreads, 1), iterations);
+  }
+  else if (what == "compdb")
+  {
+    int entries = argc > 2 ? std::atoi(argv[2]) : 50000;
+    return bench_compilation_database(entries);
+  }
+  else if (what == "names")
+  {
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 1000000;
+    return bench_builtin_names(iterations);
+  }
+
+  std::cerr << "Usage: clark-benchmark handles [threads] [iterations]" << std::endl;
+  std::cerr << "       clark-benchmark compdb [entries]" << std::endl;
+  std::cerr << "       clark-benchmark names [iterations]" << std::endl;
+  return 1;
+}
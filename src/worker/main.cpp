@@ -0,0 +1,117 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'clark' project.
+// For conditions of distribution and use, see copyright notice in LICENSE.
+
+#include <indexing/indexer.h>
+#include <indexing/serialization.h>
+#include <indexing/worker.h>
+
+#include <program/libclang.h>
+
+#include <libclang-utils/clang-index.h>
+#include <libclang-utils/clang-translation-unit.h>
+
+#include <QtEndian>
+
+#include <cstdio>
+#include <iostream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+/*
+ * clark-worker parses and indexes translation units on behalf of clark.
+ * 
+ * Requests are read from the standard input and the serialized 
+ * indexing results are written to the standard output.
+ * See indexing/worker.h for the format of the messages.
+ * 
+ * Usage: clark-worker [path/to/libclang]
+ */
+
+static bool read_exactly(char* data, size_t n)
+{
+  return std::fread(data, 1, n, stdin) == n;
+}
+
+static bool receive(QByteArray& message)
+{
+  char header[4];
+
+  if (!read_exactly(header, sizeof(header)))
+    return false;
+
+  quint32 size = qFromBigEndian<quint32>(header);
+  message.resize(int(size));
+  return size == 0 || read_exactly(message.data(), size);
+}
+
+static void send(const QByteArray& message)
+{
+  QByteArray framed = clark::worker::frame(message);
+  std::fwrite(framed.constData(), 1, framed.size(), stdout);
+  std::fflush(stdout);
+}
+
+static clark::worker::Response process(libclang::Index& index, const clark::worker::Request& request)
+{
+  clark::worker::Response response;
+
+  std::set<std::string> includedirs;
+
+  for (const QString& dir : request.includedirs)
+    includedirs.insert(dir.toStdString());
+
+  try
+  {
+    libclang::TranslationUnit tu = index.parseTranslationUnit(request.file.toStdString(), includedirs, CXTranslationUnit_DetailedPreprocessingRecord);
+    clark::IndexingResult result = clark::index_translation_unit(index, tu);
+    response.status = clark::worker::Success;
+    response.data = clark::serialize(result);
+  }
+  catch (const std::exception& ex)
+  {
+    response.data = ex.what();
+  }
+
+  return response;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef _WIN32
+  _setmode(_fileno(stdin), _O_BINARY);
+  _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+  std::shared_ptr<libclang::LibClang> lib = LibClang::tryLoad(argc > 1 ? QString::fromLocal8Bit(argv[1]) : QString());
+
+  if (!lib)
+  {
+    std::cerr << "clark-worker: libclang is not available" << std::endl;
+    return 1;
+  }
+
+  libclang::Index index = lib->createIndex();
+
+  QByteArray message;
+
+  while (receive(message))
+  {
+    clark::worker::Request request;
+
+    if (!clark::worker::read(message, request))
+    {
+      clark::worker::Response response;
+      response.data = "invalid request";
+      send(clark::worker::write(response));
+      continue;
+    }
+
+    send(clark::worker::write(process(index, request)));
+  }
+
+  return 0;
+}